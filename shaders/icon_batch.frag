@@ -0,0 +1,33 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Must match icon_batch_renderer::max_textures
+layout(set = 0, binding = 0) uniform sampler2D textures[256];
+
+layout(location = 0) in vec2 vUV;
+layout(location = 1) in vec4 vColor;
+layout(location = 2) flat in uint vTexture;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures[nonuniformEXT(vTexture)], vUV) * vColor;
+}
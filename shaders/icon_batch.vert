@@ -0,0 +1,43 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#version 450
+
+// One instance per icon, six vertices (two triangles) each.
+layout(location = 0) in vec4 inRect;   // x, y, width, height in screen fractions
+layout(location = 1) in vec4 inUV;     // u0, v0, u1, v1
+layout(location = 2) in vec4 inColor;
+layout(location = 3) in uint inTexture;
+
+layout(location = 0) out vec2 vUV;
+layout(location = 1) out vec4 vColor;
+layout(location = 2) flat out uint vTexture;
+
+const vec2 corners[6] = vec2[](
+    vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+    vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0)
+);
+
+void main() {
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 pos = inRect.xy + corner * inRect.zw;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+    vUV = mix(inUV.xy, inUV.zw, corner);
+    vColor = inColor;
+    vTexture = inTexture;
+}
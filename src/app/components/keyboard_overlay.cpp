@@ -0,0 +1,97 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <array>
+#include <format>
+#include <string>
+#include <string_view>
+#include <utility>
+
+module openxmb.app;
+import :keyboard_overlay;
+
+import dreamrender;
+import glm;
+import openxmb.utils;
+
+namespace app {
+
+result keyboard_overlay::on_action(action action) {
+    switch(action) {
+        case action::left:
+            column = (column + columns - 1) % columns;
+            return result::success | result::ok_sound;
+        case action::right:
+            column = (column + 1) % columns;
+            return result::success | result::ok_sound;
+        case action::up:
+            row = (row + rows.size() - 1) % rows.size();
+            return result::success | result::ok_sound;
+        case action::down:
+            row = (row + 1) % rows.size();
+            return result::success | result::ok_sound;
+        case action::ok:
+            return target.on_text(rows[row].substr(column, 1));
+        case action::extra:
+            return target.on_text(" ");
+        case action::options:
+            return target.on_text_erase();
+        case action::cancel:
+            return result::success | result::close | result::back_sound;
+        default:
+            return result::unsupported;
+    }
+}
+
+void keyboard_overlay::render(dreamrender::gui_renderer& renderer, class shell* xmb) {
+    constexpr float key_size = 0.06f;
+    constexpr float top = 0.45f;
+    const float key_width = key_size / renderer.aspect_ratio;
+    const float left = 0.5f - key_width * columns / 2.0f;
+
+    renderer.draw_rect(glm::vec2{left - key_width / 2.0f, top - key_size * 1.75f},
+        glm::vec2{key_width * (columns + 1), key_size * (static_cast<float>(rows.size()) + 2.25f)}, glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+
+    // What has been typed so far, with a cursor
+    renderer.draw_text(std::format("{}_", target.get_text()), left, top - key_size, key_size * 0.75f,
+        glm::vec4(1.0f), false, true);
+
+    for(unsigned int r = 0; r < rows.size(); r++) {
+        for(unsigned int c = 0; c < columns; c++) {
+            const float x = left + key_width * c;
+            const float y = top + key_size * r;
+            const bool selected = r == row && c == column;
+            if(selected) {
+                renderer.draw_rect(glm::vec2{x, y}, glm::vec2{key_width, key_size}, glm::vec4(1.0f, 1.0f, 1.0f, 0.25f));
+            }
+            renderer.draw_text(rows[r].substr(c, 1), x + key_width / 2.0f, y + key_size / 2.0f,
+                key_size * (selected ? 0.8f : 0.6f), glm::vec4(1.0f), true, true);
+        }
+    }
+
+    xmb->render_controller_buttons(renderer, 0.5f, 0.9f, std::array{
+        std::pair{action::ok, "Enter"},
+        std::pair{action::extra, "Space"},
+        std::pair{action::options, "Delete"},
+        std::pair{action::cancel, "Back"},
+    });
+}
+
+}
@@ -0,0 +1,59 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <array>
+#include <string>
+#include <string_view>
+
+export module openxmb.app:keyboard_overlay;
+
+import dreamrender;
+import openxmb.utils;
+import :component;
+
+namespace app {
+
+// On-screen keyboard for controllers. Keys are typed into target, which
+// must outlive the overlay; cancel closes it.
+export class keyboard_overlay : public component, public action_receiver {
+    public:
+        explicit keyboard_overlay(text_receiver& target) : target(target) {}
+
+        void render(dreamrender::gui_renderer& renderer, class shell* xmb) override;
+        result on_action(action action) override;
+
+        [[nodiscard]] bool is_opaque() const override { return false; }
+        [[nodiscard]] bool do_fade_in() const override { return true; }
+        [[nodiscard]] bool do_fade_out() const override { return true; }
+    private:
+        static constexpr std::array<std::string_view, 4> rows{
+            "1234567890",
+            "qwertyuiop",
+            "asdfghjkl-",
+            "zxcvbnm_.'",
+        };
+        static constexpr unsigned int columns = 10;
+
+        text_receiver& target;
+        unsigned int row = 1;
+        unsigned int column = 0;
+};
+
+}
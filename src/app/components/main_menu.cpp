@@ -20,8 +20,19 @@
 
 module;
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstddef>
+#include <format>
+#include <functional>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 module openxmb.app;
 
@@ -34,17 +45,58 @@ import vma;
 import dreamrender;
 
 import openxmb.config;
+import :draw_list;
 import :menu_base;
 import :menu_utils;
 import :applications_menu;
 import :settings_menu;
 import :users_menu;
 import :files_menu;
+import :media_view;
+import :search_index;
 
 using namespace mfk::i18n::literals;
 
 namespace app {
 
+namespace {
+    bool uses_extra(const std::vector<std::pair<action, std::string>>& buttons) {
+        return std::ranges::any_of(buttons, [](const auto& b) { return b.first == action::extra; });
+    }
+
+    // What the entries of a category are found as, if they are indexed at all.
+    // Files are indexed from the media library instead.
+    std::optional<menu::search_item::kind> search_kind(const menu::menu& category) {
+        if(dynamic_cast<const menu::applications_menu*>(&category)) {
+            return menu::search_item::kind::application;
+        }
+        if(dynamic_cast<const menu::settings_menu*>(&category)) {
+            return menu::search_item::kind::setting;
+        }
+        if(dynamic_cast<const menu::users_menu*>(&category)) {
+            return menu::search_item::kind::user;
+        }
+        return std::nullopt;
+    }
+
+    // Adds the entries below m that are not menus themselves, with the names
+    // leading to them.
+    void collect_entries(const menu::menu& m, menu::search_item::kind kind, unsigned int category,
+        std::vector<std::string>& location, std::vector<menu::search_item>& items)
+    {
+        for(unsigned int i = 0; i < m.get_submenus_count(); i++) {
+            const auto& entry = m.get_submenu(i);
+            location.emplace_back(entry.get_name());
+            if(const auto* submenu = dynamic_cast<const menu::menu*>(&entry); submenu && submenu->get_submenus_count() > 0) {
+                collect_entries(*submenu, kind, category, location, items);
+            } else {
+                items.push_back({kind, std::string(entry.get_name()), std::string(entry.get_description()), category, location});
+            }
+            location.pop_back();
+        }
+    }
+}
+
 main_menu::main_menu(app::shell* xmb) : xmb(xmb) {
 
 }
@@ -57,12 +109,26 @@ void main_menu::preload(vk::Device device, vma::Allocator allocator, dreamrender
     menus.reserve(10);
     menus.push_back(make_simple<menu::users_menu>("Users"_(), asset_directory/"icons/icon_category_users.png", loader, xmb, loader));
     menus.push_back(make_simple<menu::settings_menu>("Settings"_(), asset_directory/"icons/icon_category_settings.png", loader, xmb, loader));
-    menus.push_back(make_simple<menu::files_menu>("Photo"_(), asset_directory/"icons/icon_category_photo.png", loader, xmb,
-        config::CONFIG.picturesPath, loader));
-    menus.push_back(make_simple<menu::files_menu>("Music"_(), asset_directory/"icons/icon_category_music.png", loader, xmb,
-        config::CONFIG.musicPath, loader));
-    menus.push_back(make_simple<menu::files_menu>("Video"_(), asset_directory/"icons/icon_category_video.png", loader, xmb,
-        config::CONFIG.videosPath, loader));
+    // The media categories also list the mounted USB drives and SD cards
+    auto with_devices = [](auto menu) {
+        menu->show_removable_media();
+        return menu;
+    };
+    if(config::CONFIG.libraryViews) {
+        menus.push_back(with_devices(make_simple<menu::media_view>("Photo"_(), asset_directory/"icons/icon_category_photo.png", loader, xmb,
+            config::CONFIG.picturesPath, "image/", loader)));
+        menus.push_back(with_devices(make_simple<menu::media_view>("Music"_(), asset_directory/"icons/icon_category_music.png", loader, xmb,
+            config::CONFIG.musicPath, "audio/", loader)));
+        menus.push_back(with_devices(make_simple<menu::media_view>("Video"_(), asset_directory/"icons/icon_category_video.png", loader, xmb,
+            config::CONFIG.videosPath, "video/", loader)));
+    } else {
+        menus.push_back(with_devices(make_simple<menu::files_menu>("Photo"_(), asset_directory/"icons/icon_category_photo.png", loader, xmb,
+            config::CONFIG.picturesPath, loader)));
+        menus.push_back(with_devices(make_simple<menu::files_menu>("Music"_(), asset_directory/"icons/icon_category_music.png", loader, xmb,
+            config::CONFIG.musicPath, loader)));
+        menus.push_back(with_devices(make_simple<menu::files_menu>("Video"_(), asset_directory/"icons/icon_category_video.png", loader, xmb,
+            config::CONFIG.videosPath, loader)));
+    }
     menus.push_back(make_simple_of<menu::menu>("TV"_(), asset_directory/"icons/icon_category_tv.png", loader));
     menus.push_back(make_simple<menu::applications_menu>("Game"_(), asset_directory/"icons/icon_category_game.png", loader, xmb, loader, ::menu::categoryFilter("Game")));
     menus.push_back(make_simple<menu::applications_menu>("Application"_(), asset_directory/"icons/icon_category_application.png", loader, xmb, loader));
@@ -73,6 +139,8 @@ void main_menu::preload(vk::Device device, vma::Allocator allocator, dreamrender
 }
 
 result main_menu::on_action(action action) {
+    // Any input may change selection, entries or button labels.
+    dirty = true;
     switch(action) {
         case action::left:
             return select_relative(direction::left) ? result::success | result::ok_sound : result::unsupported | result::error_rumble;
@@ -82,9 +150,18 @@ result main_menu::on_action(action action) {
             return select_relative(direction::up) ? result::success | result::ok_sound : result::unsupported | result::error_rumble;
         case action::down:
             return select_relative(direction::down) ? result::success | result::ok_sound : result::unsupported | result::error_rumble;
+        case action::extra: {
+            // Where the menu has no use for it, extra opens the search
+            std::vector<std::pair<::action, std::string>> buttons;
+            get_button_actions(buttons, in_submenu);
+            if(!uses_extra(buttons)) {
+                xmb->open_search();
+                return result::success | result::ok_sound;
+            }
+            return activate_current(action) ? result::success : result::unsupported | result::error_rumble;
+        }
         case action::ok:
         case action::options:
-        case action::extra:
             return activate_current(action) ? result::success : result::unsupported | result::error_rumble;
         case action::cancel:
             return back() ? (result::success | result::back_sound) : result::unsupported | result::error_rumble;
@@ -94,6 +171,24 @@ result main_menu::on_action(action action) {
     return result::unsupported;
 }
 
+result main_menu::on_text(std::string_view text) {
+    menu::menu* target = current_submenu ? current_submenu : menus[selected].get();
+    if(auto* recv = dynamic_cast<text_receiver*>(target)) {
+        dirty = true;
+        return recv->on_text(text);
+    }
+    return result::unsupported;
+}
+
+result main_menu::on_text_erase() {
+    menu::menu* target = current_submenu ? current_submenu : menus[selected].get();
+    if(auto* recv = dynamic_cast<text_receiver*>(target)) {
+        dirty = true;
+        return recv->on_text_erase();
+    }
+    return result::unsupported;
+}
+
 bool main_menu::select_relative(direction dir) {
     if(!in_submenu) {
         if(dir == direction::left) {
@@ -177,6 +272,91 @@ bool main_menu::back() {
     return false;
 }
 
+void main_menu::get_button_actions(std::vector<std::pair<action, std::string>>& buttons, bool with_submenu) {
+    buttons.reserve(5);
+    menus[selected]->get_button_actions(buttons);
+    if(with_submenu && current_submenu) {
+        current_submenu->get_button_actions(buttons);
+    }
+}
+
+void main_menu::update() {
+    for(const auto& category : menus) {
+        category->update();
+    }
+}
+
+void main_menu::update_search(menu::search_index& index) {
+    std::size_t key = 0;
+    auto mix = [&key](std::size_t v) {
+        key ^= v + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+    };
+    for(const auto& category : menus) {
+        if(search_kind(*category)) {
+            mix(category->get_revision());
+            mix(category->get_submenus_count());
+        }
+    }
+    if(search_key == key) {
+        return;
+    }
+    search_key = key;
+
+    // Only the entries are walked here, the index is built by a job
+    std::vector<menu::search_item> items;
+    std::vector<std::string> location;
+    for(unsigned int i = 0; i < menus.size(); i++) {
+        if(auto kind = search_kind(*menus[i])) {
+            collect_entries(*menus[i], *kind, i, location, items);
+        }
+    }
+    // Games are listed under Application as well, keep them where they came first
+    std::set<std::pair<std::string, std::string>> applications;
+    std::erase_if(items, [&](const menu::search_item& item) {
+        return item.type == menu::search_item::kind::application && !applications.emplace(item.name, item.detail).second;
+    });
+    index.update("menus", std::move(items));
+}
+
+bool main_menu::open(const menu::search_item& item) {
+    if(item.category >= menus.size() || item.location.empty()) {
+        return false;
+    }
+    while(back()) {
+        // leave the open submenus first
+    }
+    select(static_cast<int>(item.category));
+    dirty = true;
+
+    // Walk down the names, opening every menu on the way
+    const menu::menu* current = menus[selected].get();
+    for(std::size_t depth = 0; depth < item.location.size(); depth++) {
+        int index = -1;
+        for(unsigned int i = 0; i < current->get_submenus_count(); i++) {
+            if(current->get_submenu(i).get_name() == item.location[depth]) {
+                index = static_cast<int>(i);
+                break;
+            }
+        }
+        if(index < 0) {
+            return false;
+        }
+        if(depth == 0) {
+            select_menu_item(index);
+        } else {
+            select_submenu_item(index);
+        }
+        if(depth + 1 < item.location.size()) {
+            if(!activate_current(action::ok)) {
+                return false;
+            }
+            current = current_submenu;
+        }
+    }
+    activate_current(action::ok);
+    return true;
+}
+
 void main_menu::select(int index) {
     if(index == selected) {
         return;
@@ -227,34 +407,96 @@ void main_menu::render(dreamrender::gui_renderer& renderer) {
 
     auto now = std::chrono::system_clock::now();
 
+    // Reading the state also lets lazily built menus (files_menu) apply pending
+    // rebuilds, so a changed revision is seen before anything is replayed.
+    const frame_state state = current_state(renderer);
+    bool animating = is_animating(now);
+    if(!animating && !dirty && cached_state == state && !cache.empty()) {
+        cache.replay(renderer, xmb->get_icon_batch(), config::CONFIG.bindlessIcons);
+        return;
+    }
+
+    cache.begin(renderer);
+
     auto time_since_transition = std::chrono::duration<double>(now - last_submenu_transition);
     double partial = std::clamp(time_since_transition / transition_submenu_activate_duration, 0.0, 1.0);
     partial = in_submenu ? partial : 1.0 - partial;
     bool in_submenu_now = in_submenu || partial > 0.0;
 
-    renderer.push_color(glm::mix(active_color, inactive_color, partial));
-    render_crossbar(renderer, now);
-    renderer.pop_color();
+    cache.push_color(glm::mix(active_color, inactive_color, partial));
+    render_crossbar(cache, now);
+    cache.pop_color();
 
-    std::vector<std::pair<action, std::string>> buttons{};
-    buttons.reserve(5);
-    menus[selected]->get_button_actions(buttons);
     if(in_submenu_now && current_submenu) {
-        render_submenu(renderer, now);
-        current_submenu->get_button_actions(buttons);
+        render_submenu(cache, now);
     }
-    xmb->render_controller_buttons(renderer, 0.5f, 0.9f, buttons);
+    std::vector<std::pair<action, std::string>> buttons{};
+    get_button_actions(buttons, in_submenu_now);
+    if(!uses_extra(buttons)) {
+        buttons.emplace_back(action::extra, "Search"_());
+    }
+    xmb->render_controller_buttons(cache, 0.5f, 0.9f, buttons);
+
+    // The filter typed into the open menu, if any
+    const menu::menu* active = current_submenu ? current_submenu : menus[selected].get();
+    if(auto* recv = dynamic_cast<const text_receiver*>(active); recv && !recv->get_text().empty()) {
+        cache.draw_text(std::format("{}: {}", std::string{"Search"_()}, recv->get_text()), 0.5f, 0.84f, 0.04f,
+            glm::vec4(1.0f), true, true);
+    }
+
+    // Record once more after an animation settles so the cache holds the final frame.
+    dirty = animating;
+    cached_state = state;
+    cache.replay(renderer, xmb->get_icon_batch(), config::CONFIG.bindlessIcons);
 }
 
-void main_menu::render_crossbar(dreamrender::gui_renderer& renderer, time_point now) {
+bool main_menu::is_animating(time_point now) const {
+    if(now - last_submenu_transition < transition_submenu_activate_duration) {
+        return true;
+    }
+    if(selected != last_selected && now - last_selected_transition < transition_duration) {
+        return true;
+    }
+    if(menus[selected]->get_selected_submenu() != last_selected_menu_item &&
+       now - last_selected_menu_item_transition <= transition_menu_item_duration) {
+        return true;
+    }
+    if(in_submenu && now - last_selected_submenu_item_transition < transition_submenu_item_duration) {
+        return true;
+    }
+    return false;
+}
+
+main_menu::frame_state main_menu::current_state(const dreamrender::gui_renderer& renderer) const {
+    frame_state state;
+    state.aspect_ratio = renderer.aspect_ratio;
+    state.glass = config::CONFIG.iconGlassRefraction;
+    state.selected = selected;
+    state.in_submenu = in_submenu;
+
+    const auto& menu = *menus[selected];
+    state.entries = menu.get_submenus_count();
+    state.selected_entry = menu.get_selected_submenu();
+    state.revision = menu.get_revision();
+
+    state.submenu = current_submenu;
+    if(current_submenu) {
+        state.submenu_entries = current_submenu->get_submenus_count();
+        state.submenu_selected_entry = current_submenu->get_selected_submenu();
+        state.submenu_revision = current_submenu->get_revision();
+    }
+    return state;
+}
+
+void main_menu::render_crossbar(draw_list& out, time_point now) {
     double submenu_transition = std::clamp(
         std::chrono::duration<double>(now - last_submenu_transition) / transition_submenu_activate_duration, 0.0, 1.0);
     submenu_transition = in_submenu ? submenu_transition : 1.0 - submenu_transition;
     bool in_submenu_now = in_submenu || submenu_transition > 0.0;
 
     const glm::vec2 base_pos = glm::mix(
-        glm::vec2(0.35f/renderer.aspect_ratio, 0.25f),
-        glm::vec2(0.30f/renderer.aspect_ratio, 0.25f),
+        glm::vec2(0.35f/out.aspect_ratio, 0.25f),
+        glm::vec2(0.30f/out.aspect_ratio, 0.25f),
         submenu_transition);
     const double base_size = glm::mix(0.1, 0.075, submenu_transition);
 
@@ -276,29 +518,29 @@ void main_menu::render_crossbar(dreamrender::gui_renderer& renderer, time_point
     }
 
     const auto selected_menu_x = base_pos.x;
-    float x = selected_menu_x - (base_size*1.5f)/renderer.aspect_ratio*real_selection;
+    float x = selected_menu_x - (base_size*1.5f)/out.aspect_ratio*real_selection;
 
     for (int i = 0; i < menus.size(); i++) {
         if(i == selected && in_submenu_now) {
-            x += (base_size*1.5f)/renderer.aspect_ratio;
+            x += (base_size*1.5f)/out.aspect_ratio;
             continue; // the selected menu is rendered as part of the submenu
         }
 
         auto& menu = menus[i];
         if(config::CONFIG.iconGlassRefraction) {
-            renderer.draw_image_glass(menu->get_icon(), x, base_pos.y, base_size, base_size);
+            out.draw_image_glass(menu->get_icon(), x, base_pos.y, base_size, base_size);
         } else {
-            renderer.draw_image_a(menu->get_icon(), x, base_pos.y, base_size, base_size);
+            out.draw_image_a(menu->get_icon(), x, base_pos.y, base_size, base_size);
         }
         if(i == selected) {
     // PS3 behavior: no glow on category label; center it under the icon
-    renderer.draw_text(menu->get_name(), x+(base_size*0.5f)/renderer.aspect_ratio, base_pos.y+base_size, base_size*0.4f, glm::vec4(1, 1, 1, 1), true);
+    out.draw_text(menu->get_name(), x+(base_size*0.5f)/out.aspect_ratio, base_pos.y+base_size, base_size*0.4f, glm::vec4(1, 1, 1, 1), true);
         }
-        x += (base_size*1.5f)/renderer.aspect_ratio;
+        x += (base_size*1.5f)/out.aspect_ratio;
     }
 
     // This is spectacularly bad code, but it will work for now
-    x = selected_menu_x - ((base_size*1.5f)/renderer.aspect_ratio)*(real_selection - selected_f);
+    x = selected_menu_x - ((base_size*1.5f)/out.aspect_ratio)*(real_selection - selected_f);
     auto& menu = menus[selected];
     int selected_submenu = menu->get_selected_submenu();
     float partial_transition = 1.0f;
@@ -312,6 +554,16 @@ void main_menu::render_crossbar(dreamrender::gui_renderer& renderer, time_point
             partial_y = (selected_submenu - last_selected_menu_item) * (1.0f - partial_transition);
         }
     }
+    {
+        // Tell the menu which rows can end up on screen, so lazily built menus
+        // only materialize those instead of the whole list.
+        const float row = base_size*0.65f;
+        const int slack = std::abs(selected_submenu - last_selected_menu_item) * 3 + 1;
+        const int rows_above = static_cast<int>(std::ceil((base_pos.y + base_size*1.5f) / row)) + slack;
+        const int rows_below = static_cast<int>(std::ceil(1.0f / row)) + slack;
+        const int first_row = std::max(0, selected_submenu - rows_above);
+        menu->visible_range(first_row, selected_submenu + rows_below - first_row);
+    }
     {
         float y = base_pos.y - (base_size*1.5f) + partial_y*base_size*1.5f;
         if(last_selected_menu_item > selected_submenu) {
@@ -326,12 +578,12 @@ void main_menu::render_crossbar(dreamrender::gui_renderer& renderer, time_point
         for(int i=selected_submenu-1; i >= 0 && y >= -base_size*0.65f; i--) {
             auto& submenu = menu->get_submenu(i);
             if(config::CONFIG.iconGlassRefraction) {
-                renderer.draw_image_glass(submenu.get_icon(), x+(base_size*0.2f)/renderer.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
+                out.draw_image_glass(submenu.get_icon(), x+(base_size*0.2f)/out.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
             } else {
-                renderer.draw_image_a(submenu.get_icon(), x+(base_size*0.2f)/renderer.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
+                out.draw_image_a(submenu.get_icon(), x+(base_size*0.2f)/out.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
             }
             if(!in_submenu_now)
-                renderer.draw_text(submenu.get_name(), x+(base_size*1.5f)/renderer.aspect_ratio, y+(base_size*0.3f), base_size*0.4f, glm::vec4(0.7, 0.7, 0.7, 1), false, true);
+                out.draw_text(submenu.get_name(), x+(base_size*1.5f)/out.aspect_ratio, y+(base_size*0.3f), base_size*0.4f, glm::vec4(0.7, 0.7, 0.7, 1), false, true);
             y -= base_size*0.65f;
         }
     }
@@ -349,30 +601,13 @@ void main_menu::render_crossbar(dreamrender::gui_renderer& renderer, time_point
                     double size = base_size*glm::mix(0.6, 1.2, partial_transition);
                 double text_size = base_size*glm::mix(0.4, 0.6, partial_transition);
                     if(config::CONFIG.iconGlassRefraction) {
-                        renderer.draw_image_glass(submenu.get_icon(), x+(base_size*0.5f-size/2.0f)/renderer.aspect_ratio, y, size, size);
+                        out.draw_image_glass(submenu.get_icon(), x+(base_size*0.5f-size/2.0f)/out.aspect_ratio, y, size, size);
                     } else {
-                        renderer.draw_image_a(submenu.get_icon(), x+(base_size*0.5f-size/2.0f)/renderer.aspect_ratio, y, size, size);
+                        out.draw_image_a(submenu.get_icon(), x+(base_size*0.5f-size/2.0f)/out.aspect_ratio, y, size, size);
                     }
                     if(!in_submenu_now)
-                        {
-                            // Consistent glow with message overlay (two rings + pulse)
-                            auto t = submenu.get_name();
-                            float tx = x+(base_size*1.5f)/renderer.aspect_ratio;
-                            float ty = y+size/2;
-                            float ts = text_size;
-                            using clock = std::chrono::steady_clock;
-                            static clock::time_point t0 = clock::now();
-                            float pulse = 0.5f + 0.5f*std::sin(std::chrono::duration<float>(clock::now()-t0).count()*3.6f);
-                            float px = 1.3f / static_cast<float>(renderer.frame_size.width);
-                            float py = 1.3f / static_cast<float>(renderer.frame_size.height);
-                            glm::vec4 g1(1.0f,1.0f,1.0f,0.09f*(0.6f+0.4f*pulse));
-                            glm::vec4 g2(1.0f,1.0f,1.0f,0.05f*(0.6f+0.4f*pulse));
-                            const glm::vec2 ring1[8]={{px,0},{-px,0},{0,py},{0,-py},{px,py},{-px,py},{px,-py},{-px,-py}};
-                            for(auto o:ring1) renderer.draw_text(t, tx+o.x, ty+o.y, ts, g1, false, true);
-                            const glm::vec2 ring2[8]={{2*px,0},{-2*px,0},{0,2*py},{0,-2*py},{2*px,2*py},{-2*px,2*py},{2*px,-2*py},{-2*px,-2*py}};
-                            for(auto o:ring2) renderer.draw_text(t, tx+o.x, ty+o.y, ts, g2, false, true);
-                            renderer.draw_text(t, tx, ty, ts, glm::vec4(1, 1, 1, 1), false, true);
-                        }
+                        // Consistent glow with message overlay (two rings + pulse)
+                        out.draw_glow_text(submenu.get_name(), x+(base_size*1.5f)/out.aspect_ratio, y+size/2, text_size);
                 }
                 y += base_size*glm::mix(0.65f, 1.5f, partial_transition);
             }
@@ -380,38 +615,38 @@ void main_menu::render_crossbar(dreamrender::gui_renderer& renderer, time_point
                 double size = base_size*glm::mix(0.6, 1.2, 1.0f-partial_transition);
                 double text_size = base_size*glm::mix(0.4, 0.6, 1.0f-partial_transition);
                 if(config::CONFIG.iconGlassRefraction) {
-                    renderer.draw_image_glass(submenu.get_icon(), x+(0.05f-size/2.0f)/renderer.aspect_ratio, y, size, size);
+                    out.draw_image_glass(submenu.get_icon(), x+(0.05f-size/2.0f)/out.aspect_ratio, y, size, size);
                 } else {
-                    renderer.draw_image_a(submenu.get_icon(), x+(0.05f-size/2.0f)/renderer.aspect_ratio, y, size, size);
+                    out.draw_image_a(submenu.get_icon(), x+(0.05f-size/2.0f)/out.aspect_ratio, y, size, size);
                 }
                 if(!in_submenu_now)
                     // Non-selected submenu entries: no glow, just text
-                    renderer.draw_text(submenu.get_name(), x+(base_size*1.5f)/renderer.aspect_ratio, y+size/2, text_size, glm::vec4(1, 1, 1, 1), false, true);
+                    out.draw_text(submenu.get_name(), x+(base_size*1.5f)/out.aspect_ratio, y+size/2, text_size, glm::vec4(1, 1, 1, 1), false, true);
                 y += base_size*glm::mix(0.65f, 1.5f, 1.0f-partial_transition);
             }
             else {
                 if(config::CONFIG.iconGlassRefraction) {
-                    renderer.draw_image_glass(submenu.get_icon(), x+(base_size*0.2f)/renderer.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
+                    out.draw_image_glass(submenu.get_icon(), x+(base_size*0.2f)/out.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
                 } else {
-                    renderer.draw_image_a(submenu.get_icon(), x+(base_size*0.2f)/renderer.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
+                    out.draw_image_a(submenu.get_icon(), x+(base_size*0.2f)/out.aspect_ratio, y, base_size*0.6f, base_size*0.6f);
                 }
                 if(!in_submenu_now)
-                    renderer.draw_text(submenu.get_name(), x+(base_size*1.5f)/renderer.aspect_ratio, y+base_size*0.3f, base_size*0.4f, glm::vec4(0.7, 0.7, 0.7, 1), false, true);
+                    out.draw_text(submenu.get_name(), x+(base_size*1.5f)/out.aspect_ratio, y+base_size*0.3f, base_size*0.4f, glm::vec4(0.7, 0.7, 0.7, 1), false, true);
                 y += base_size*0.65f;
             }
         }
     }
 }
 
-void main_menu::render_submenu(dreamrender::gui_renderer& renderer, time_point now) {
+void main_menu::render_submenu(draw_list& out, time_point now) {
     double submenu_transition = std::clamp(
         std::chrono::duration<double>(now - last_submenu_transition) / transition_submenu_activate_duration, 0.0, 1.0);
     submenu_transition = in_submenu ? submenu_transition : 1.0 - submenu_transition;
 
     constexpr auto offset = (0.1f-0.075f)/2.0f;
     const glm::vec2 base_pos = glm::mix(
-        glm::vec2(0.35f/renderer.aspect_ratio, 0.25f),
-        glm::vec2((0.15f-offset)/renderer.aspect_ratio, 0.25f-2*offset),
+        glm::vec2(0.35f/out.aspect_ratio, 0.25f),
+        glm::vec2((0.15f-offset)/out.aspect_ratio, 0.25f-2*offset),
         submenu_transition);
     const double base_size = 0.1;
 
@@ -419,11 +654,11 @@ void main_menu::render_submenu(dreamrender::gui_renderer& renderer, time_point n
     const auto& selected_submenu = *current_submenu;
 
     if(config::CONFIG.iconGlassRefraction) {
-        renderer.draw_image_glass(selected_menu.get_icon(), base_pos.x, base_pos.y, 0.1f, 0.1f);
-        renderer.draw_image_glass(selected_submenu.get_icon(), base_pos.x, base_pos.y+0.15f, 0.1f, 0.1f);
+        out.draw_image_glass(selected_menu.get_icon(), base_pos.x, base_pos.y, 0.1f, 0.1f);
+        out.draw_image_glass(selected_submenu.get_icon(), base_pos.x, base_pos.y+0.15f, 0.1f, 0.1f);
     } else {
-        renderer.draw_image_a(selected_menu.get_icon(), base_pos.x, base_pos.y, 0.1f, 0.1f);
-        renderer.draw_image_a(selected_submenu.get_icon(), base_pos.x, base_pos.y+0.15f, 0.1f, 0.1f);
+        out.draw_image_a(selected_menu.get_icon(), base_pos.x, base_pos.y, 0.1f, 0.1f);
+        out.draw_image_a(selected_submenu.get_icon(), base_pos.x, base_pos.y+0.15f, 0.1f, 0.1f);
     }
 
     if(!in_submenu)
@@ -438,7 +673,18 @@ void main_menu::render_submenu(dreamrender::gui_renderer& renderer, time_point n
 
         double offsetY = 0.15f - selected*0.15f;
 
-        for(int i=0; i<submenu->get_submenus_count(); i++) {
+        // Only walk the rows that intersect the screen: y = base_pos.y+offsetY+0.15*i
+        // has to stay within [-size, 1+size] and size never exceeds base_size.
+        const int count = static_cast<int>(submenu->get_submenus_count());
+        const int first = std::max(0,
+            static_cast<int>(std::floor((-base_size - base_pos.y - offsetY) / 0.15)));
+        const int last = std::min(count - 1,
+            static_cast<int>(std::ceil((1.0 + base_size - base_pos.y - offsetY) / 0.15)));
+        if(first > last)
+            return;
+        submenu->visible_range(first, last - first + 1);
+
+        for(int i=first; i<=last; i++) {
             double partial_selection = 0.0;
             if(i == selected) {
                 partial_selection = std::clamp(time_since_transition / transition_submenu_item_duration, 0.0, 1.0);
@@ -453,14 +699,14 @@ void main_menu::render_submenu(dreamrender::gui_renderer& renderer, time_point n
 
             auto& entry = submenu->get_submenu(i);
             if(config::CONFIG.iconGlassRefraction) {
-                renderer.draw_image_glass(entry.get_icon(), base_pos.x + 0.1 + offset, y, size, size);
+                out.draw_image_glass(entry.get_icon(), base_pos.x + 0.1 + offset, y, size, size);
             } else {
-                renderer.draw_image_a(entry.get_icon(), base_pos.x + 0.1 + offset, y, size, size);
+                out.draw_image_a(entry.get_icon(), base_pos.x + 0.1 + offset, y, size, size);
             }
-            renderer.draw_text(entry.get_name(), base_pos.x + 0.2, y+size/2, size/2, glm::vec4(1, 1, 1, 1), false, true);
+            out.draw_text(entry.get_name(), base_pos.x + 0.2, y+size/2, size/2, glm::vec4(1, 1, 1, 1), false, true);
             if(i == selected) {
-                auto s = renderer.measure_text(entry.get_name(), size/2);
-                renderer.draw_text(entry.get_description(), base_pos.x + 0.2, y+size/2 + s.y, size / 3);
+                auto s = out.measure_text(entry.get_name(), size/2);
+                out.draw_text(entry.get_description(), base_pos.x + 0.2, y+size/2 + s.y, size / 3);
             }
         }
     }
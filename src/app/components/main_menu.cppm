@@ -24,12 +24,20 @@
 module;
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 export module openxmb.app:main_menu;
 
 import :menu_base;
+import :draw_list;
+import :search_index;
 import dreamrender;
 import sdl2;
 import vulkan_hpp;
@@ -38,20 +46,56 @@ import openxmb.utils;
 
 namespace app {
 
-class main_menu : public action_receiver {
+class main_menu : public action_receiver, public text_receiver {
     public:
         main_menu(class shell* xmb);
         void preload(vk::Device device, vma::Allocator allocator, dreamrender::resource_loader& loader);
         void render(dreamrender::gui_renderer& renderer);
 
         result on_action(action action) override;
+        // Forwarded to the open menu if it takes text, see menu::files_menu.
+        result on_text(std::string_view text) override;
+        result on_text_erase() override;
+
+        // Forces the cached draw list to be re-recorded on the next frame,
+        // e.g. after textures it references have been replaced.
+        void invalidate() { dirty = true; }
+
+        // Lets every category apply what its background jobs delivered.
+        void update();
+        // Hands the entries of the users, settings and applications categories
+        // to index, whenever one of them changed since the last call.
+        void update_search(menu::search_index& index);
+        // Goes to the entry item was found at and activates it. Returns false
+        // if it is not there anymore.
+        bool open(const menu::search_item& item);
     private:
         using time_point = std::chrono::time_point<std::chrono::system_clock>;
 
         class shell* xmb;
 
-        void render_crossbar(dreamrender::gui_renderer& renderer, time_point now);
-        void render_submenu(dreamrender::gui_renderer& renderer, time_point now);
+        void render_crossbar(draw_list& out, time_point now);
+        void render_submenu(draw_list& out, time_point now);
+
+        // Everything the recorded frame depends on besides animations.
+        struct frame_state {
+            float aspect_ratio = 0.0f;
+            bool glass = false;
+            int selected = 0;
+            bool in_submenu = false;
+            unsigned int entries = 0;
+            unsigned int selected_entry = 0;
+            std::uint64_t revision = 0;
+            const menu::menu* submenu = nullptr;
+            unsigned int submenu_entries = 0;
+            unsigned int submenu_selected_entry = 0;
+            std::uint64_t submenu_revision = 0;
+
+            bool operator==(const frame_state&) const = default;
+        };
+
+        bool is_animating(time_point now) const;
+        frame_state current_state(const dreamrender::gui_renderer& renderer) const;
 
         enum class direction {
             left,
@@ -66,6 +110,7 @@ class main_menu : public action_receiver {
         bool select_relative(direction dir);
         bool activate_current(action action);
         bool back();
+        void get_button_actions(std::vector<std::pair<action, std::string>>& buttons, bool with_submenu);
 
         std::vector<std::unique_ptr<menu::menu>> menus;
         int selected = 0;
@@ -87,6 +132,14 @@ class main_menu : public action_receiver {
         int last_selected_submenu_item = 0;
         time_point last_selected_submenu_item_transition;
         constexpr static auto transition_submenu_item_duration = std::chrono::milliseconds(100);
+
+        // Retained output of the last render; replayed as long as nothing animates
+        // and the state (selection, menu revisions, layout) is unchanged.
+        draw_list cache;
+        std::optional<frame_state> cached_state;
+        bool dirty = true;
+
+        std::optional<std::size_t> search_key; // revisions of the categories last indexed
 };
 
 }
@@ -58,7 +58,11 @@ void news_display::render(dreamrender::gui_renderer& renderer) {
     auto elapsed = std::chrono::duration<float>(now - begin).count() * speed;
 
     std::string_view news = "Lorem ipsum dolor sit amet, consectetur adipiscing elit";
-    float width = renderer.measure_text(news, font_size).x;
+    if(text_width_size != font_size) {
+        text_width = renderer.measure_text(news, font_size).x;
+        text_width_size = font_size;
+    }
+    float width = text_width;
     float x = std::fmod(elapsed, width + spacing);
 
     renderer.set_clip(base_x, base_y, box_width, font_size);
@@ -39,6 +39,10 @@ class news_display {
         void render(dreamrender::gui_renderer& renderer);
     private:
         class shell* shell;
+
+        // Width of the ticker text; measured once instead of every frame
+        float text_width = 0.0f;
+        float text_width_size = 0.0f;
 };
 
 }
@@ -0,0 +1,172 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <string>
+#include <string_view>
+#include <utility>
+
+module openxmb.app;
+import :search_overlay;
+
+import :keyboard_overlay;
+import :search_index;
+
+import dreamrender;
+import glm;
+import i18n;
+import openxmb.utils;
+
+using namespace mfk::i18n::literals;
+
+namespace app {
+
+namespace {
+    std::string kind_label(menu::search_item::kind kind) {
+        switch(kind) {
+            case menu::search_item::kind::application:
+                return "Application"_();
+            case menu::search_item::kind::setting:
+                return "Settings"_();
+            case menu::search_item::kind::user:
+                return "Users"_();
+            case menu::search_item::kind::media:
+            default:
+                return "File"_();
+        }
+    }
+}
+
+search_overlay::search_overlay(class shell* xmb, std::string query) : xmb(xmb), query(std::move(query)) {
+    search();
+}
+
+void search_overlay::search() {
+    // Synchronous: a query only walks the postings of its trigrams, which
+    // takes a few milliseconds even for hundreds of thousands of items
+    auto& index = xmb->get_search_index();
+    searched_revision = index.get_revision();
+    results = index.find(query, max_results);
+    selected = 0;
+}
+
+result search_overlay::tick(class shell* xmb) {
+    // Pick up sources indexed since, e.g. right after startup
+    if(xmb->get_search_index().get_revision() != searched_revision) {
+        auto current = selected < results.size() ? results[selected] : nullptr;
+        search();
+        if(auto it = std::ranges::find(results, current); current && it != results.end()) {
+            selected = static_cast<unsigned int>(it - results.begin());
+        }
+    }
+    return result::success;
+}
+
+result search_overlay::on_text(std::string_view text) {
+    query += text;
+    search();
+    return result::success;
+}
+
+result search_overlay::on_text_erase() {
+    if(query.empty()) {
+        return result::unsupported | result::error_rumble;
+    }
+    // Drop a whole UTF-8 sequence, not just its last byte
+    while(query.size() > 1 && (static_cast<unsigned char>(query.back()) & 0xc0) == 0x80) {
+        query.pop_back();
+    }
+    query.pop_back();
+    search();
+    return result::success;
+}
+
+result search_overlay::on_action(action action) {
+    switch(action) {
+        case action::up:
+            if(selected == 0) {
+                return result::unsupported | result::error_rumble;
+            }
+            selected--;
+            return result::success | result::ok_sound;
+        case action::down:
+            if(selected + 1 >= results.size()) {
+                return result::unsupported | result::error_rumble;
+            }
+            selected++;
+            return result::success | result::ok_sound;
+        case action::ok:
+            if(selected >= results.size()) {
+                return result::unsupported | result::error_rumble;
+            }
+            xmb->open_search_result(*results[selected]);
+            return result::close | result::confirm_sound;
+        case action::extra:
+            xmb->emplace_overlay<keyboard_overlay>(*this);
+            return result::success | result::ok_sound;
+        case action::cancel:
+            return result::close | result::back_sound;
+        default:
+            return result::unsupported;
+    }
+}
+
+void search_overlay::render(dreamrender::gui_renderer& renderer, class shell* xmb) {
+    renderer.draw_rect(glm::vec2(0.0f, 0.15f), glm::vec2(1.0f, 2.0/renderer.frame_size.height), glm::vec4(0.7f, 0.7f, 0.7f, 1.0f));
+    renderer.draw_rect(glm::vec2(0.0f, 0.85f), glm::vec2(1.0f, 2.0/renderer.frame_size.height), glm::vec4(0.7f, 0.7f, 0.7f, 1.0f));
+
+    renderer.draw_text(std::string{"Search"_()}, 0.075f, 0.125f, 0.05f);
+    renderer.draw_text(std::format("{}_", query), 0.075f, 0.2f, 0.05f, glm::vec4(1.0f), false, true);
+
+    constexpr float top = 0.27f;
+    constexpr float row_height = 0.07f;
+    if(results.empty()) {
+        renderer.draw_text(std::string{query.empty() ? "Type to search"_() : "No results"_()}, 0.5f, 0.5f, 0.04f,
+            glm::vec4(0.7f, 0.7f, 0.7f, 1.0f), true, true);
+    }
+    // Keep the selection in view, a few rows from the top
+    const unsigned int count = static_cast<unsigned int>(results.size());
+    const unsigned int first = count > visible_rows ? std::min(selected - std::min(selected, 3u), count - visible_rows) : 0;
+    for(unsigned int i = first; i < count && i < first + visible_rows; i++) {
+        const auto& item = *results[i];
+        const float y = top + row_height * static_cast<float>(i - first);
+        const bool is_selected = i == selected;
+        if(is_selected) {
+            renderer.draw_rect(glm::vec2{0.06f, y - 0.005f}, glm::vec2{0.88f, row_height - 0.01f}, glm::vec4(1.0f, 1.0f, 1.0f, 0.15f));
+        }
+        const glm::vec4 colour = is_selected ? glm::vec4(1.0f) : glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
+        renderer.draw_text(item.name, 0.075f, y + 0.02f, 0.04f, colour, false, true);
+        auto detail = kind_label(item.type);
+        if(!item.detail.empty()) {
+            detail += " - " + item.detail;
+        }
+        renderer.draw_text(detail, 0.075f, y + 0.045f, 0.025f, colour * glm::vec4(0.8f, 0.8f, 0.8f, 1.0f), false, true);
+    }
+
+    xmb->render_controller_buttons(renderer, 0.5f, 0.9f, std::array{
+        std::pair{action::ok, "Open"},
+        std::pair{action::extra, "Keyboard"},
+        std::pair{action::cancel, "Back"},
+    });
+}
+
+}
@@ -0,0 +1,70 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module openxmb.app:search_overlay;
+
+import dreamrender;
+import openxmb.utils;
+import :component;
+import :search_index;
+
+namespace app {
+
+// Searches applications, settings, users and media files at once, see
+// menu::search_index. Results follow every key typed; ok opens the selected
+// one, extra brings up the on-screen keyboard.
+export class search_overlay : public component, public action_receiver, public text_receiver {
+    public:
+        search_overlay(class shell* xmb, std::string query = {});
+
+        result tick(class shell* xmb) override;
+        void render(dreamrender::gui_renderer& renderer, class shell* xmb) override;
+        result on_action(action action) override;
+
+        result on_text(std::string_view text) override;
+        result on_text_erase() override;
+        std::string_view get_text() const override {
+            return query;
+        }
+
+        [[nodiscard]] bool is_opaque() const override { return true; }
+        [[nodiscard]] bool do_fade_in() const override { return true; }
+        [[nodiscard]] bool do_fade_out() const override { return true; }
+    private:
+        static constexpr std::size_t max_results = 50;
+        static constexpr unsigned int visible_rows = 8;
+
+        void search();
+
+        class shell* xmb;
+        std::string query;
+        std::vector<std::shared_ptr<const menu::search_item>> results;
+        unsigned int selected = 0;
+        std::uint64_t searched_revision = 0; // of the index the results come from
+};
+
+}
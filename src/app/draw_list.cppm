@@ -0,0 +1,195 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module openxmb.app:draw_list;
+
+import dreamrender;
+import openxmb.render;
+import glm;
+import vulkan_hpp;
+
+namespace app {
+
+// Retained list of GUI draw calls. A component records into it with the same
+// calls it would issue on a gui_renderer and replays it on later frames for as
+// long as its state does not change, skipping menu traversal, virtual entry
+// lookups and text measurement entirely.
+//
+// Only pointers to textures are kept, so the owner must re-record (or clear)
+// whenever a texture it referenced may have been destroyed.
+export class draw_list {
+    public:
+        double aspect_ratio = 1.0;
+        vk::Extent2D frame_size{};
+
+        // Starts a new recording; the renderer is only used for measuring text.
+        void begin(dreamrender::gui_renderer& renderer) {
+            commands.clear();
+            measure = &renderer;
+            aspect_ratio = renderer.aspect_ratio;
+            frame_size = renderer.frame_size;
+        }
+        void clear() {
+            commands.clear();
+            measure = nullptr;
+        }
+        [[nodiscard]] bool empty() const {
+            return commands.empty();
+        }
+
+        glm::vec2 measure_text(std::string_view text, float size) {
+            return measure->measure_text(text, size);
+        }
+
+        void draw_image(const dreamrender::texture& texture, float x, float y, float width, float height) {
+            commands.push_back({command::kind::image, &texture, {}, x, y, width, height});
+        }
+        void draw_image_a(const dreamrender::texture& texture, float x, float y, float width, float height) {
+            commands.push_back({command::kind::image_alpha, &texture, {}, x, y, width, height});
+        }
+        void draw_image_glass(const dreamrender::texture& texture, float x, float y, float width, float height) {
+            commands.push_back({command::kind::image_glass, &texture, {}, x, y, width, height});
+        }
+        // Atlas regions can only be drawn through an icon batch on replay.
+        void draw_region(const render::atlas_region& region, float x, float y, float width, float height) {
+            commands.push_back({command::kind::region, nullptr, {}, x, y, width, height, glm::vec4(1.0f), false, false, region});
+        }
+        void draw_text(std::string_view text, float x, float y, float size, glm::vec4 color = glm::vec4(1.0f),
+            bool center_x = false, bool center_y = false)
+        {
+            commands.push_back({command::kind::text, nullptr, std::string(text), x, y, size, 0.0f, color, center_x, center_y});
+        }
+        // Text with the pulsing two-ring glow used for the selected item. The
+        // pulse is evaluated at replay time, so it keeps animating while the
+        // rest of the list stays cached.
+        void draw_glow_text(std::string_view text, float x, float y, float size) {
+            commands.push_back({command::kind::glow_text, nullptr, std::string(text), x, y, size});
+        }
+        void push_color(glm::vec4 color) {
+            commands.push_back({command::kind::push_color, nullptr, {}, 0.0f, 0.0f, 0.0f, 0.0f, color});
+        }
+        void pop_color() {
+            commands.push_back({command::kind::pop_color});
+        }
+
+        // Replays the list. With a batch renderer atlas regions, and alpha
+        // images too if batch_images is set, are drawn first in one instanced
+        // call and everything else follows, so icons end up beneath text; the
+        // lists recorded by menus never rely on the opposite order.
+        void replay(dreamrender::gui_renderer& renderer, render::icon_batch_renderer* batch = nullptr,
+            bool batch_images = false) const
+        {
+            batch_images = batch_images && batch;
+            if(batch) {
+                std::vector<glm::vec4> colors{glm::vec4(1.0f)};
+                for(const auto& c : commands) {
+                    switch(c.type) {
+                        case command::kind::image_alpha:
+                            if(!batch_images) break;
+                            batch->add(*c.texture, glm::vec4(c.x, c.y, c.w / static_cast<float>(aspect_ratio), c.h), colors.back());
+                            break;
+                        case command::kind::region:
+                            batch->add(c.region, glm::vec4(c.x, c.y, c.w, c.h), colors.back());
+                            break;
+                        case command::kind::push_color:
+                            colors.push_back(colors.back() * c.color);
+                            break;
+                        case command::kind::pop_color:
+                            if(colors.size() > 1) colors.pop_back();
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                batch->flush(renderer.get_command_buffer());
+            }
+            for(const auto& c : commands) {
+                switch(c.type) {
+                    case command::kind::image:
+                        renderer.draw_image(*c.texture, c.x, c.y, c.w, c.h);
+                        break;
+                    case command::kind::image_alpha:
+                        if(!batch_images) {
+                            renderer.draw_image_a(*c.texture, c.x, c.y, c.w, c.h);
+                        }
+                        break;
+                    case command::kind::image_glass:
+                        renderer.draw_image_glass(*c.texture, c.x, c.y, c.w, c.h);
+                        break;
+                    case command::kind::region:
+                        break;
+                    case command::kind::text:
+                        renderer.draw_text(c.text, c.x, c.y, c.w, c.color, c.center_x, c.center_y);
+                        break;
+                    case command::kind::glow_text:
+                        replay_glow_text(renderer, c);
+                        break;
+                    case command::kind::push_color:
+                        renderer.push_color(c.color);
+                        break;
+                    case command::kind::pop_color:
+                        renderer.pop_color();
+                        break;
+                }
+            }
+        }
+    private:
+        struct command {
+            enum class kind {
+                image, image_alpha, image_glass, region, text, glow_text, push_color, pop_color
+            };
+            kind type;
+            const dreamrender::texture* texture = nullptr;
+            std::string text;
+            float x = 0.0f, y = 0.0f;
+            float w = 0.0f, h = 0.0f; // text size is stored in w
+            glm::vec4 color{1.0f};
+            bool center_x = false;
+            bool center_y = false;
+            render::atlas_region region{};
+        };
+
+        static void replay_glow_text(dreamrender::gui_renderer& renderer, const command& c) {
+            // Consistent glow with message overlay (two rings + pulse)
+            using clock = std::chrono::steady_clock;
+            static clock::time_point t0 = clock::now();
+            float pulse = 0.5f + 0.5f*std::sin(std::chrono::duration<float>(clock::now()-t0).count()*3.6f);
+            float px = 1.3f / static_cast<float>(renderer.frame_size.width);
+            float py = 1.3f / static_cast<float>(renderer.frame_size.height);
+            glm::vec4 g1(1.0f,1.0f,1.0f,0.09f*(0.6f+0.4f*pulse));
+            glm::vec4 g2(1.0f,1.0f,1.0f,0.05f*(0.6f+0.4f*pulse));
+            const glm::vec2 ring1[8]={{px,0},{-px,0},{0,py},{0,-py},{px,py},{-px,py},{px,-py},{-px,-py}};
+            for(auto o:ring1) renderer.draw_text(c.text, c.x+o.x, c.y+o.y, c.w, g1, false, true);
+            const glm::vec2 ring2[8]={{2*px,0},{-2*px,0},{0,2*py},{0,-2*py},{2*px,2*py},{-2*px,2*py},{2*px,-2*py},{-2*px,-2*py}};
+            for(auto o:ring2) renderer.draw_text(c.text, c.x+o.x, c.y+o.y, c.w, g2, false, true);
+            renderer.draw_text(c.text, c.x, c.y, c.w, glm::vec4(1, 1, 1, 1), false, true);
+        }
+
+        std::vector<command> commands;
+        dreamrender::gui_renderer* measure = nullptr;
+};
+
+}
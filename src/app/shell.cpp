@@ -30,6 +30,8 @@ module;
 #include <memory>
 #include <ranges>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
@@ -52,9 +54,17 @@ import openxmb.config;
 import openxmb.constants;
 import openxmb.render;
 import openxmb.debug;
+import openxmb.jobs;
 import openxmb.utils;
 import :startup_overlay;
 import :message_overlay;
+import :texture_cache;
+import :thumbnail_cache;
+import :media_library;
+import :programs;
+import :removable_media;
+import :search_index;
+import :search_overlay;
 
 using namespace mfk::i18n::literals;
 
@@ -83,6 +93,21 @@ namespace app
         wave_render = std::make_unique<render::wave_renderer>(device, allocator, win->swapchainExtent);
         original_render = std::make_unique<render::original_renderer>(device, win->swapchainExtent);
         particles_render = std::make_unique<render::particles_renderer>(device, allocator, win->swapchainExtent);
+        uploader = std::make_unique<render::texture_uploader>(device, allocator, win->swapchainImageCount);
+        thumbnails = std::make_unique<menu::thumbnail_cache>(allocator, *uploader);
+        library = std::make_unique<menu::media_library>(std::vector{
+            config::CONFIG.picturesPath, config::CONFIG.musicPath, config::CONFIG.videosPath});
+        library->refresh();
+        removable = std::make_unique<menu::removable_media>(*library);
+        search = std::make_unique<menu::search_index>();
+        const auto enabledFeatures = render::device_features::from_chain(&win->deviceFeatures);
+        compressed_textures = std::make_unique<app::compressed_texture_cache>(win->physicalDevice, enabledFeatures, *uploader);
+        if(render::icon_batch_renderer::is_supported(win->physicalDevice, enabledFeatures)) {
+            icon_batch = std::make_unique<render::icon_batch_renderer>(device, allocator, win->swapchainExtent);
+            buttonAtlas = std::make_unique<render::texture_atlas>(*uploader, 256);
+        } else {
+            spdlog::info("Descriptor indexing is not enabled on this device, drawing icons individually");
+        }
 
         {
             std::array<vk::AttachmentDescription, 2> attachments = {
@@ -210,11 +235,11 @@ namespace app
         wave_render->preload({backgroundRenderPass.get()}, win->config.sampleCount, win->pipelineCache.get());
         original_render->preload({backgroundRenderPass.get()}, win->config.sampleCount, win->pipelineCache.get());
         particles_render->preload({backgroundRenderPass.get()}, win->config.sampleCount, win->pipelineCache.get());
-
-        if(config::CONFIG.backgroundType == config::config::background_type::image) {
-            backgroundTexture = std::make_unique<texture>(device, allocator);
-            loader->loadTexture(backgroundTexture.get(), config::CONFIG.backgroundImage);
+        if(icon_batch) {
+            icon_batch->preload({shellRenderPass.get()}, win->config.sampleCount, win->pipelineCache.get(), win->swapchainImageCount);
         }
+
+        reload_background();
         config::CONFIG.addCallback("background-type", [this](const std::string&){
             if(config::CONFIG.backgroundType == config::config::background_type::image) {
                 reload_background();
@@ -445,6 +470,7 @@ namespace app
         auto now = std::chrono::steady_clock::now();
 
         commandBuffer.begin(vk::CommandBufferBeginInfo());
+        uploader->record(commandBuffer);
         for(auto& overlay : std::views::reverse(overlays)) {
             overlay->prerender(commandBuffer, frame, this);
         }
@@ -1027,6 +1053,9 @@ namespace app
                 0.0f, 0.0f, static_cast<int>(win->swapchainExtent.width), static_cast<int>(win->swapchainExtent.height));
 
             gui_renderer ctx(commandBuffer, frame, shellRenderPass.get(), win->swapchainExtent, font_render.get(), image_render.get(), simple_render.get());
+            if(icon_batch) {
+                icon_batch->begin_frame(frame, shellRenderPass.get());
+            }
             // Interface/FX debug overlays: draw font atlas for verification
             if(openxmb::debug::interfacefx_debug) {
                 const dreamrender::texture* atlas = font_render->get_atlas();
@@ -1087,53 +1116,60 @@ namespace app
             if(overlay_transition || has_overlay || fading_out_message) {
                 // Fade UI to transparency: scale RGB and A together by (1 - progress)
                 float s = 1.0f - static_cast<float>(dir_progress);
-                renderer.push_color(glm::vec4(s, s, s, s));
+                push_color(renderer, glm::vec4(s, s, s, s));
             }
             // Quick zoom via gui_renderer helper so viewport/scissor are applied per draw
             const bool pushed_zoom = (top_is_message || fading_out_message);
             if(pushed_zoom) {
                 float scale = static_cast<float>(glm::mix(1.0, 0.85, dir_progress));
-                renderer.push_zoom(scale);
+                push_zoom(renderer, scale);
             }
             // Render the entire XMB UI (menu + time + news) within the zoom scope
             menu.render(renderer);
 
+            // The clock text only changes once per second; reformat it lazily.
+            auto system_now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+            if(system_now != clock_text_time || clock_text_format != config::CONFIG.dateTimeFormat) {
 #if __cpp_lib_chrono >= 201907L || defined(__GLIBCXX__)
-            static const std::chrono::time_zone* timezone = [](){
-                auto tz = std::chrono::current_zone();
-                auto system = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
-                auto local = std::chrono::zoned_time(tz, system);
-                spdlog::debug("{}", std::format("Timezone: {}, System Time: {}, Local Time: {}", tz->name(), system, local));
-                return tz;
-            }();
-            auto local_now = std::chrono::zoned_time(timezone, std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+                static const std::chrono::time_zone* timezone = [](){
+                    auto tz = std::chrono::current_zone();
+                    auto system = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+                    auto local = std::chrono::zoned_time(tz, system);
+                    spdlog::debug("{}", std::format("Timezone: {}, System Time: {}, Local Time: {}", tz->name(), system, local));
+                    return tz;
+                }();
+                auto local_now = std::chrono::zoned_time(timezone, system_now);
 #else
-            auto local_now = std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now());
+                auto local_now = system_now;
 #endif
-            renderer.draw_text(std::vformat("{:"+config::CONFIG.dateTimeFormat+"}", std::make_format_args(local_now)),
+                clock_text = std::vformat("{:"+config::CONFIG.dateTimeFormat+"}", std::make_format_args(local_now));
+                clock_text_time = system_now;
+                clock_text_format = config::CONFIG.dateTimeFormat;
+            }
+            renderer.draw_text(clock_text,
                 static_cast<float>(0.831770833f+config::CONFIG.dateTimeOffset), 0.086111111f, 0.021296296f*2.5f);
 
             news.render(renderer);
-            if(pushed_zoom) renderer.pop_zoom();
+            if(pushed_zoom) pop_zoom(renderer);
             if(overlay_transition || has_overlay || fading_out_message) {
-                renderer.pop_color();
+                pop_color(renderer);
             }
 
         }
 
         for(unsigned int i=overlay_begin; i < overlays.size(); i++) {
             if(i == overlays.size()-1 && overlay_transition) {
-                renderer.push_color(glm::mix(glm::vec4(0.0), glm::vec4(1.0), dir_progress));
+                push_color(renderer, glm::mix(glm::vec4(0.0), glm::vec4(1.0), dir_progress));
                 overlays[i]->render(renderer, this);
-                renderer.pop_color();
+                pop_color(renderer);
             } else {
                 overlays[i]->render(renderer, this);
             }
         }
             if(overlay_transition && overlay_fade_direction == transition_direction::out && old_overlay) {
-                renderer.push_color(glm::mix(glm::vec4(0.0), glm::vec4(1.0), dir_progress));
+                push_color(renderer, glm::mix(glm::vec4(0.0), glm::vec4(1.0), dir_progress));
                 old_overlay->render(renderer, this);
-                renderer.pop_color();
+                pop_color(renderer);
         } else if(old_overlay) {
             // Fade-out finished; if it was a message overlay, drop background blur now
             if(dynamic_cast<app::message_overlay*>(old_overlay.get()) != nullptr) {
@@ -1162,14 +1198,57 @@ namespace app
     }
 
     void shell::reload_background() {
-        if(config::CONFIG.backgroundType == config::config::background_type::image) {
-            backgroundTexture = std::make_unique<texture>(device, allocator);
-            loader->loadTexture(backgroundTexture.get(), config::CONFIG.backgroundImage);
+        if(config::CONFIG.backgroundType != config::config::background_type::image) {
+            return;
+        }
+        const auto generation = ++background_generation;
+        // The background is never shown larger than the screen.
+        const unsigned int max_size = std::max(win->swapchainExtent.width, win->swapchainExtent.height);
+        auto load_uncompressed = [this, generation, max_size]() {
+            // Still shrunk to the screen on a job, only loaded as it is if that fails
+            jobs::scheduler::instance().submit([this, generation, max_size, file = config::CONFIG.backgroundImage](std::stop_token) {
+                auto image = ::menu::decode_thumbnail(file, max_size);
+                jobs::scheduler::instance().post_main([this, generation, image = std::move(image)]() mutable {
+                    if(generation != background_generation ||
+                        config::CONFIG.backgroundType != config::config::background_type::image)
+                    {
+                        return;
+                    }
+                    uploader->retire(std::move(backgroundTexture));
+                    if(image) {
+                        backgroundTexture = uploader->create(std::move(image->pixels), image->width, image->height);
+                    } else {
+                        backgroundTexture = std::make_unique<texture>(device, allocator);
+                        loader->loadTexture(backgroundTexture.get(), config::CONFIG.backgroundImage);
+                    }
+                });
+            });
+        };
+        if(!compressed_textures->supported()) {
+            load_uncompressed();
+            return;
         }
+        compressed_textures->load(config::CONFIG.backgroundImage, max_size,
+            [this, generation, load_uncompressed](std::unique_ptr<texture> tex) {
+                if(generation != background_generation ||
+                    config::CONFIG.backgroundType != config::config::background_type::image)
+                {
+                    uploader->retire(std::move(tex));
+                } else if(tex) {
+                    uploader->retire(std::move(backgroundTexture));
+                    backgroundTexture = std::move(tex);
+                } else {
+                    load_uncompressed();
+                }
+            });
     }
     void shell::reload_button_icons() {
         auto controller_type = get_controller_type();
 
+        if(buttonAtlas) {
+            buttonAtlas->clear();
+        }
+        buttonRegions.fill(std::nullopt);
         for(std::underlying_type_t<action> i = std::to_underlying(action::none)+1; i < std::to_underlying(action::_length); i++) {
             auto a = static_cast<action>(i);
             if(controller_type == "none") {
@@ -1179,9 +1258,23 @@ namespace app
             std::string_view name = utils::enum_name(a);
             std::filesystem::path icon_name = config::CONFIG.asset_directory / "icons" / std::format("icon_button_{}_{}.png", controller_type, name);
 
+            if(buttonAtlas && !config::CONFIG.iconGlassRefraction) {
+                if(auto image = ::menu::decode_thumbnail(icon_name, render::texture_atlas::max_region)) {
+                    buttonRegions[i] = buttonAtlas->add(image->pixels, image->width, image->height);
+                }
+                if(buttonRegions[i]) {
+                    buttonTextures[i].reset();
+                    continue;
+                }
+            }
             buttonTextures[i] = std::make_unique<texture>(device, allocator);
             loader->loadTexture(buttonTextures[i].get(), icon_name);
         }
+        if(buttonAtlas) {
+            buttonAtlas->commit();
+        }
+        // The menu's retained draw list points at the old button textures.
+        menu.invalidate();
     }
     std::string shell::get_controller_type() const {
         auto type = config::CONFIG.controllerType;
@@ -1209,10 +1302,29 @@ namespace app
     }
 
     void shell::tick() {
+        // Completions of background jobs, e.g. the background texture
+        jobs::scheduler::instance().drain_main();
         if(background_only) {
             return;
         }
 
+        thumbnails->tick();
+        removable->poll(); // USB drives and SD cards coming and going
+        menu.update();
+
+        // Keep the search index up to date; both only hand work to a job
+        menu.update_search(*search);
+        if(search_library_revision != library->get_revision()) {
+            search_library_revision = library->get_revision();
+            search->update("media", [files = library->files()] {
+                std::vector<menu::search_item> items;
+                files.for_each_file([&items](const std::filesystem::path& dir, const menu::media_info& info) {
+                    items.push_back({menu::search_item::kind::media, std::string(info.name), dir.string()});
+                });
+                return items;
+            });
+        }
+
         for(unsigned int i=0; i<2; i++) {
             if(last_controller_axis_input[i]) {
                 auto time_since_input = std::chrono::duration<double>(std::chrono::steady_clock::now() - last_controller_axis_input_time[i]);
@@ -1263,6 +1375,60 @@ namespace app
 
         handle(menu.on_action(action));
     }
+    void shell::dispatch_text(std::string_view text) {
+        if(background_only) {
+            return;
+        }
+        for(auto& e : overlays | std::views::reverse) {
+            if(auto* recv = dynamic_cast<text_receiver*>(e.get())) {
+                handle(recv->on_text(text));
+                return;
+            }
+        }
+        auto res = menu.on_text(text);
+        if(res == result::unsupported && overlays.empty()) {
+            open_search(std::string(text));
+            return;
+        }
+        handle(res);
+    }
+    void shell::dispatch_text_erase() {
+        if(background_only) {
+            return;
+        }
+        for(auto& e : overlays | std::views::reverse) {
+            if(auto* recv = dynamic_cast<text_receiver*>(e.get())) {
+                handle(recv->on_text_erase());
+                return;
+            }
+        }
+        handle(menu.on_text_erase());
+    }
+    void shell::open_search(std::string text) {
+        emplace_overlay<app::search_overlay>(this, std::move(text));
+    }
+
+    void shell::open_search_result(const menu::search_item& item) {
+        if(item.type != menu::search_item::kind::media) {
+            if(!menu.open(item)) {
+                spdlog::warn("Search result {} is not in the menu anymore", item.name);
+            }
+            return;
+        }
+        const auto file = std::filesystem::path(item.detail) / item.name;
+        auto open_infos = programs::get_open_infos(file, programs::file_info(file));
+        if(!open_infos.empty()) {
+            if(auto component = open_infos[0].create(file, *loader)) {
+                push_overlay(std::move(component));
+                return;
+            }
+        }
+        emplace_overlay<app::message_overlay>(
+            "Cannot Open File"_(),
+            "No suitable program found to open this file type."_()
+        );
+    }
+
     void shell::handle(result result) {
         if(result & result::error_rumble) {
             if(config::CONFIG.controllerRumble) {
@@ -1325,6 +1491,16 @@ namespace app
             case SDLK_CAPSLOCK:
                 dispatch(action::extra);
                 break;
+            case SDLK_BACKSPACE:
+                dispatch_text_erase();
+                break;
+            default:
+                // Printable keys type into menus that filter, e.g. files_menu
+                if(key.sym >= ' ' && key.sym <= '~') {
+                    const char c = static_cast<char>(key.sym);
+                    dispatch_text(std::string_view(&c, 1));
+                }
+                break;
         }
     }
 
@@ -27,6 +27,8 @@ module;
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -43,10 +45,15 @@ import vulkan_hpp;
 import :component;
 import :choice_overlay;
 import :main_menu;
+import :media_library;
+import :removable_media;
 import :message_overlay;
 import :news_display;
 import :progress_overlay;
+import :search_index;
 import :startup_overlay;
+import :texture_cache;
+import :thumbnail_cache;
 
 namespace app
 {
@@ -85,10 +92,15 @@ namespace app
             void reload_language();
 
             void dispatch(action action);
+            // Typed text goes to the topmost overlay that takes it, otherwise to
+            // the menu; if that does not take it either, it starts a search.
+            void dispatch_text(std::string_view text);
+            void dispatch_text_erase();
             void handle(result result);
 
             std::string get_controller_type() const;
-            void render_controller_buttons(gui_renderer& renderer, float x, float y, std::ranges::range auto buttons) {
+            // Works on a gui_renderer directly or on an app::draw_list being recorded.
+            void render_controller_buttons(auto& renderer, float x, float y, std::ranges::range auto buttons) {
                 constexpr float min_width = 0.2f;
                 constexpr float size = 0.05f;
                 float size_x = static_cast<float>(size/renderer.aspect_ratio);
@@ -103,11 +115,20 @@ namespace app
                 }
 
                 float current_x = x - total_width/2;
+                bool batched = false;
                 for (const auto& [action, text] : buttons) {
                     auto icon = buttonTextures[std::to_underlying(action)].get();
+                    const auto& region = buttonRegions[std::to_underlying(action)];
                     float width = std::max(min_width, size_x/1.25f+renderer.measure_text(text, size).x);
-                    if(action != action::none && icon) {
-                        if(config::CONFIG.iconGlassRefraction) {
+                    if(action != action::none && (icon || region)) {
+                        if(region) {
+                            if constexpr (requires { renderer.draw_region(*region, 0.0f, 0.0f, 0.0f, 0.0f); }) {
+                                renderer.draw_region(*region, current_x, y, size/2.0f, size/2.0f);
+                            } else {
+                                icon_batch->add(*region, glm::vec4(current_x, y, size/2.0f, size/2.0f), glm::vec4(1.0f));
+                                batched = true;
+                            }
+                        } else if(config::CONFIG.iconGlassRefraction) {
                             renderer.draw_image_glass(*icon, current_x, y, size/2.0, size/2.0);
                         } else {
                             renderer.draw_image(*icon, current_x, y, size/2.0, size/2.0);
@@ -116,9 +137,23 @@ namespace app
                     }
                     current_x += width;
                 }
+                if constexpr (requires { renderer.get_command_buffer(); }) {
+                    if(batched) {
+                        icon_batch->flush(renderer.get_command_buffer());
+                    }
+                }
             }
 
             dreamrender::window* get_window() const { return this->win; }
+            render::texture_uploader& get_texture_uploader() { return *uploader; }
+            menu::thumbnail_cache& get_thumbnail_cache() { return *thumbnails; }
+            menu::media_library& get_media_library() { return *library; }
+            menu::removable_media& get_removable_media() { return *removable; }
+            menu::search_index& get_search_index() { return *search; }
+            // Opens the search overlay, see app::search_overlay.
+            void open_search(std::string text = {});
+            void open_search_result(const menu::search_item& item);
+            render::icon_batch_renderer* get_icon_batch() const { return icon_batch.get(); }
 
             void set_ingame_mode(bool ingame_mode) { this->ingame_mode = ingame_mode; }
             bool get_ingame_mode() const { return ingame_mode; }
@@ -247,9 +282,24 @@ namespace app
             std::vector<vk::UniqueFramebuffer> framebuffers;
 
             std::unique_ptr<texture> backgroundTexture;
+            // Declared before the menus, whose entries hold on to cached thumbnails.
+            std::unique_ptr<render::texture_uploader> uploader;
+            std::unique_ptr<menu::thumbnail_cache> thumbnails;
+            std::unique_ptr<menu::media_library> library;
+            std::unique_ptr<menu::removable_media> removable;
+            std::unique_ptr<menu::search_index> search;
+            std::optional<std::uint64_t> search_library_revision; // of the media files indexed last
+            std::unique_ptr<app::compressed_texture_cache> compressed_textures;
+            std::uint64_t background_generation = 0;
+            // Created whenever the device can run it: atlas regions always go
+            // through it, other icons only with the bindless-icons option.
+            std::unique_ptr<render::icon_batch_renderer> icon_batch;
+            // Button glyphs share an atlas when they can be drawn through icon_batch.
+            std::unique_ptr<render::texture_atlas> buttonAtlas;
             main_menu menu{this};
             news_display news{this};
             std::array<std::unique_ptr<texture>, std::to_underlying(action::_length)> buttonTextures;
+            std::array<std::optional<render::atlas_region>, std::to_underlying(action::_length)> buttonRegions;
             // Extra descriptor pool and sets for downsample/upsample chain
             vk::UniqueDescriptorPool blurExtraDescriptorPool;
             vk::DescriptorSet downsampleSet;
@@ -270,6 +320,23 @@ namespace app
             void preload_fixed_components();
 
             void render_gui(gui_renderer& renderer);
+            // State pushed on the renderer is mirrored into the icon batch.
+            void push_color(gui_renderer& renderer, glm::vec4 color) {
+                renderer.push_color(color);
+                if(icon_batch) icon_batch->push_color(color);
+            }
+            void pop_color(gui_renderer& renderer) {
+                renderer.pop_color();
+                if(icon_batch) icon_batch->pop_color();
+            }
+            void push_zoom(gui_renderer& renderer, float scale) {
+                renderer.push_zoom(scale);
+                if(icon_batch) icon_batch->push_zoom(scale);
+            }
+            void pop_zoom(gui_renderer& renderer) {
+                renderer.pop_zoom();
+                if(icon_batch) icon_batch->pop_zoom();
+            }
 
             // input handling
             constexpr static int controller_axis_input_threshold = 10000;
@@ -297,6 +364,11 @@ namespace app
 
             std::optional<clipboard> clipboard;
 
+            // Formatted clock text, refreshed when the second or the format changes
+            std::string clock_text;
+            std::chrono::sys_seconds clock_text_time{};
+            std::string clock_text_format;
+
             // transition duration constants
             constexpr static auto blur_background_transition_duration = std::chrono::milliseconds(500);
             // Slightly longer fade, PS3-like but still snappy
@@ -0,0 +1,238 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+extern "C" {
+#include <libavutil/md5.h>
+#include <libavutil/mem.h>
+}
+
+module openxmb.app;
+
+import :texture_cache;
+import :thumbnail_cache;
+
+import dreamrender;
+import openxmb.jobs;
+import openxmb.render;
+import spdlog;
+import vulkan_hpp;
+
+namespace app {
+
+namespace {
+    constexpr std::array<char, 4> magic = {'O', 'X', 'T', 'C'};
+    // Bump whenever the encoders or the file layout change.
+    constexpr std::uint32_t version = 1;
+    // Largest image we accept from the cache, to reject corrupt headers.
+    constexpr std::uint32_t max_dimension = 16384;
+
+    std::filesystem::path default_root() {
+        if(const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+            return std::filesystem::path(cache) / "openxmb" / "textures";
+        }
+        const char* home = std::getenv("HOME");
+        return std::filesystem::path(home ? home : "") / ".cache" / "openxmb" / "textures";
+    }
+
+    // MD5 of the file content, so renamed or touched files still hit the cache.
+    std::optional<std::string> content_hash(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        if(!in) {
+            return std::nullopt;
+        }
+        AVMD5* md5 = av_md5_alloc();
+        if(!md5) {
+            return std::nullopt;
+        }
+        av_md5_init(md5);
+        std::vector<char> buffer(256 * 1024);
+        while(in) {
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            av_md5_update(md5, reinterpret_cast<const std::uint8_t*>(buffer.data()), static_cast<std::size_t>(in.gcount()));
+        }
+        std::array<std::uint8_t, 16> digest{};
+        av_md5_final(md5, digest.data());
+        av_free(md5);
+
+        std::string hex;
+        hex.reserve(digest.size() * 2);
+        for(auto b : digest) {
+            hex += std::format("{:02x}", b);
+        }
+        return hex;
+    }
+
+    template<typename T>
+    bool read_value(std::istream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+    template<typename T>
+    void write_value(std::ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
+compressed_texture_cache::compressed_texture_cache(vk::PhysicalDevice physicalDevice,
+    const render::device_features& features, render::texture_uploader& uploader)
+    : physicalDevice(physicalDevice), features(features), uploader(uploader), root(default_root())
+{
+    bc_or_etc2 = render::choose_compressed_format(physicalDevice, features, true).has_value();
+    if(!bc_or_etc2) {
+        spdlog::info("No block-compressed texture format enabled on this device, textures stay uncompressed");
+    }
+}
+
+compressed_texture_cache::~compressed_texture_cache() = default;
+
+void compressed_texture_cache::load(const std::filesystem::path& path, unsigned int max_size, callback done) {
+    if(!bc_or_etc2) {
+        done(nullptr);
+        return;
+    }
+    loads.submit([this, path, max_size, done = std::move(done)](std::stop_token token) mutable {
+        std::optional<image> data;
+        try {
+            data = get_or_compress(path, max_size);
+        } catch(const std::exception& e) {
+            spdlog::warn("Failed to compress {}: {}", path.string(), e.what());
+        }
+        loads.post_main([this, data = std::move(data), done = std::move(done)]() mutable {
+            std::unique_ptr<dreamrender::texture> tex;
+            if(data) {
+                try {
+                    tex = uploader.create(std::move(data->blocks), data->width, data->height,
+                        render::vulkan_format(data->format));
+                } catch(const std::exception& e) {
+                    spdlog::warn("Failed to create compressed texture: {}", e.what());
+                }
+            }
+            done(std::move(tex));
+        }, token);
+    });
+}
+
+bool compressed_texture_cache::usable(render::compressed_format format) const {
+    const bool alpha = format == render::compressed_format::bc3 || format == render::compressed_format::etc2_rgba;
+    return render::choose_compressed_format(physicalDevice, features, alpha) == format;
+}
+
+std::optional<compressed_texture_cache::image> compressed_texture_cache::get_or_compress(
+    const std::filesystem::path& path, unsigned int max_size) const
+{
+    auto hash = content_hash(path);
+    if(!hash) {
+        return std::nullopt;
+    }
+    const auto file = root / std::format("{}-{}.oxtc", *hash, max_size);
+    if(auto cached = read_cached(file); cached && usable(cached->format)) {
+        return cached;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto decoded = ::menu::decode_thumbnail(path, max_size);
+    if(!decoded) {
+        return std::nullopt;
+    }
+    const bool alpha = render::has_alpha(decoded->pixels.data(), std::size_t{decoded->width} * decoded->height);
+    auto format = render::choose_compressed_format(physicalDevice, features, alpha);
+    if(!format) {
+        return std::nullopt;
+    }
+    image img{*format, decoded->width, decoded->height,
+        render::compress(decoded->pixels.data(), decoded->width, decoded->height, *format)};
+    spdlog::debug("Compressed {} ({}x{}) in {} ms", path.string(), img.width, img.height,
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    write_cached(file, img);
+    return img;
+}
+
+std::optional<compressed_texture_cache::image> compressed_texture_cache::read_cached(const std::filesystem::path& file) const {
+    std::ifstream in(file, std::ios::binary);
+    if(!in) {
+        return std::nullopt;
+    }
+    std::array<char, 4> m{};
+    std::uint32_t v = 0, format = 0, width = 0, height = 0;
+    std::uint64_t size = 0;
+    if(!read_value(in, m) || m != magic || !read_value(in, v) || v != version ||
+        !read_value(in, format) || !read_value(in, width) || !read_value(in, height) || !read_value(in, size))
+    {
+        return std::nullopt;
+    }
+    if(format > static_cast<std::uint32_t>(render::compressed_format::etc2_rgba) || width == 0 || height == 0 ||
+        width > max_dimension || height > max_dimension)
+    {
+        return std::nullopt;
+    }
+    image img{static_cast<render::compressed_format>(format), width, height, {}};
+    if(size != render::compressed_size(img.format, width, height)) {
+        return std::nullopt;
+    }
+    img.blocks.resize(size);
+    if(!in.read(reinterpret_cast<char*>(img.blocks.data()), static_cast<std::streamsize>(size))) {
+        return std::nullopt;
+    }
+    return img;
+}
+
+void compressed_texture_cache::write_cached(const std::filesystem::path& file, const image& img) const {
+    try {
+        std::filesystem::create_directories(file.parent_path());
+        // Write to a temporary file and rename, so readers never see a partial file.
+        auto temp = file;
+        temp += std::format(".{}.tmp", ::getpid());
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            write_value(out, magic);
+            write_value(out, version);
+            write_value(out, static_cast<std::uint32_t>(img.format));
+            write_value(out, static_cast<std::uint32_t>(img.width));
+            write_value(out, static_cast<std::uint32_t>(img.height));
+            write_value(out, static_cast<std::uint64_t>(img.blocks.size()));
+            out.write(reinterpret_cast<const char*>(img.blocks.data()), static_cast<std::streamsize>(img.blocks.size()));
+            if(!out) {
+                std::filesystem::remove(temp);
+                return;
+            }
+        }
+        std::filesystem::rename(temp, file);
+    } catch(const std::exception& e) {
+        spdlog::debug("Failed to cache compressed texture {}: {}", file.string(), e.what());
+    }
+}
+
+}
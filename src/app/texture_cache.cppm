@@ -0,0 +1,86 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+export module openxmb.app:texture_cache;
+
+import dreamrender;
+import openxmb.jobs;
+import openxmb.render;
+import vulkan_hpp;
+
+export namespace app {
+
+// Block-compressed textures for large, long-lived images such as the
+// background, cached on disk so warm starts skip decoding and encoding.
+//
+// Images are decoded and compressed to the best BC or ETC2 format the device
+// can sample by a job on the shared scheduler; the result is stored under
+// $XDG_CACHE_HOME/openxmb/textures keyed by a hash of the file content, so
+// later loads upload the compressed blocks directly.
+class compressed_texture_cache {
+    public:
+        using callback = std::function<void(std::unique_ptr<dreamrender::texture>)>;
+
+        compressed_texture_cache(vk::PhysicalDevice physicalDevice, const render::device_features& features,
+            render::texture_uploader& uploader);
+        ~compressed_texture_cache();
+
+        // Whether the device has any format we encode enabled. If not, callers
+        // should keep loading textures uncompressed.
+        [[nodiscard]] bool supported() const {
+            return bc_or_etc2;
+        }
+
+        // Loads path scaled to fit max_size. done is called on the main
+        // thread with a texture whose upload has been queued, or nullptr on
+        // failure. It is not called once the cache is destroyed.
+        void load(const std::filesystem::path& path, unsigned int max_size, callback done);
+
+        // Reads the compressed image cached for path, compressing and storing
+        // it first if needed. Safe to call from any thread.
+        struct image {
+            render::compressed_format format;
+            unsigned int width = 0;
+            unsigned int height = 0;
+            std::vector<std::uint8_t> blocks;
+        };
+        std::optional<image> get_or_compress(const std::filesystem::path& path, unsigned int max_size) const;
+    private:
+        std::optional<image> read_cached(const std::filesystem::path& file) const;
+        void write_cached(const std::filesystem::path& file, const image& img) const;
+        bool usable(render::compressed_format format) const;
+
+        vk::PhysicalDevice physicalDevice;
+        render::device_features features;
+        render::texture_uploader& uploader;
+        std::filesystem::path root;
+        bool bc_or_etc2 = false;
+
+        jobs::group loads{jobs::priority::normal}; // last, so it stops before the rest goes
+};
+
+}
@@ -145,6 +145,14 @@ void config::load_from_json() {
                 setThemeCustomColour(shell["theme-custom-colour"].get<std::string>());
             }
             
+            if (shell.contains("excluded-paths")) {
+                excludedPaths = shell["excluded-paths"].get<std::vector<std::string>>();
+            }
+
+            if (shell.contains("library-views")) {
+                libraryViews = shell["library-views"].get<bool>();
+            }
+
             if (shell.contains("excluded-applications")) {
                 excludedApplications.clear();
                 for (const auto& app : shell["excluded-applications"]) {
@@ -211,6 +219,9 @@ void config::load_from_json() {
             if (render.contains("icon-glass-refraction")) {
                 iconGlassRefraction = render["icon-glass-refraction"].get<bool>();
             }
+            if (render.contains("bindless-icons")) {
+                bindlessIcons = render["bindless-icons"].get<bool>();
+            }
         }
         
         spdlog::info("Configuration loaded successfully");
@@ -255,6 +266,9 @@ void config::save_to_json() {
         config["shell"]["music-path"] = musicPath.string();
         config["shell"]["videos-path"] = videosPath.string();
         
+        config["shell"]["excluded-paths"] = excludedPaths;
+        config["shell"]["library-views"] = libraryViews;
+
         config["shell"]["excluded-applications"] = nlohmann::json::array();
         for (const auto& app : excludedApplications) {
             config["shell"]["excluded-applications"].push_back(app);
@@ -280,6 +294,7 @@ void config::save_to_json() {
         config["render"]["show-fps"] = showFPS;
         config["render"]["show-mem"] = showMemory;
         config["render"]["icon-glass-refraction"] = iconGlassRefraction;
+        config["render"]["bindless-icons"] = bindlessIcons;
         
         // Write to file
         std::ofstream config_file(config_path);
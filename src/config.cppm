@@ -29,7 +29,9 @@ module;
 #include <filesystem>
 #include <functional>
 #include <map>
+#include <string>
 #include <unordered_set>
+#include <vector>
 #include <version>
 
 #include <glm/vec3.hpp>
@@ -95,6 +97,7 @@ export namespace config
             bool showFPS    = false;
             bool showMemory = false;
             bool iconGlassRefraction = false;
+            bool bindlessIcons = false;
 
             std::filesystem::path   fontPath;
             background_type			backgroundType = background_type::original;
@@ -115,6 +118,10 @@ export namespace config
             std::filesystem::path   videosPath;
 
             std::unordered_set<std::string> excludedApplications;
+            // fnmatch(3) patterns that recursive crawls skip, see menu::exclusion_rules
+            std::vector<std::string> excludedPaths;
+            // Show Photo, Music and Video as flattened views grouped by month
+            bool libraryViews = false;
 
             bool controllerRumble = true;
             bool controllerAnalogStick = true;
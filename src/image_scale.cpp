@@ -0,0 +1,422 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <numbers>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define OPENXMB_DISPATCH_AVX2 1
+#endif
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+module openxmb.utils;
+
+namespace utils {
+
+namespace {
+    constexpr int precision = 14; // fraction bits of the weights
+    constexpr std::int32_t round_half = 1 << (precision - 1);
+
+    // How the output pixels along one axis are made from the source pixels:
+    // output i is the sum of source pixels start[i] + t times values[i * taps + t].
+    // Every output has the same number of taps, padded with zero weights, and
+    // start is moved back where needed so no tap reads past the end.
+    struct weights {
+        unsigned int taps = 0;
+        std::vector<std::uint32_t> start;
+        std::vector<std::int16_t> values;
+    };
+
+    double lanczos3(double x) {
+        x = std::abs(x);
+        if(x < 1e-9) {
+            return 1.0;
+        }
+        if(x >= 3.0) {
+            return 0.0;
+        }
+        const double px = std::numbers::pi * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+
+    weights make_weights(unsigned int in, unsigned int out, scale_filter filter) {
+        const double scale = static_cast<double>(in) / out;
+        std::vector<std::uint32_t> first(out);
+        std::vector<std::vector<std::int16_t>> all(out);
+        std::vector<double> w;
+        unsigned int taps = 1;
+        for(unsigned int i = 0; i < out; i++) {
+            // Source pixels [lo, hi) that may contribute
+            unsigned int lo = 0, hi = 0;
+            w.clear();
+            if(filter == scale_filter::area) {
+                // The share of every source pixel covered by the output pixel
+                const double begin = i * scale, end = (i + 1) * scale;
+                lo = static_cast<unsigned int>(begin);
+                hi = std::min(in, static_cast<unsigned int>(std::ceil(end)));
+                for(unsigned int x = lo; x < hi; x++) {
+                    w.push_back(std::min<double>(x + 1, end) - std::max<double>(x, begin));
+                }
+            } else {
+                const double center = (i + 0.5) * scale, support = 3.0 * scale;
+                lo = static_cast<unsigned int>(std::max(0.0, std::floor(center - support)));
+                hi = std::min(in, static_cast<unsigned int>(std::ceil(center + support)));
+                for(unsigned int x = lo; x < hi; x++) {
+                    w.push_back(lanczos3((x + 0.5 - center) / scale));
+                }
+            }
+            double total = 0.0;
+            for(double v : w) total += v;
+
+            // Quantize so the weights sum to exactly 1.0, then drop zeros at the ends
+            std::vector<std::int16_t> q(w.size());
+            std::int32_t sum = 0;
+            std::size_t largest = 0;
+            for(std::size_t t = 0; t < w.size(); t++) {
+                q[t] = static_cast<std::int16_t>(std::lround(w[t] / total * (1 << precision)));
+                sum += q[t];
+                if(q[t] > q[largest]) largest = t;
+            }
+            q[largest] = static_cast<std::int16_t>(q[largest] + (1 << precision) - sum);
+            auto nonzero = [](std::int16_t v) { return v != 0; };
+            const auto b = std::ranges::find_if(q, nonzero);
+            const auto e = std::ranges::find_if(q.rbegin(), q.rend(), nonzero).base();
+            first[i] = lo + static_cast<unsigned int>(b - q.begin());
+            all[i].assign(b, e);
+            taps = std::max(taps, static_cast<unsigned int>(all[i].size()));
+        }
+
+        weights result;
+        result.taps = taps;
+        result.start.resize(out);
+        result.values.assign(std::size_t{out} * taps, 0);
+        for(unsigned int i = 0; i < out; i++) {
+            const unsigned int start = std::min(first[i], in - taps);
+            result.start[i] = start;
+            std::ranges::copy(all[i], result.values.begin() + std::size_t{i} * taps + (first[i] - start));
+        }
+        return result;
+    }
+
+    std::uint8_t clamp_pixel(std::int32_t sum) {
+        return static_cast<std::uint8_t>(std::clamp(sum >> precision, 0, 255));
+    }
+
+    void horizontal_scalar(const std::uint8_t* src, std::uint8_t* dst, unsigned int out, const weights& w) {
+        for(unsigned int x = 0; x < out; x++) {
+            const std::uint8_t* p = src + std::size_t{w.start[x]} * 4;
+            const std::int16_t* k = &w.values[std::size_t{x} * w.taps];
+            std::int32_t sum[4] = {round_half, round_half, round_half, round_half};
+            for(unsigned int t = 0; t < w.taps; t++) {
+                for(int c = 0; c < 4; c++) {
+                    sum[c] += p[t * 4 + c] * k[t];
+                }
+            }
+            for(int c = 0; c < 4; c++) {
+                dst[x * 4 + c] = clamp_pixel(sum[c]);
+            }
+        }
+    }
+
+    // rows[t] is the source row of tap t; bytes is the length of a row.
+    void vertical_scalar(const std::uint8_t* const* rows, const std::int16_t* k, unsigned int taps,
+        std::uint8_t* dst, std::size_t from, std::size_t bytes)
+    {
+        for(std::size_t x = from; x < bytes; x++) {
+            std::int32_t sum = round_half;
+            for(unsigned int t = 0; t < taps; t++) {
+                sum += rows[t][x] * k[t];
+            }
+            dst[x] = clamp_pixel(sum);
+        }
+    }
+
+    // Two 16-bit weights side by side, as _mm_madd_epi16 pairs them up
+    [[maybe_unused]] std::int32_t weight_pair(std::int16_t a, std::int16_t b) {
+        return static_cast<std::int32_t>(static_cast<std::uint16_t>(a) | (static_cast<std::uint32_t>(static_cast<std::uint16_t>(b)) << 16));
+    }
+
+    [[maybe_unused]] std::uint32_t load_pixel(const std::uint8_t* p) {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+#ifdef __SSE2__
+    void horizontal_sse2(const std::uint8_t* src, std::uint8_t* dst, unsigned int out, const weights& w) {
+        const __m128i zero = _mm_setzero_si128();
+        for(unsigned int x = 0; x < out; x++) {
+            const std::uint8_t* p = src + std::size_t{w.start[x]} * 4;
+            const std::int16_t* k = &w.values[std::size_t{x} * w.taps];
+            __m128i sum = _mm_set1_epi32(round_half);
+            unsigned int t = 0;
+            for(; t + 1 < w.taps; t += 2) {
+                // Two pixels interleaved by channel: r0 r1 g0 g1 b0 b1 a0 a1
+                const __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + t * 4)), zero);
+                const __m128i pairs = _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, 8));
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_set1_epi32(weight_pair(k[t], k[t + 1]))));
+            }
+            if(t < w.taps) {
+                const __m128i pixel = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(load_pixel(p + t * 4))), zero);
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(pixel, zero), _mm_set1_epi32(weight_pair(k[t], 0))));
+            }
+            sum = _mm_srai_epi32(sum, precision);
+            const std::uint32_t result = static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(_mm_packs_epi32(sum, sum), zero)));
+            std::memcpy(dst + std::size_t{x} * 4, &result, sizeof(result));
+        }
+    }
+
+    void vertical_sse2(const std::uint8_t* const* rows, const std::int16_t* k, unsigned int taps,
+        std::uint8_t* dst, std::size_t from, std::size_t bytes)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        std::size_t x = from;
+        for(; x + 16 <= bytes; x += 16) {
+            __m128i s0 = _mm_set1_epi32(round_half), s1 = s0, s2 = s0, s3 = s0;
+            for(unsigned int t = 0; t < taps; t += 2) {
+                const bool pair = t + 1 < taps;
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + x));
+                const __m128i b = pair ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t + 1] + x)) : zero;
+                const __m128i kk = _mm_set1_epi32(weight_pair(k[t], pair ? k[t + 1] : 0));
+                const __m128i alo = _mm_unpacklo_epi8(a, zero), blo = _mm_unpacklo_epi8(b, zero);
+                const __m128i ahi = _mm_unpackhi_epi8(a, zero), bhi = _mm_unpackhi_epi8(b, zero);
+                s0 = _mm_add_epi32(s0, _mm_madd_epi16(_mm_unpacklo_epi16(alo, blo), kk));
+                s1 = _mm_add_epi32(s1, _mm_madd_epi16(_mm_unpackhi_epi16(alo, blo), kk));
+                s2 = _mm_add_epi32(s2, _mm_madd_epi16(_mm_unpacklo_epi16(ahi, bhi), kk));
+                s3 = _mm_add_epi32(s3, _mm_madd_epi16(_mm_unpackhi_epi16(ahi, bhi), kk));
+            }
+            const __m128i lo = _mm_packs_epi32(_mm_srai_epi32(s0, precision), _mm_srai_epi32(s1, precision));
+            const __m128i hi = _mm_packs_epi32(_mm_srai_epi32(s2, precision), _mm_srai_epi32(s3, precision));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+        }
+        vertical_scalar(rows, k, taps, dst, x, bytes);
+    }
+#endif
+
+#ifdef OPENXMB_DISPATCH_AVX2
+    // Same as vertical_sse2, 32 bytes at a time. Unpacking and packing both
+    // stay within 128-bit lanes, so the bytes come out in order.
+    __attribute__((target("avx2")))
+    void vertical_avx2(const std::uint8_t* const* rows, const std::int16_t* k, unsigned int taps,
+        std::uint8_t* dst, std::size_t bytes)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        std::size_t x = 0;
+        for(; x + 32 <= bytes; x += 32) {
+            __m256i s0 = _mm256_set1_epi32(round_half), s1 = s0, s2 = s0, s3 = s0;
+            for(unsigned int t = 0; t < taps; t += 2) {
+                const bool pair = t + 1 < taps;
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[t] + x));
+                const __m256i b = pair ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[t + 1] + x)) : zero;
+                const __m256i kk = _mm256_set1_epi32(weight_pair(k[t], pair ? k[t + 1] : 0));
+                const __m256i alo = _mm256_unpacklo_epi8(a, zero), blo = _mm256_unpacklo_epi8(b, zero);
+                const __m256i ahi = _mm256_unpackhi_epi8(a, zero), bhi = _mm256_unpackhi_epi8(b, zero);
+                s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_unpacklo_epi16(alo, blo), kk));
+                s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_unpackhi_epi16(alo, blo), kk));
+                s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_unpacklo_epi16(ahi, bhi), kk));
+                s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_unpackhi_epi16(ahi, bhi), kk));
+            }
+            const __m256i lo = _mm256_packs_epi32(_mm256_srai_epi32(s0, precision), _mm256_srai_epi32(s1, precision));
+            const __m256i hi = _mm256_packs_epi32(_mm256_srai_epi32(s2, precision), _mm256_srai_epi32(s3, precision));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_packus_epi16(lo, hi));
+        }
+        vertical_sse2(rows, k, taps, dst, x, bytes);
+    }
+#endif
+
+#ifdef __ARM_NEON
+    void horizontal_neon(const std::uint8_t* src, std::uint8_t* dst, unsigned int out, const weights& w) {
+        for(unsigned int x = 0; x < out; x++) {
+            const std::uint8_t* p = src + std::size_t{w.start[x]} * 4;
+            const std::int16_t* k = &w.values[std::size_t{x} * w.taps];
+            int32x4_t sum = vdupq_n_s32(round_half);
+            for(unsigned int t = 0; t < w.taps; t++) {
+                const uint8x8_t pixel = vreinterpret_u8_u32(vdup_n_u32(load_pixel(p + t * 4)));
+                sum = vmlal_n_s16(sum, vget_low_s16(vreinterpretq_s16_u16(vmovl_u8(pixel))), k[t]);
+            }
+            const int16x4_t narrow = vqmovn_s32(vshrq_n_s32(sum, precision));
+            const uint8x8_t packed = vqmovun_s16(vcombine_s16(narrow, narrow));
+            const std::uint32_t result = vget_lane_u32(vreinterpret_u32_u8(packed), 0);
+            std::memcpy(dst + std::size_t{x} * 4, &result, sizeof(result));
+        }
+    }
+
+    void vertical_neon(const std::uint8_t* const* rows, const std::int16_t* k, unsigned int taps,
+        std::uint8_t* dst, std::size_t bytes)
+    {
+        std::size_t x = 0;
+        for(; x + 16 <= bytes; x += 16) {
+            int32x4_t s0 = vdupq_n_s32(round_half), s1 = s0, s2 = s0, s3 = s0;
+            for(unsigned int t = 0; t < taps; t++) {
+                const uint8x16_t a = vld1q_u8(rows[t] + x);
+                const int16x8_t lo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(a)));
+                const int16x8_t hi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(a)));
+                s0 = vmlal_n_s16(s0, vget_low_s16(lo), k[t]);
+                s1 = vmlal_n_s16(s1, vget_high_s16(lo), k[t]);
+                s2 = vmlal_n_s16(s2, vget_low_s16(hi), k[t]);
+                s3 = vmlal_n_s16(s3, vget_high_s16(hi), k[t]);
+            }
+            const int16x8_t lo = vcombine_s16(vqmovn_s32(vshrq_n_s32(s0, precision)), vqmovn_s32(vshrq_n_s32(s1, precision)));
+            const int16x8_t hi = vcombine_s16(vqmovn_s32(vshrq_n_s32(s2, precision)), vqmovn_s32(vshrq_n_s32(s3, precision)));
+            vst1q_u8(dst + x, vcombine_u8(vqmovun_s16(lo), vqmovun_s16(hi)));
+        }
+        vertical_scalar(rows, k, taps, dst, x, bytes);
+    }
+#endif
+
+    [[maybe_unused]] bool has_avx2() {
+#ifdef OPENXMB_DISPATCH_AVX2
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+#else
+        return false;
+#endif
+    }
+
+    void horizontal(const std::uint8_t* src, std::uint8_t* dst, unsigned int out, const weights& w, bool vectorized) {
+#if defined(__SSE2__)
+        if(vectorized) return horizontal_sse2(src, dst, out, w);
+#elif defined(__ARM_NEON)
+        if(vectorized) return horizontal_neon(src, dst, out, w);
+#endif
+        horizontal_scalar(src, dst, out, w);
+    }
+
+    void vertical(const std::uint8_t* const* rows, const std::int16_t* k, unsigned int taps,
+        std::uint8_t* dst, std::size_t bytes, bool vectorized)
+    {
+#ifdef OPENXMB_DISPATCH_AVX2
+        if(vectorized && has_avx2()) return vertical_avx2(rows, k, taps, dst, bytes);
+#endif
+#if defined(__SSE2__)
+        if(vectorized) return vertical_sse2(rows, k, taps, dst, 0, bytes);
+#elif defined(__ARM_NEON)
+        if(vectorized) return vertical_neon(rows, k, taps, dst, bytes);
+#endif
+        vertical_scalar(rows, k, taps, dst, 0, bytes);
+    }
+
+    bool has_alpha(const std::uint8_t* pixels, std::size_t count) {
+        for(std::size_t i = 0; i < count; i++) {
+            if(pixels[i * 4 + 3] != 255) return true;
+        }
+        return false;
+    }
+
+    // Filtering straight RGBA lets the colour of transparent pixels, often
+    // black, bleed into the edges of the opaque ones next to them as a halo.
+    std::vector<std::uint8_t> premultiply(const std::uint8_t* pixels, std::size_t count) {
+        std::vector<std::uint8_t> out(pixels, pixels + count * 4);
+        for(std::size_t i = 0; i < out.size(); i += 4) {
+            const unsigned int a = out[i + 3];
+            for(int c = 0; c < 3; c++) {
+                out[i + c] = static_cast<std::uint8_t>((out[i + c] * a + 127) / 255);
+            }
+        }
+        return out;
+    }
+
+    void unpremultiply(std::vector<std::uint8_t>& pixels) {
+        for(std::size_t i = 0; i < pixels.size(); i += 4) {
+            const unsigned int a = pixels[i + 3];
+            if(a == 255) continue;
+            for(int c = 0; c < 3; c++) {
+                // Lanczos can ring colour above its alpha, which is no valid premultiplied pixel
+                const unsigned int v = std::min<unsigned int>(pixels[i + c], a);
+                pixels[i + c] = a == 0 ? 0 : static_cast<std::uint8_t>((v * 255 + a / 2) / a);
+            }
+        }
+    }
+
+    std::vector<std::uint8_t> resample(const std::uint8_t* pixels, unsigned int width, unsigned int height,
+        unsigned int dst_width, unsigned int dst_height, scale_filter filter, bool vectorized)
+    {
+        const auto wx = make_weights(width, dst_width, filter);
+        const auto wy = make_weights(height, dst_height, filter);
+        const std::size_t src_stride = std::size_t{width} * 4, dst_stride = std::size_t{dst_width} * 4;
+
+        // Horizontally first, but only the rows the vertical pass reads
+        std::vector<std::uint8_t> columns(dst_stride * height);
+        const unsigned int first_row = wy.start.front(), last_row = wy.start.back() + wy.taps;
+        for(unsigned int y = first_row; y < last_row; y++) {
+            horizontal(pixels + y * src_stride, columns.data() + y * dst_stride, dst_width, wx, vectorized);
+        }
+
+        std::vector<std::uint8_t> result(dst_stride * dst_height);
+        std::vector<const std::uint8_t*> rows(wy.taps);
+        for(unsigned int y = 0; y < dst_height; y++) {
+            for(unsigned int t = 0; t < wy.taps; t++) {
+                rows[t] = columns.data() + (wy.start[y] + t) * dst_stride;
+            }
+            vertical(rows.data(), &wy.values[std::size_t{y} * wy.taps], wy.taps, result.data() + y * dst_stride, dst_stride, vectorized);
+        }
+        return result;
+    }
+}
+
+std::vector<std::uint8_t> downscale_rgba(std::span<const std::uint8_t> pixels, unsigned int width, unsigned int height,
+    unsigned int dst_width, unsigned int dst_height, scale_filter filter, bool vectorized)
+{
+    if(dst_width == 0 || dst_height == 0 || dst_width > width || dst_height > height ||
+        pixels.size() < std::size_t{width} * height * 4)
+    {
+        throw std::invalid_argument("downscale_rgba: bad image or target size");
+    }
+    // Opaque images, most photos, skip the conversion both ways
+    const bool alpha = has_alpha(pixels.data(), std::size_t{width} * height);
+    std::vector<std::uint8_t> premultiplied;
+    const std::uint8_t* src = pixels.data();
+    if(alpha) {
+        premultiplied = premultiply(src, std::size_t{width} * height);
+        src = premultiplied.data();
+    }
+
+    std::vector<std::uint8_t> result;
+    if(filter != scale_filter::automatic) {
+        result = resample(src, width, height, dst_width, dst_height, filter, vectorized);
+    } else if(width >= 4 * dst_width || height >= 4 * dst_height) {
+        // Lanczos costs taps in proportion to the ratio, so large ratios are
+        // mostly done by averaging, which looks the same from 2:1 on.
+        const unsigned int w = std::min(width, 2 * dst_width), h = std::min(height, 2 * dst_height);
+        const auto halfway = resample(src, width, height, w, h, scale_filter::area, vectorized);
+        result = resample(halfway.data(), w, h, dst_width, dst_height, scale_filter::lanczos, vectorized);
+    } else {
+        result = resample(src, width, height, dst_width, dst_height, scale_filter::lanczos, vectorized);
+    }
+    if(alpha) {
+        unpremultiply(result);
+    }
+    return result;
+}
+
+}
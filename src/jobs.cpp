@@ -0,0 +1,235 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+module openxmb.jobs;
+
+import spdlog;
+
+namespace jobs {
+
+namespace {
+    // Worker index of the current thread within its scheduler, if any.
+    thread_local const scheduler* current_scheduler = nullptr;
+    thread_local unsigned int current_index = 0;
+}
+
+scheduler& scheduler::instance() {
+    static scheduler s;
+    return s;
+}
+
+scheduler::scheduler(unsigned int count) {
+    if(count == 0) {
+        count = std::max(2u, std::thread::hardware_concurrency());
+    }
+    for(unsigned int i = 0; i < count; i++) {
+        queues.push_back(std::make_unique<worker_queue>());
+    }
+    for(unsigned int i = 0; i < count; i++) {
+        threads.emplace_back([this, i](std::stop_token stop) { run(i, stop); });
+    }
+    spdlog::debug("Job scheduler started with {} workers", count);
+}
+
+scheduler::~scheduler() {
+    for(auto& t : threads) {
+        t.request_stop();
+    }
+    wake.notify_all();
+    threads.clear();
+}
+
+void scheduler::submit(job fn, std::stop_token token, priority p) {
+    const unsigned int index = current_scheduler == this ? current_index
+        : next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+    {
+        auto& q = *queues[index];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks[static_cast<std::size_t>(p)].push_back({std::move(fn), std::move(token)});
+    }
+    queued.fetch_add(1);
+    {
+        // Pairs with the predicate check in run(), so the wakeup cannot be lost.
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+bool scheduler::pop(unsigned int index, task& out) {
+    const std::size_t n = queues.size();
+    for(std::size_t p = 0; p < 3; p++) {
+        {
+            auto& own = *queues[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if(!own.tasks[p].empty()) {
+                out = std::move(own.tasks[p].back());
+                own.tasks[p].pop_back();
+                return true;
+            }
+        }
+        for(std::size_t k = 1; k < n; k++) {
+            auto& victim = *queues[(index + k) % n];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+            if(lock.owns_lock() && !victim.tasks[p].empty()) {
+                out = std::move(victim.tasks[p].front());
+                victim.tasks[p].pop_front();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void scheduler::run(unsigned int index, std::stop_token stop) {
+    current_scheduler = this;
+    current_index = index;
+    while(!stop.stop_requested()) {
+        task t;
+        if(!pop(index, t)) {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            // Stealing uses try_lock, so recheck periodically while work is queued.
+            wake.wait_for(lock, stop, std::chrono::milliseconds(queued.load() > 0 ? 1 : 100),
+                [this] { return queued.load() > 0; });
+            if(queued.load() == 0) {
+                continue;
+            }
+            lock.unlock();
+            if(!pop(index, t)) {
+                continue;
+            }
+        }
+        queued.fetch_sub(1);
+        if(t.token.stop_requested()) {
+            continue;
+        }
+        try {
+            t.fn(t.token);
+        } catch(const std::exception& e) {
+            spdlog::error("Unhandled exception in job: {}", e.what());
+        }
+    }
+}
+
+void scheduler::post_main(std::function<void()> fn, std::stop_token token) {
+    std::lock_guard<std::mutex> lock(main_mutex);
+    main_tasks.push_back({std::move(fn), std::move(token)});
+}
+
+void scheduler::drain_main() {
+    std::vector<main_task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(main_mutex);
+        tasks.swap(main_tasks);
+    }
+    for(auto& t : tasks) {
+        if(t.token.stop_requested()) {
+            continue;
+        }
+        try {
+            t.fn();
+        } catch(const std::exception& e) {
+            spdlog::error("Unhandled exception in main thread completion: {}", e.what());
+        }
+    }
+}
+
+group::group(priority p, scheduler& s) : sched(s), default_priority(p) {}
+
+group::~group() {
+    {
+        // Not cancel(): the source must stay stopped, so completions posted by
+        // jobs that are still finishing are dropped too.
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        stop.request_stop();
+    }
+    wait();
+}
+
+void group::submit(job fn) {
+    submit(std::move(fn), default_priority);
+}
+
+void group::submit(job fn, priority p) {
+    std::stop_token token;
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->outstanding++;
+        token = stop.get_token();
+    }
+    // Submitted without a token: the wrapper has to run even when cancelled
+    // to balance the count, it only skips fn then.
+    sched.submit([s = shared, fn = std::move(fn), token = std::move(token)](std::stop_token) {
+        // Decrement even if fn throws, otherwise wait() would never return.
+        struct finish {
+            state& s;
+            ~finish() {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                if(--s.outstanding == 0) s.done.notify_all();
+            }
+        } f{*s};
+        if(!token.stop_requested()) {
+            fn(token);
+        }
+    }, {}, p);
+}
+
+void group::post_main(std::function<void()> fn) {
+    std::stop_token token;
+    {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        token = stop.get_token();
+    }
+    sched.post_main(std::move(fn), std::move(token));
+}
+
+void group::post_main(std::function<void()> fn, std::stop_token token) {
+    sched.post_main(std::move(fn), std::move(token));
+}
+
+void group::cancel() {
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    stop.request_stop();
+    stop = std::stop_source{};
+}
+
+void group::wait() {
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock, [this] { return shared->outstanding == 0; });
+}
+
+std::size_t group::running() const {
+    std::lock_guard<std::mutex> lock(shared->mutex);
+    return shared->outstanding;
+}
+
+}
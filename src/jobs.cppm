@@ -0,0 +1,201 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+export module openxmb.jobs;
+
+export namespace jobs {
+
+enum class priority {
+    high,   // the user is waiting for it (directory scans, opening files)
+    normal, // visible content (icons, thumbnails)
+    low,    // background work (indexing, caches)
+};
+
+using job = std::function<void(std::stop_token)>;
+
+// Process-wide work-stealing thread pool.
+//
+// Every worker owns one deque per priority. Jobs submitted from a worker go
+// to its own deque and are taken newest first, idle workers steal the oldest
+// jobs of others; higher priorities are always drained first. Functions passed
+// to post_main() run on the main thread from drain_main(), which the shell
+// calls once per tick.
+class scheduler {
+    public:
+        // The shared instance, sized to the number of hardware threads.
+        static scheduler& instance();
+
+        explicit scheduler(unsigned int threads = 0);
+        ~scheduler();
+        scheduler(const scheduler&) = delete;
+        scheduler& operator=(const scheduler&) = delete;
+
+        // Runs fn on a worker unless token is stopped before it starts; fn
+        // itself should poll the token while it runs.
+        void submit(job fn, std::stop_token token = {}, priority p = priority::normal);
+
+        // Queues fn for the next drain_main() on the main thread. It is
+        // dropped if token is stopped by then, so owners can cancel pending
+        // completions from their destructor.
+        void post_main(std::function<void()> fn, std::stop_token token = {});
+        void drain_main();
+
+        [[nodiscard]] unsigned int thread_count() const {
+            return static_cast<unsigned int>(threads.size());
+        }
+    private:
+        struct task {
+            job fn;
+            std::stop_token token;
+        };
+        struct worker_queue {
+            std::mutex mutex;
+            std::array<std::deque<task>, 3> tasks; // indexed by priority
+        };
+        struct main_task {
+            std::function<void()> fn;
+            std::stop_token token;
+        };
+
+        void run(unsigned int index, std::stop_token stop);
+        bool pop(unsigned int index, task& out);
+
+        std::vector<std::unique_ptr<worker_queue>> queues;
+        std::atomic<std::size_t> queued{0};
+        std::atomic<unsigned int> next_queue{0};
+        std::mutex sleep_mutex;
+        std::condition_variable_any wake;
+
+        std::mutex main_mutex;
+        std::vector<main_task> main_tasks;
+
+        std::vector<std::jthread> threads; // last, so workers stop before the queues go
+};
+
+// Jobs belonging to one owner. Destroying the group (or calling cancel())
+// stops its jobs and drops their pending main-thread completions; the
+// destructor also waits for jobs that are still running, so they may safely
+// use the owner.
+class group {
+    public:
+        explicit group(priority p = priority::normal, scheduler& s = scheduler::instance());
+        ~group();
+        group(const group&) = delete;
+        group& operator=(const group&) = delete;
+
+        void submit(job fn);
+        void submit(job fn, priority p);
+        // Runs fn on the main thread, unless the group is cancelled first.
+        void post_main(std::function<void()> fn);
+        // Same, but tied to the token a job was given, so the completion is
+        // also dropped if that job is cancelled before it is drained.
+        void post_main(std::function<void()> fn, std::stop_token token);
+
+        // Stops everything submitted so far; later submissions run normally.
+        void cancel();
+        void wait();
+        [[nodiscard]] std::size_t running() const;
+    private:
+        struct state {
+            mutable std::mutex mutex;
+            std::condition_variable done;
+            std::size_t outstanding = 0;
+        };
+
+        scheduler& sched;
+        priority default_priority;
+        std::shared_ptr<state> shared = std::make_shared<state>();
+        std::stop_source stop; // guarded by shared->mutex
+};
+
+// Calls fn(0) ... fn(count - 1) on the scheduler and on the calling thread.
+// The caller claims indices like any worker, so it never idles behind a busy
+// pool: once nothing is left to claim it waits only for the calls already
+// running elsewhere, and helper jobs that start later find no work and return.
+template<typename Fn>
+void for_each_index(std::size_t count, Fn fn, priority p = priority::high, scheduler& s = scheduler::instance()) {
+    struct state {
+        std::atomic<std::size_t> next{0};
+        std::mutex mutex;
+        std::condition_variable done;
+        std::size_t finished = 0;
+        Fn fn;
+
+        explicit state(Fn fn) : fn(std::move(fn)) {}
+    };
+    auto shared = std::make_shared<state>(std::move(fn));
+    auto work = [count](state& st) {
+        for(std::size_t i; (i = st.next.fetch_add(1)) < count;) {
+            st.fn(i);
+            std::lock_guard<std::mutex> lock(st.mutex);
+            if(++st.finished == count) st.done.notify_all();
+        }
+    };
+    for(std::size_t i = 1; i < std::min<std::size_t>(count, s.thread_count() + 1); i++) {
+        s.submit([shared, work](std::stop_token) { work(*shared); }, {}, p);
+    }
+    work(*shared);
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock, [&] { return shared->finished == count; });
+}
+
+// Stable sort on the scheduler for large ranges: chunks are sorted by jobs
+// in parallel, then neighbours are merged pairwise, also in parallel. The
+// calling thread works on chunks too, see for_each_index(). Ranges below
+// serial_threshold are sorted on the calling thread.
+template<std::random_access_iterator It, typename Compare>
+void parallel_stable_sort(It first, It last, Compare comp, std::size_t serial_threshold = std::size_t{1} << 14) {
+    const auto n = static_cast<std::size_t>(last - first);
+    std::size_t chunks = 1;
+    while(chunks * 2 <= scheduler::instance().thread_count() && n / (chunks * 2) >= serial_threshold / 2) {
+        chunks *= 2;
+    }
+    if(n < serial_threshold || chunks == 1) {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+    auto bound = [&](std::size_t i) { return first + static_cast<std::ptrdiff_t>(n * i / chunks); };
+
+    for_each_index(chunks, [&](std::size_t i) { std::stable_sort(bound(i), bound(i + 1), comp); });
+    // Merging neighbours in order keeps equal elements in their original order
+    for(std::size_t width = 1; width < chunks; width *= 2) {
+        const std::size_t merges = (chunks - width + 2 * width - 1) / (2 * width);
+        for_each_index(merges, [&](std::size_t k) {
+            const std::size_t i = k * 2 * width;
+            std::inplace_merge(bound(i), bound(i + width), bound(std::min(i + 2 * width, chunks)), comp);
+        });
+    }
+}
+
+}
@@ -22,6 +22,7 @@ module;
 #include <cstdlib>
 #include <filesystem>
 #include <functional>
+#include <stop_token>
 #include <string>
 #include <vector>
 #include <fstream>
@@ -34,6 +35,7 @@ import spdlog;
 import i18n;
 import dreamrender;
 import openxmb.config;
+import openxmb.jobs;
 
 import :applications_menu;
 import :choice_overlay;
@@ -109,18 +111,15 @@ app_info::app_info(const std::filesystem::path& desktop_file) {
 applications_menu::applications_menu(std::string name, dreamrender::texture&& icon, app::shell* xmb, dreamrender::resource_loader& loader, AppFilter filter)
     : simple_menu(std::move(name), std::move(icon)), xmb(xmb), loader(loader), filter(filter)
 {
-    apps = scan_applications();
-    for (const auto& app : apps) {
-        if(!filter(app))
-            continue;
-        bool is_hidden = config::CONFIG.excludedApplications.contains(app.id);
-        if(!show_hidden && is_hidden)
-            continue;
-
-        spdlog::trace("Found application: {} ({})", app.name, app.id);
-        auto entry = create_action_menu_entry(app, is_hidden);
-        entries.push_back(std::move(entry));
-    }
+    // Parsing every .desktop file is slow on a cold cache, so the menu starts
+    // empty and fills in once the scan is done
+    scanning.submit([this](std::stop_token stop) {
+        auto found = scan_applications();
+        scanning.post_main([this, found = std::move(found)]() mutable {
+            apps = std::move(found);
+            reload();
+        }, stop);
+    });
 }
 
 std::unique_ptr<action_menu_entry> applications_menu::create_action_menu_entry(const app_info& app, bool hidden) {
@@ -137,7 +136,7 @@ std::unique_ptr<action_menu_entry> applications_menu::create_action_menu_entry(c
         name += " (hidden)"_();
     }
     auto entry = std::make_unique<action_menu_entry>(name, std::move(icon_texture),
-        std::function<result()>{}, [this, app](action a) { return activate_app(app, a); });
+        std::function<result()>{}, [this, app](action a) { return activate_app(app, a); }, app.comment);
     if(!icon_path.empty()) {
         loader.loadTexture(&entry->get_icon(), icon_path);
     }
@@ -178,8 +177,8 @@ std::vector<app_info> applications_menu::scan_applications() {
 }
 
 void applications_menu::reload() {
-    apps = scan_applications();
     entries.clear();
+    invalidate();
     
     for (const auto& app : apps) {
         if(!filter(app))
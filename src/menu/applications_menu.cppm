@@ -29,6 +29,7 @@ module;
 export module openxmb.app:applications_menu;
 import :menu_base;
 import dreamrender;
+import openxmb.jobs;
 import spdlog;
 
 namespace app {
@@ -93,10 +94,10 @@ class applications_menu : public simple_menu {
         result activate(action action) override;
         void get_button_actions(std::vector<std::pair<action, std::string>>& v) override;
     private:
-        void reload();
+        void reload(); // rebuilds the entries from apps, no I/O happens here
         std::unique_ptr<action_menu_entry> create_action_menu_entry(const app_info& app, bool hidden = false);
         result activate_app(const app_info& app, action action);
-        std::vector<app_info> scan_applications();
+        static std::vector<app_info> scan_applications();
 
         app::shell* xmb;
         dreamrender::resource_loader& loader;
@@ -104,6 +105,8 @@ class applications_menu : public simple_menu {
         bool show_hidden = false;
         AppFilter filter;
         std::vector<app_info> apps;
+
+        jobs::group scanning{jobs::priority::high}; // last, so the scan stops before the rest goes
 };
 
 }
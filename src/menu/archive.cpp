@@ -0,0 +1,672 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+module openxmb.app;
+
+import :archive;
+
+import openxmb.utils;
+import spdlog;
+
+namespace menu {
+
+namespace {
+    constexpr std::uint32_t local_signature = 0x04034b50;
+    constexpr std::uint32_t central_signature = 0x02014b50;
+    constexpr std::uint32_t end_signature = 0x06054b50;
+    constexpr std::uint32_t zip64_locator_signature = 0x07064b50;
+    constexpr std::uint32_t zip64_end_signature = 0x06064b50;
+    constexpr std::size_t tar_block = 512;
+    constexpr std::size_t chunk_size = 256 * 1024;
+    // Long names and pax headers are a few hundred bytes; anything near this is corrupt or hostile
+    constexpr std::uint64_t max_header_text = 1024 * 1024;
+
+    template<typename T>
+    T le(const std::uint8_t* p) {
+        T v = 0;
+        for(std::size_t i = 0; i < sizeof(T); i++) {
+            v |= static_cast<T>(p[i]) << (8 * i);
+        }
+        return v;
+    }
+
+    std::runtime_error corrupt(const std::filesystem::path& file) {
+        return std::runtime_error(std::format("{} is corrupt or truncated", file.string()));
+    }
+
+    std::filesystem::file_time_type from_unix(std::int64_t seconds) {
+        return std::chrono::time_point_cast<std::filesystem::file_time_type::duration>(
+            std::chrono::file_clock::from_sys(std::chrono::sys_seconds(std::chrono::seconds(seconds))));
+    }
+
+    // MS-DOS date and time, as zip stores them.
+    std::filesystem::file_time_type from_dos(std::uint16_t date, std::uint16_t time) {
+        using namespace std::chrono;
+        const year_month_day ymd{year{1980 + (date >> 9)}, month{static_cast<unsigned>((date >> 5) & 0xF)},
+            day{static_cast<unsigned>(date & 0x1F)}};
+        if(!ymd.ok()) {
+            return {};
+        }
+        const sys_seconds t = sys_days{ymd} + hours{time >> 11} + minutes{(time >> 5) & 0x3F} + seconds{(time & 0x1F) * 2};
+        return from_unix(t.time_since_epoch().count());
+    }
+
+    // Member names without ".", empty components and leading slashes; empty
+    // for names that would escape the archive.
+    std::string clean_path(std::string_view name) {
+        std::string out;
+        while(!name.empty()) {
+            const auto slash = name.find('/');
+            const auto part = name.substr(0, slash);
+            name = slash == std::string_view::npos ? std::string_view{} : name.substr(slash + 1);
+            if(part.empty() || part == ".") {
+                continue;
+            }
+            if(part == "..") {
+                return {};
+            }
+            if(!out.empty()) {
+                out += '/';
+            }
+            out += part;
+        }
+        return out;
+    }
+
+    std::string_view parent_of(std::string_view path) {
+        const auto slash = path.rfind('/');
+        return slash == std::string_view::npos ? std::string_view{} : path.substr(0, slash);
+    }
+
+    void write_all(int fd, const void* data, std::size_t length) {
+        const auto* p = static_cast<const char*>(data);
+        while(length > 0) {
+            const auto n = ::write(fd, p, length);
+            if(n < 0) {
+                if(errno == EINTR) continue;
+                throw std::runtime_error(std::format("Cannot write extracted member: {}", std::strerror(errno)));
+            }
+            p += n;
+            length -= static_cast<std::size_t>(n);
+        }
+    }
+
+    // Octal, or base-256 with the high bit set for values that do not fit.
+    std::uint64_t tar_number(const char* field, std::size_t length) {
+        std::uint64_t v = 0;
+        if(static_cast<unsigned char>(field[0]) & 0x80) {
+            v = static_cast<unsigned char>(field[0]) & 0x7F;
+            for(std::size_t i = 1; i < length; i++) {
+                v = (v << 8) | static_cast<unsigned char>(field[i]);
+            }
+            return v;
+        }
+        for(std::size_t i = 0; i < length && field[i] != '\0'; i++) {
+            if(field[i] >= '0' && field[i] <= '7') {
+                v = v * 8 + static_cast<std::uint64_t>(field[i] - '0');
+            }
+        }
+        return v;
+    }
+
+    bool tar_checksum_ok(const std::array<char, tar_block>& block) {
+        std::uint64_t sum = 0;
+        for(std::size_t i = 0; i < tar_block; i++) {
+            // The checksum field itself counts as spaces
+            sum += i >= 148 && i < 156 ? ' ' : static_cast<unsigned char>(block[i]);
+        }
+        return sum == tar_number(block.data() + 148, 8);
+    }
+
+    // Sequential reads of a tar file, either plain or through gzip.
+    class tar_stream {
+        public:
+            tar_stream(const std::filesystem::path& file, bool gzipped) {
+                if(gzipped) {
+                    gz = ::gzopen(file.c_str(), "rb");
+                    if(!gz) {
+                        throw std::runtime_error(std::format("Cannot open {}", file.string()));
+                    }
+                    ::gzbuffer(gz, chunk_size);
+                } else {
+                    fd = utils::unique_fd(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+                    if(!fd) {
+                        throw std::runtime_error(std::format("Cannot open {}: {}", file.string(), std::strerror(errno)));
+                    }
+                }
+            }
+            ~tar_stream() {
+                if(gz) ::gzclose(gz);
+            }
+            tar_stream(const tar_stream&) = delete;
+            tar_stream& operator=(const tar_stream&) = delete;
+
+            // Reads up to length bytes; 0 at the end of the stream.
+            std::size_t read_some(void* buffer, std::size_t length) {
+                while(true) {
+                    const auto n = gz ? ::gzread(gz, buffer, static_cast<unsigned>(length))
+                        : ::pread(fd.get(), buffer, length, static_cast<off_t>(position));
+                    if(n < 0 && !gz && errno == EINTR) continue;
+                    if(n < 0) {
+                        throw std::runtime_error("Cannot read archive");
+                    }
+                    position += static_cast<std::size_t>(n);
+                    return static_cast<std::size_t>(n);
+                }
+            }
+            // Reads exactly length bytes; false at the end of the stream.
+            bool read(void* buffer, std::size_t length) {
+                for(std::size_t done = 0; done < length;) {
+                    const auto n = read_some(static_cast<char*>(buffer) + done, length - done);
+                    if(n == 0) return false;
+                    done += n;
+                }
+                return true;
+            }
+            // Plain files skip without reading, gzip has to decompress what it
+            // skips, so progress is called every few MiB then.
+            void skip(std::uint64_t length, const std::function<void()>& progress = {}) {
+                constexpr std::uint64_t step = 16 * 1024 * 1024;
+                for(std::uint64_t left = gz ? length : 0; left > 0;) {
+                    const auto n = std::min(left, step);
+                    if(::gzseek(gz, static_cast<z_off_t>(n), SEEK_CUR) < 0) {
+                        throw std::runtime_error("Cannot seek in compressed archive");
+                    }
+                    left -= n;
+                    if(progress) progress();
+                }
+                position += length;
+            }
+            [[nodiscard]] std::uint64_t offset() const {
+                return position;
+            }
+        private:
+            gzFile gz = nullptr;
+            utils::unique_fd fd;
+            std::uint64_t position = 0;
+    };
+
+    struct cached_archive {
+        std::uint64_t size = 0;
+        std::int64_t mtime_ns = 0;
+        std::shared_ptr<const archive> index;
+    };
+    std::mutex cache_mutex;
+    std::unordered_map<std::string, cached_archive> cache; // by path
+    constexpr std::size_t max_cached = 16;
+}
+
+archive::archive(std::filesystem::path file, format type) : file(std::move(file)), type(type) {}
+
+archive::~archive() {
+    if(data) {
+        ::munmap(const_cast<std::uint8_t*>(data), size);
+    }
+}
+
+bool archive::supported(std::string_view mime) {
+    return mime == "application/zip" || mime == "application/x-tar" || mime == "application/gzip";
+}
+
+std::shared_ptr<const archive> archive::open(const std::filesystem::path& file, const std::function<void()>& progress) {
+    struct statx st{};
+    if(::statx(AT_FDCWD, file.c_str(), 0, STATX_SIZE | STATX_MTIME, &st) != 0) {
+        throw std::runtime_error(std::format("Cannot open {}: {}", file.string(), std::strerror(errno)));
+    }
+    const std::int64_t mtime_ns = st.stx_mtime.tv_sec * 1'000'000'000ll + st.stx_mtime.tv_nsec;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if(auto it = cache.find(file.native()); it != cache.end()) {
+            if(it->second.size == st.stx_size && it->second.mtime_ns == mtime_ns) {
+                return it->second.index;
+            }
+            cache.erase(it);
+        }
+    }
+
+    // By content, extensions may lie
+    std::array<char, tar_block> head{};
+    {
+        utils::unique_fd fd(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+        if(!fd || ::pread(fd.get(), head.data(), head.size(), 0) < 4) {
+            throw std::runtime_error(std::format("Cannot read {}", file.string()));
+        }
+    }
+    const std::string_view h(head.data(), head.size());
+    format type;
+    if(h.starts_with("PK\x03\x04") || h.starts_with("PK\x05\x06")) {
+        type = format::zip;
+    } else if(h.starts_with("\x1f\x8b")) {
+        // A tar inside if the decompressed start has a tar header
+        type = format::gzip;
+        if(gzFile gz = ::gzopen(file.c_str(), "rb")) {
+            std::array<char, tar_block> inner{};
+            if(::gzread(gz, inner.data(), inner.size()) == static_cast<int>(inner.size()) && tar_checksum_ok(inner)) {
+                type = format::tar_gzip;
+            }
+            ::gzclose(gz);
+        }
+    } else if(tar_checksum_ok(head)) {
+        type = format::tar;
+    } else {
+        throw std::runtime_error(std::format("{} is not a zip, tar or gzip file", file.string()));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto a = std::shared_ptr<archive>(new archive(file, type));
+    switch(type) {
+        case format::zip: a->read_zip(); break;
+        case format::tar:
+        case format::tar_gzip: a->read_tar(progress); break;
+        case format::gzip: a->read_gzip(); break;
+    }
+    a->finish();
+    spdlog::debug("Indexed archive {} ({} members) in {} ms", file.string(), a->entries.size(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if(cache.size() >= max_cached) {
+        cache.clear();
+    }
+    cache[file.native()] = {st.stx_size, mtime_ns, a};
+    return a;
+}
+
+void archive::read_zip() {
+    utils::unique_fd fd(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat st{};
+    if(!fd || ::fstat(fd.get(), &st) != 0) {
+        throw std::runtime_error(std::format("Cannot open {}: {}", file.string(), std::strerror(errno)));
+    }
+    if(static_cast<std::size_t>(st.st_size) < 22) {
+        throw corrupt(file);
+    }
+    void* mapped = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd.get(), 0);
+    if(mapped == MAP_FAILED) {
+        throw std::runtime_error(std::format("Cannot map {}: {}", file.string(), std::strerror(errno)));
+    }
+    data = static_cast<const std::uint8_t*>(mapped);
+    size = static_cast<std::size_t>(st.st_size);
+
+    // The end record is last, followed only by a comment of up to 64 KiB
+    std::size_t end = 0;
+    bool found = false;
+    for(std::size_t i = size - 22; size - i <= 22 + 0xFFFF; i--) {
+        if(le<std::uint32_t>(data + i) == end_signature) {
+            end = i;
+            found = true;
+            break;
+        }
+        if(i == 0) break;
+    }
+    if(!found) {
+        throw corrupt(file);
+    }
+    std::uint64_t count = le<std::uint16_t>(data + end + 10);
+    std::uint64_t directory_size = le<std::uint32_t>(data + end + 12);
+    std::uint64_t directory_offset = le<std::uint32_t>(data + end + 16);
+    if(end >= 20 && le<std::uint32_t>(data + end - 20) == zip64_locator_signature) {
+        const auto end64 = le<std::uint64_t>(data + end - 20 + 8);
+        if(end64 > size - 56 || le<std::uint32_t>(data + end64) != zip64_end_signature) {
+            throw corrupt(file);
+        }
+        count = le<std::uint64_t>(data + end64 + 32);
+        directory_size = le<std::uint64_t>(data + end64 + 40);
+        directory_offset = le<std::uint64_t>(data + end64 + 48);
+    }
+    if(directory_offset > size || directory_size > size - directory_offset) {
+        throw corrupt(file);
+    }
+
+    entries.reserve(std::min<std::uint64_t>(count, directory_size / 46));
+    std::size_t p = directory_offset;
+    const std::size_t directory_end = directory_offset + directory_size;
+    for(std::uint64_t i = 0; i < count; i++) {
+        if(p + 46 > directory_end || le<std::uint32_t>(data + p) != central_signature) {
+            throw corrupt(file);
+        }
+        const auto name_length = le<std::uint16_t>(data + p + 28);
+        const auto extra_length = le<std::uint16_t>(data + p + 30);
+        const auto comment_length = le<std::uint16_t>(data + p + 32);
+        const std::size_t next = p + 46 + name_length + extra_length + comment_length;
+        if(next > directory_end) {
+            throw corrupt(file);
+        }
+        const std::string_view name(reinterpret_cast<const char*>(data + p + 46), name_length);
+
+        entry e;
+        e.method = le<std::uint16_t>(data + p + 10);
+        e.compressed_size = le<std::uint32_t>(data + p + 20);
+        std::uint64_t uncompressed = le<std::uint32_t>(data + p + 24);
+        e.offset = le<std::uint32_t>(data + p + 42);
+        // Saturated fields of large members are in the ZIP64 extra field, in this order
+        for(std::size_t q = p + 46 + name_length, extra_end = q + extra_length; q + 4 <= extra_end;) {
+            const auto id = le<std::uint16_t>(data + q);
+            const std::size_t field_end = std::min<std::size_t>(q + 4 + le<std::uint16_t>(data + q + 2), extra_end);
+            if(id == 0x0001) {
+                std::size_t r = q + 4;
+                for(auto* value : {&uncompressed, &e.compressed_size, &e.offset}) {
+                    if(*value == 0xFFFFFFFF && r + 8 <= field_end) {
+                        *value = le<std::uint64_t>(data + r);
+                        r += 8;
+                    }
+                }
+            }
+            q = field_end;
+        }
+        e.member.path = clean_path(name);
+        e.member.is_directory = name.ends_with('/');
+        e.member.size = e.member.is_directory ? 0 : uncompressed;
+        e.member.modification_time = from_dos(le<std::uint16_t>(data + p + 14), le<std::uint16_t>(data + p + 12));
+        if(!e.member.path.empty()) {
+            add(std::move(e));
+        }
+        p = next;
+    }
+}
+
+void archive::read_tar(const std::function<void()>& progress) {
+    tar_stream in(file, type == format::tar_gzip);
+    std::array<char, tar_block> block{};
+    std::string long_name; // from a GNU long name or pax header, for the next member
+    std::optional<std::uint64_t> long_size;
+    auto read_text = [&](std::uint64_t length) {
+        if(length > max_header_text) {
+            throw corrupt(file);
+        }
+        std::string text(length, '\0');
+        if(!in.read(text.data(), text.size())) {
+            throw corrupt(file);
+        }
+        in.skip((tar_block - length % tar_block) % tar_block);
+        return text;
+    };
+
+    for(std::size_t headers = 1; in.read(block.data(), block.size()); headers++) {
+        if(progress && headers % 256 == 0) {
+            progress();
+        }
+        if(std::ranges::all_of(block, [](char c) { return c == '\0'; })) {
+            break; // end of archive
+        }
+        if(!tar_checksum_ok(block)) {
+            throw corrupt(file);
+        }
+        const char flag = block[156];
+        std::uint64_t length = long_size.value_or(tar_number(block.data() + 124, 12));
+        if(flag == 'L') {
+            long_name = read_text(length);
+            long_name.resize(std::strlen(long_name.c_str()));
+            continue;
+        }
+        if(flag == 'x' || flag == 'g') {
+            // Records of "<length> <key>=<value>\n"
+            const auto text = read_text(length);
+            for(std::size_t pos = 0; pos < text.size();) {
+                const auto space = text.find(' ', pos);
+                const auto record = space == std::string::npos ? 0 : std::strtoull(text.c_str() + pos, nullptr, 10);
+                // The length covers the whole record, which has to hold the space and end in a newline
+                if(record == 0 || record > text.size() - pos || space >= pos + record || text[pos + record - 1] != '\n') break;
+                const std::string_view kv(text.data() + space + 1, pos + record - space - 2);
+                if(flag == 'x' && kv.starts_with("path=")) {
+                    long_name = kv.substr(5);
+                } else if(flag == 'x' && kv.starts_with("size=")) {
+                    long_size = std::strtoull(std::string(kv.substr(5)).c_str(), nullptr, 10);
+                }
+                pos += record;
+            }
+            continue;
+        }
+
+        std::string name = long_name;
+        if(name.empty()) {
+            name.assign(block.data(), strnlen(block.data(), 100));
+            if(std::string_view(block.data() + 257, 5) == "ustar" && block[345] != '\0') {
+                name = std::string(block.data() + 345, strnlen(block.data() + 345, 155)) + "/" + name;
+            }
+        }
+        long_name.clear();
+        long_size.reset();
+
+        const std::uint64_t padded = (length + tar_block - 1) / tar_block * tar_block;
+        const bool is_file = flag == '0' || flag == '\0' || flag == '7';
+        if(is_file || flag == '5') {
+            entry e;
+            e.member.path = clean_path(name);
+            e.member.is_directory = flag == '5' || name.ends_with('/');
+            e.member.size = e.member.is_directory ? 0 : length;
+            e.member.modification_time = from_unix(static_cast<std::int64_t>(tar_number(block.data() + 136, 12)));
+            e.offset = in.offset();
+            if(!e.member.path.empty()) {
+                add(std::move(e));
+            }
+        }
+        // Links, devices and the like are left out
+        in.skip(padded, progress);
+    }
+}
+
+void archive::read_gzip() {
+    // One member, named like the file without .gz; its size is in the trailer (modulo 4 GiB)
+    utils::unique_fd fd(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+    struct stat st{};
+    std::array<std::uint8_t, 8> header{}, trailer{};
+    if(!fd || ::fstat(fd.get(), &st) != 0 || st.st_size < 18 ||
+        ::pread(fd.get(), header.data(), header.size(), 0) != static_cast<ssize_t>(header.size()) ||
+        ::pread(fd.get(), trailer.data(), trailer.size(), st.st_size - 8) != static_cast<ssize_t>(trailer.size()))
+    {
+        throw corrupt(file);
+    }
+    auto name = file.filename();
+    name = name.extension() == ".tgz" ? name.replace_extension(".tar") : name.replace_extension();
+    entry e;
+    e.member.path = clean_path(name.string());
+    if(e.member.path.empty()) {
+        e.member.path = "data";
+    }
+    e.member.size = le<std::uint32_t>(trailer.data() + 4);
+    const auto mtime = le<std::uint32_t>(header.data() + 4);
+    e.member.modification_time = mtime != 0 ? from_unix(mtime) : from_unix(st.st_mtim.tv_sec);
+    add(std::move(e));
+}
+
+void archive::add(entry e) {
+    // Later members replace earlier ones of the same name, as when extracting
+    if(auto it = by_path.find(e.member.path); it != by_path.end()) {
+        entries[it->second] = std::move(e);
+        return;
+    }
+    by_path.emplace(e.member.path, entries.size());
+    entries.push_back(std::move(e));
+}
+
+void archive::finish() {
+    // Directories only implied by the paths below them, as most zips have
+    const std::size_t listed = entries.size();
+    for(std::size_t i = 0; i < listed; i++) {
+        for(auto dir = parent_of(entries[i].member.path); !dir.empty(); dir = parent_of(dir)) {
+            if(by_path.contains(std::string(dir))) {
+                break;
+            }
+            entry e;
+            e.member.path = dir;
+            e.member.is_directory = true;
+            e.member.modification_time = entries[i].member.modification_time;
+            add(std::move(e));
+        }
+    }
+    for(std::size_t i = 0; i < entries.size(); i++) {
+        const auto& member = entries[i].member;
+        children[std::string(parent_of(member.path))].push_back(i);
+        if(member.is_directory) {
+            continue;
+        }
+        for(auto dir = parent_of(member.path); !dir.empty(); dir = parent_of(dir)) {
+            entries[by_path.at(std::string(dir))].member.size += member.size;
+        }
+    }
+}
+
+std::vector<archive_member> archive::list(std::string_view dir) const {
+    std::vector<archive_member> members;
+    if(auto it = children.find(std::string(dir)); it != children.end()) {
+        members.reserve(it->second.size());
+        for(auto i : it->second) {
+            members.push_back(entries[i].member);
+        }
+    }
+    return members;
+}
+
+utils::unique_fd archive::extract(std::string_view path, std::stop_token stop) const {
+    auto it = by_path.find(std::string(path));
+    if(it == by_path.end() || entries[it->second].member.is_directory) {
+        throw std::runtime_error(std::format("No file {} in {}", path, file.string()));
+    }
+    const auto& e = entries[it->second];
+    auto too_large = [&] {
+        return member_too_large(std::format("{} in {} is larger than {} MiB", path, file.string(), max_extract_size >> 20));
+    };
+    if(e.member.size > max_extract_size) {
+        throw too_large();
+    }
+    const std::string leaf(path.substr(path.rfind('/') + 1));
+    utils::unique_fd out(::memfd_create(leaf.c_str(), MFD_CLOEXEC));
+    if(!out) {
+        throw std::runtime_error(std::format("Cannot create memory file: {}", std::strerror(errno)));
+    }
+
+    // Sizes of gzip members are only known modulo 4 GiB, and zips can lie about them
+    std::uint64_t written = 0;
+    auto emit = [&](const void* bytes, std::uint64_t length) {
+        written += length;
+        if(written > max_extract_size) {
+            throw too_large();
+        }
+        write_all(out.get(), bytes, length);
+    };
+
+    std::vector<char> buffer(chunk_size);
+    switch(type) {
+        case format::zip: {
+            if(e.offset > size - 30 || le<std::uint32_t>(data + e.offset) != local_signature) {
+                throw corrupt(file);
+            }
+            const std::uint64_t start = e.offset + 30 + le<std::uint16_t>(data + e.offset + 26) + le<std::uint16_t>(data + e.offset + 28);
+            if(start > size || e.compressed_size > size - start) {
+                throw corrupt(file);
+            }
+            if(e.method == 0) {
+                emit(data + start, e.compressed_size);
+                break;
+            }
+            if(e.method != 8) {
+                throw std::runtime_error(std::format("{} in {} uses unsupported compression method {}", path, file.string(), e.method));
+            }
+            z_stream zs{};
+            if(::inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+                throw std::runtime_error("Cannot initialize zlib");
+            }
+            struct end_inflate {
+                z_stream& zs;
+                ~end_inflate() { ::inflateEnd(&zs); }
+            } guard{zs};
+            const std::uint8_t* in = data + start;
+            std::uint64_t remaining = e.compressed_size;
+            int ret = Z_OK;
+            while(ret != Z_STREAM_END) {
+                if(stop.stop_requested()) {
+                    return {};
+                }
+                if(zs.avail_in == 0 && remaining > 0) {
+                    const auto n = static_cast<uInt>(std::min<std::uint64_t>(remaining, 1u << 30));
+                    zs.next_in = const_cast<Bytef*>(in);
+                    zs.avail_in = n;
+                    in += n;
+                    remaining -= n;
+                }
+                zs.next_out = reinterpret_cast<Bytef*>(buffer.data());
+                zs.avail_out = static_cast<uInt>(buffer.size());
+                // All input may be in while output is still pending, so this keeps
+                // going until the stream ends. With room to write, Z_BUF_ERROR
+                // means no progress: the member ended before its stream did.
+                ret = ::inflate(&zs, Z_NO_FLUSH);
+                if(ret != Z_OK && ret != Z_STREAM_END) {
+                    throw corrupt(file);
+                }
+                emit(buffer.data(), buffer.size() - zs.avail_out);
+            }
+            break;
+        }
+        case format::tar:
+        case format::tar_gzip:
+        case format::gzip: {
+            tar_stream in(file, type != format::tar);
+            in.skip(e.offset);
+            // A lone gzip member is read to its end, its size is only known modulo 4 GiB
+            const bool to_end = type == format::gzip;
+            std::uint64_t remaining = e.member.size;
+            while(to_end || remaining > 0) {
+                if(stop.stop_requested()) {
+                    return {};
+                }
+                const auto n = in.read_some(buffer.data(), to_end ? buffer.size() : std::min<std::uint64_t>(remaining, buffer.size()));
+                if(n == 0) {
+                    if(to_end) break;
+                    throw corrupt(file);
+                }
+                emit(buffer.data(), n);
+                remaining -= std::min<std::uint64_t>(n, remaining);
+            }
+            break;
+        }
+    }
+    ::lseek(out.get(), 0, SEEK_SET);
+    return out;
+}
+
+}
@@ -0,0 +1,112 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+export module openxmb.app:archive;
+
+import openxmb.utils;
+
+export namespace menu {
+
+// One file or directory inside an archive.
+struct archive_member {
+    std::string path; // relative, '/' separated, without a trailing slash
+    std::uint64_t size = 0; // uncompressed; for directories the sum of everything below
+    std::filesystem::file_time_type modification_time;
+    bool is_directory = false;
+};
+
+// Thrown by archive::extract() for members above archive::max_extract_size.
+struct member_too_large : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Read-only view of a zip, tar, tar.gz or gz file.
+//
+// A zip's central directory is read straight from the mapped file. Tar files
+// have no index, so one is built with a single pass over the headers, which
+// skips the data of plain tar files entirely. Indexes are cached while the
+// file's size and mtime stay the same, so opening an archive again is
+// immediate. Members are decompressed one at a time into a memfd, nothing
+// is unpacked to disk.
+class archive {
+    public:
+        // Throws std::runtime_error if file is not an archive this can read.
+        // progress is called now and then while an index is built.
+        static std::shared_ptr<const archive> open(const std::filesystem::path& file,
+            const std::function<void()>& progress = {});
+        // Whether open() is worth trying for a file of this MIME type.
+        static bool supported(std::string_view mime);
+
+        ~archive();
+        archive(const archive&) = delete;
+        archive& operator=(const archive&) = delete;
+
+        // Members directly in dir ("" for the top level), including directories
+        // that only appear as part of deeper paths.
+        std::vector<archive_member> list(std::string_view dir) const;
+
+        // The content of a file member in an anonymous memory file, at offset 0.
+        // Throws std::runtime_error if the member is missing or corrupt, and
+        // member_too_large if it would take more than max_extract_size of RAM.
+        utils::unique_fd extract(std::string_view path, std::stop_token stop = {}) const;
+
+        // Programs seek in what they open, so members are not streamed
+        // through a pipe; this bounds the memory one of them takes instead.
+        static constexpr std::uint64_t max_extract_size = 256 * 1024 * 1024;
+    private:
+        enum class format { zip, tar, tar_gzip, gzip };
+        struct entry {
+            archive_member member;
+            std::uint64_t offset = 0; // zip: local header; tar: data in the uncompressed stream
+            std::uint64_t compressed_size = 0;
+            std::uint16_t method = 0; // zip only, 0 stored, 8 deflated
+        };
+
+        archive(std::filesystem::path file, format type);
+        void read_zip();
+        void read_tar(const std::function<void()>& progress);
+        void read_gzip();
+        void add(entry e);
+        void finish(); // adds implied directories and sums up directory sizes
+
+        std::filesystem::path file;
+        format type;
+        // zip only: the whole file, mapped
+        const std::uint8_t* data = nullptr;
+        std::size_t size = 0;
+
+        std::vector<entry> entries;
+        std::unordered_map<std::string, std::size_t> by_path;
+        std::unordered_map<std::string, std::vector<std::size_t>> children; // by directory
+};
+
+}
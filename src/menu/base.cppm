@@ -22,6 +22,7 @@ module;
 
 #include <array>
 #include <concepts>
+#include <cstdint>
 #include <ranges>
 #include <stdexcept>
 #include <functional>
@@ -60,13 +61,34 @@ class menu : public menu_entry {
         virtual menu_entry& get_submenu(unsigned int index) const {
             throw std::out_of_range("Index out of range");
         }
+        // Hint that only entries [first, first+count) are about to be drawn.
+        // Menus that build entries lazily materialize just those (and a few
+        // neighbours) instead of every entry in the list.
+        virtual void visible_range(unsigned int first, unsigned int count) const {
+        }
         virtual void on_open() {
         }
         virtual void on_close() {
         }
+        // Called once per tick on the main thread for the categories, see
+        // app::main_menu::update(). Menus apply background results here
+        // rather than in the const getters the renderer polls.
+        virtual void update() {
+        }
         virtual void get_button_actions(std::vector<std::pair<action, std::string>>& v) {
 
         }
+        // Bumped whenever the entries are rebuilt, so retained views (see
+        // app::main_menu) know that previously recorded icons are stale.
+        virtual std::uint64_t get_revision() const {
+            return revision;
+        }
+    protected:
+        void invalidate() {
+            ++revision;
+        }
+    private:
+        std::uint64_t revision = 0;
 };
 
 template<typename T>
@@ -0,0 +1,188 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+
+module openxmb.app;
+
+import :crawler;
+import :directory_reader;
+
+import openxmb.config;
+import openxmb.jobs;
+import openxmb.mime;
+import spdlog;
+
+namespace menu {
+
+exclusion_rules exclusion_rules::from_config() {
+    return exclusion_rules(config::CONFIG.excludedPaths);
+}
+
+bool exclusion_rules::excluded(std::string_view name, const std::filesystem::path& path) const {
+    if(name.starts_with('.')) {
+        return true;
+    }
+    const std::string n(name);
+    for(const auto& pattern : patterns) {
+        const bool whole_path = pattern.find('/') != std::string::npos;
+        if(::fnmatch(pattern.c_str(), whole_path ? path.c_str() : n.c_str(), 0) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+    // Never block on an NFS attribute refresh or trigger an automount.
+    constexpr int statx_flags = AT_STATX_DONT_SYNC | AT_NO_AUTOMOUNT;
+    constexpr std::size_t batch_size = 512;
+
+    struct crawl_state {
+        std::filesystem::path root;
+        crawl_options options;
+        std::function<void(std::vector<crawled_file>&&)> sink;
+        std::function<void()> done;
+        std::stop_token stop;
+
+        std::mutex mutex;
+        std::set<std::pair<dev_t, ino_t>> visited;
+        std::atomic<std::size_t> outstanding{0};
+
+        // Records the directory open as fd, false if it was read before.
+        bool first_visit(int fd) {
+            struct stat st{};
+            if(::fstat(fd, &st) != 0) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            return visited.emplace(st.st_dev, st.st_ino).second;
+        }
+    };
+
+    void crawl_directory(const std::shared_ptr<crawl_state>& state, const std::string& relative);
+
+    void submit_directory(const std::shared_ptr<crawl_state>& state, std::string relative) {
+        state->outstanding++;
+        // Submitted without the token: the job must run to balance outstanding.
+        jobs::scheduler::instance().submit([state, relative = std::move(relative)](std::stop_token) mutable {
+            if(!state->stop.stop_requested()) {
+                try {
+                    crawl_directory(state, relative);
+                } catch(const std::exception& e) {
+                    spdlog::debug("Error crawling {}: {}", (state->root / relative).string(), e.what());
+                }
+            }
+            if(--state->outstanding == 0) {
+                state->done();
+            }
+        }, {}, state->options.priority);
+    }
+
+    void crawl_directory(const std::shared_ptr<crawl_state>& state, const std::string& relative) {
+        const auto dir = relative.empty() ? state->root : state->root / relative;
+        directory_reader reader{dir};
+        if(!state->first_visit(reader.fd())) {
+            return; // a loop, or a directory reachable twice
+        }
+
+        std::vector<crawled_file> batch;
+        for(auto records = reader.next(); !records.empty(); records = reader.next()) {
+            for(const auto& record : records) {
+                if(state->stop.stop_requested()) {
+                    return;
+                }
+                const auto path = dir / record.name;
+                if(state->options.excluded.excluded(record.name, path)) {
+                    continue;
+                }
+                auto child = relative.empty() ? record.name : relative + "/" + record.name;
+
+                bool is_directory = record.type == DT_DIR;
+                const bool need_type = record.type == DT_LNK || record.type == DT_UNKNOWN;
+                if(is_directory) {
+                    submit_directory(state, std::move(child));
+                    continue;
+                }
+                if(!need_type && record.type != DT_REG) {
+                    continue; // devices, sockets, FIFOs
+                }
+                // Types are known from the extension, the file is only stat'ed if it is wanted
+                const auto type = mime::from_name(record.name);
+                if(!need_type && (type.empty() || !state->options.accept(type))) {
+                    continue;
+                }
+                struct statx stx{};
+                if(::statx(reader.fd(), record.name.c_str(), statx_flags, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+                    continue;
+                }
+                if(S_ISDIR(stx.stx_mode)) {
+                    submit_directory(state, std::move(child)); // symlinked directory, loops are caught by first_visit()
+                    continue;
+                }
+                if(!S_ISREG(stx.stx_mode) || type.empty() || !state->options.accept(type)) {
+                    continue;
+                }
+                const auto mtime = std::chrono::sys_seconds(std::chrono::seconds(stx.stx_mtime.tv_sec)) +
+                    std::chrono::nanoseconds(stx.stx_mtime.tv_nsec);
+                batch.push_back({std::move(child), type, stx.stx_size,
+                    std::chrono::time_point_cast<std::filesystem::file_time_type::duration>(std::chrono::file_clock::from_sys(mtime))});
+                if(batch.size() >= batch_size) {
+                    state->sink(std::exchange(batch, {}));
+                }
+            }
+        }
+        if(!batch.empty()) {
+            state->sink(std::move(batch));
+        }
+    }
+}
+
+void crawl(std::filesystem::path root, crawl_options options,
+    std::function<void(std::vector<crawled_file>&&)> sink, std::function<void()> done, std::stop_token stop)
+{
+    auto state = std::make_shared<crawl_state>();
+    state->root = std::move(root);
+    state->options = std::move(options);
+    state->sink = std::move(sink);
+    state->done = std::move(done);
+    state->stop = std::move(stop);
+    submit_directory(state, "");
+}
+
+}
@@ -0,0 +1,76 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module openxmb.app:crawler;
+
+import openxmb.jobs;
+
+export namespace menu {
+
+// Paths a crawl must not descend into, from the "excluded-paths" setting.
+// Patterns with a '/' are matched against the whole path, others against
+// the file name only, both with fnmatch(3) wildcards. Hidden files and
+// directories are always skipped.
+class exclusion_rules {
+    public:
+        exclusion_rules() = default;
+        explicit exclusion_rules(std::vector<std::string> patterns) : patterns(std::move(patterns)) {}
+
+        // The rules from the configuration.
+        static exclusion_rules from_config();
+
+        bool excluded(std::string_view name, const std::filesystem::path& path) const;
+    private:
+        std::vector<std::string> patterns;
+};
+
+struct crawled_file {
+    std::string relative_path; // from the crawl root, '/'-separated
+    std::string_view mime;     // static storage, from openxmb.mime
+    std::uint64_t size = 0;
+    std::filesystem::file_time_type modification_time;
+};
+
+struct crawl_options {
+    exclusion_rules excluded = exclusion_rules::from_config();
+    // Only files of types for which this returns true are reported.
+    std::function<bool(std::string_view mime)> accept = [](std::string_view) { return true; };
+    jobs::priority priority = jobs::priority::low;
+};
+
+// Crawls root recursively on the shared scheduler with one job per
+// directory, so independent subtrees are read in parallel.
+//
+// Every directory is identified by its (device, inode) pair and read at most
+// once, which stops symlink loops and bind-mount cycles. Files are handed to
+// sink in batches from worker threads; done is called on a worker once every
+// directory has been read, or has been skipped because stop was requested.
+void crawl(std::filesystem::path root, crawl_options options,
+    std::function<void(std::vector<crawled_file>&&)> sink, std::function<void()> done, std::stop_token stop);
+
+}
@@ -0,0 +1,88 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+module openxmb.app;
+
+import :directory_reader;
+
+import openxmb.utils;
+
+namespace menu {
+
+namespace {
+    // Layout of the records returned by getdents64, see getdents(2).
+    struct linux_dirent64 {
+        std::uint64_t d_ino;
+        std::int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[];
+    };
+}
+
+directory_reader::directory_reader(const std::filesystem::path& dir)
+    : dir(dir), dir_fd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)), buffer(buffer_size)
+{
+    if(!dir_fd) {
+        throw std::filesystem::filesystem_error("Cannot open directory", dir, std::error_code(errno, std::generic_category()));
+    }
+}
+
+std::span<const directory_record> directory_reader::next() {
+    records.clear();
+    while(records.empty()) {
+        const long n = ::syscall(SYS_getdents64, dir_fd.get(), buffer.data(), buffer.size());
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            throw std::filesystem::filesystem_error("Cannot read directory", dir, std::error_code(errno, std::generic_category()));
+        }
+        if(n == 0) {
+            break;
+        }
+        for(long offset = 0; offset < n;) {
+            const auto* d = reinterpret_cast<const linux_dirent64*>(buffer.data() + offset);
+            offset += d->d_reclen;
+            std::string_view name = d->d_name;
+            if(name == "." || name == "..") {
+                continue;
+            }
+            records.push_back({std::string(name), d->d_type, d->d_ino});
+        }
+    }
+    return records;
+}
+
+}
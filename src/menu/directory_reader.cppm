@@ -0,0 +1,67 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+export module openxmb.app:directory_reader;
+
+import openxmb.utils;
+
+export namespace menu {
+
+// One entry of a directory listing, as reported by the kernel.
+struct directory_record {
+    std::string name;
+    unsigned char type; // DT_* from <dirent.h>, DT_UNKNOWN if the filesystem does not say
+    std::uint64_t inode;
+};
+
+// Lists a directory with large getdents64 reads.
+//
+// Unlike std::filesystem::directory_iterator nothing is stat'ed; the file
+// type comes from d_type, so a listing costs a handful of syscalls no matter
+// how many entries it has. Callers stat entries relative to fd() themselves,
+// and only for the fields they need.
+class directory_reader {
+    public:
+        // Throws std::filesystem::filesystem_error if dir cannot be opened.
+        explicit directory_reader(const std::filesystem::path& dir);
+
+        // The next block of entries, without "." and "..". Empty at the end.
+        std::span<const directory_record> next();
+
+        [[nodiscard]] int fd() const {
+            return dir_fd.get();
+        }
+    private:
+        std::filesystem::path dir;
+        utils::unique_fd dir_fd;
+        std::vector<char> buffer;
+        std::vector<directory_record> records;
+
+        // Large reads let NFS fetch many entries per round trip.
+        static constexpr std::size_t buffer_size = 128 * 1024;
+};
+
+}
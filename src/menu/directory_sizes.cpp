@@ -0,0 +1,165 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+module openxmb.app;
+
+import :directory_reader;
+import :directory_sizes;
+import :mounts;
+
+import openxmb.jobs;
+import spdlog;
+
+namespace menu {
+
+namespace {
+    // Never block on an NFS attribute refresh or trigger an automount.
+    constexpr int statx_flags = AT_STATX_DONT_SYNC | AT_NO_AUTOMOUNT | AT_SYMLINK_NOFOLLOW;
+
+    std::int64_t to_ns(const struct statx_timestamp& t) {
+        return t.tv_sec * 1'000'000'000ll + t.tv_nsec;
+    }
+
+    struct node_key {
+        std::uint64_t device;
+        std::uint64_t inode;
+        bool operator==(const node_key&) const = default;
+    };
+    struct node_key_hash {
+        std::size_t operator()(const node_key& k) const {
+            return std::hash<std::uint64_t>{}(k.inode * 0x9E3779B97F4A7C15ull ^ k.device);
+        }
+    };
+    // What one directory held when its mtime was mtime_ns.
+    struct node {
+        std::int64_t mtime_ns = 0;
+        std::uint64_t bytes = 0; // of the files directly inside
+        std::vector<std::string> directories;
+    };
+
+    // Shared by every run, so sizes come back quickly after leaving and reentering
+    // a directory. Cleared once it grows beyond max_nodes.
+    std::mutex cache_mutex;
+    std::unordered_map<node_key, std::shared_ptr<const node>, node_key_hash> cache;
+    constexpr std::size_t max_nodes = 1 << 20;
+
+    std::shared_ptr<const node> list(const std::filesystem::path& dir, const struct statx& st, std::stop_token& stop) {
+        const node_key key{makedev(st.stx_dev_major, st.stx_dev_minor), st.stx_ino};
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            if(auto it = cache.find(key); it != cache.end() && it->second->mtime_ns == to_ns(st.stx_mtime)) {
+                return it->second;
+            }
+        }
+        auto listed = std::make_shared<node>();
+        listed->mtime_ns = to_ns(st.stx_mtime);
+        directory_reader reader{dir};
+        for(auto records = reader.next(); !records.empty(); records = reader.next()) {
+            for(const auto& record : records) {
+                if(stop.stop_requested()) {
+                    return nullptr;
+                }
+                struct statx stx{};
+                if(::statx(reader.fd(), record.name.c_str(), statx_flags, STATX_TYPE | STATX_SIZE, &stx) != 0) {
+                    continue;
+                }
+                if(S_ISDIR(stx.stx_mode)) {
+                    listed->directories.push_back(record.name);
+                } else if(S_ISREG(stx.stx_mode)) {
+                    listed->bytes += stx.stx_size;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        if(cache.size() >= max_nodes) {
+            cache.clear();
+        }
+        cache.insert_or_assign(key, listed);
+        return listed;
+    }
+
+    void visit(std::shared_ptr<directory_sizes> sizes, std::size_t index, std::filesystem::path dir,
+        std::uint64_t device, std::stop_token stop)
+    {
+        auto& entry = sizes->entries[index];
+        struct statx st{};
+        // Mount points below the first directory are not crossed
+        if(!stop.stop_requested() && ::statx(AT_FDCWD, dir.c_str(), statx_flags, STATX_TYPE | STATX_INO | STATX_MTIME, &st) == 0 &&
+            S_ISDIR(st.stx_mode) && (device == 0 || makedev(st.stx_dev_major, st.stx_dev_minor) == device))
+        {
+            try {
+                if(auto listed = list(dir, st, stop)) {
+                    entry.bytes += listed->bytes;
+                    device = makedev(st.stx_dev_major, st.stx_dev_minor);
+                    for(const auto& name : listed->directories) {
+                        entry.outstanding++;
+                        auto child = dir / name;
+                        io_lanes::instance().submit(child, [sizes, index, child, device](std::stop_token stop) {
+                            visit(sizes, index, child, device, stop);
+                        }, stop, jobs::priority::low);
+                    }
+                }
+            } catch(const std::exception& e) {
+                spdlog::debug("Cannot size {}: {}", dir.string(), e.what());
+            }
+        }
+        if(--entry.outstanding == 0) {
+            sizes->remaining--;
+        }
+    }
+}
+
+std::shared_ptr<directory_sizes> compute_directory_sizes(const std::filesystem::path& dir,
+    const std::vector<std::pair<std::string, std::uint32_t>>& directories, std::stop_token stop)
+{
+    auto sizes = std::make_shared<directory_sizes>();
+    sizes->entries = std::vector<directory_sizes::entry>(directories.size());
+    sizes->remaining = directories.size();
+    for(std::size_t i = 0; i < directories.size(); i++) {
+        sizes->entries[i].name = directories[i].first;
+        sizes->entries[i].file = directories[i].second;
+    }
+    for(std::size_t i = 0; i < directories.size(); i++) {
+        auto child = dir / directories[i].first;
+        io_lanes::instance().submit(child, [sizes, i, child](std::stop_token stop) {
+            visit(sizes, i, child, 0, stop);
+        }, stop, jobs::priority::low);
+    }
+    return sizes;
+}
+
+}
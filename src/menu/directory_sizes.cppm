@@ -0,0 +1,62 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module openxmb.app:directory_sizes;
+
+export namespace menu {
+
+// Recursive sizes of the directories below one directory, filled in by jobs
+// while they run. Main thread readers poll it, see files_menu.
+struct directory_sizes {
+    struct entry {
+        std::string name;
+        std::uint32_t file = 0; // index into the owner's files
+        std::atomic<std::uint64_t> bytes{0}; // so far, grows until complete
+        std::atomic<std::size_t> outstanding{1}; // directories not visited yet
+        [[nodiscard]] bool complete() const {
+            return outstanding.load() == 0;
+        }
+    };
+    std::vector<entry> entries;
+    std::atomic<std::size_t> remaining{0}; // entries not complete
+};
+
+// Starts summing the sizes of the files below dir/name for every named
+// directory. Every directory is visited by a low priority job of its own, so
+// large trees are walked in parallel; mount points are not crossed and
+// symlinks not followed.
+//
+// What a directory holds is cached by (device, inode) for as long as its
+// mtime stays the same, so repeated runs only stat the directories. Files that
+// grow in place are picked up once their directory changes.
+std::shared_ptr<directory_sizes> compute_directory_sizes(const std::filesystem::path& dir,
+    const std::vector<std::pair<std::string, std::uint32_t>>& directories, std::stop_token stop);
+
+}
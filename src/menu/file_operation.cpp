@@ -0,0 +1,369 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+module openxmb.app;
+
+import :file_operation;
+import :progress_overlay;
+
+import openxmb.utils;
+import spdlog;
+import i18n;
+
+namespace menu {
+    using namespace mfk::i18n::literals;
+
+    namespace {
+        // Bytes per copy call, which bounds how long cancelling takes
+        constexpr std::size_t chunk_size = 16 * 1024 * 1024;
+        constexpr std::size_t buffer_size = 1024 * 1024;
+
+        std::system_error errno_error(const std::filesystem::path& path) {
+            return std::system_error(errno, std::generic_category(), path.string());
+        }
+
+        std::string format_size(std::uint64_t bytes) {
+            constexpr std::array units{"KB", "MB", "GB", "TB"};
+            if(bytes < 1024) {
+                return std::format("{} B", bytes);
+            }
+            double value = static_cast<double>(bytes) / 1024;
+            std::size_t unit = 0;
+            while(value >= 1024 && unit + 1 < units.size()) {
+                value /= 1024;
+                unit++;
+            }
+            return std::format("{:.1f} {}", value, units[unit]);
+        }
+
+        // One file, directory or symlink to create or delete.
+        struct step {
+            std::filesystem::path from;
+            std::filesystem::path to;
+            std::filesystem::file_type type;
+            std::uint64_t size = 0;
+        };
+
+        // Adds from and everything below it in pre-order, without following symlinks.
+        void plan(const std::filesystem::path& from, const std::filesystem::path& to, std::vector<step>& steps,
+            std::stop_token stop)
+        {
+            const auto status = std::filesystem::symlink_status(from);
+            const auto type = status.type();
+            steps.push_back({from, to, type, type == std::filesystem::file_type::regular ? std::filesystem::file_size(from) : 0});
+            if(type != std::filesystem::file_type::directory) {
+                return;
+            }
+            for(const auto& entry : std::filesystem::directory_iterator(from)) {
+                if(stop.stop_requested()) return;
+                plan(entry.path(), to.empty() ? to : to / entry.path().filename(), steps, stop);
+            }
+        }
+
+        // dir/name, or "name (2).ext" and so on if that is taken.
+        std::filesystem::path free_name(const std::filesystem::path& dir, const std::filesystem::path& name) {
+            auto candidate = dir / name;
+            std::error_code ec;
+            for(int i = 2; std::filesystem::exists(std::filesystem::symlink_status(candidate, ec)); i++) {
+                candidate = dir / std::format("{} ({}){}", name.stem().string(), i, name.extension().string());
+            }
+            return candidate;
+        }
+
+        void write_all(int fd, const char* data, std::size_t size, const std::filesystem::path& path) {
+            while(size > 0) {
+                const ssize_t n = ::write(fd, data, size);
+                if(n < 0) {
+                    if(errno == EINTR) continue;
+                    throw errno_error(path);
+                }
+                data += n;
+                size -= static_cast<std::size_t>(n);
+            }
+        }
+
+        // Copies the content of in to out, counting it in done. False if stopped.
+        bool copy_data(int in, int out, const step& s, std::atomic<std::uint64_t>& done, std::stop_token stop) {
+            if(::ioctl(out, FICLONE, in) == 0) {
+                done += s.size;
+                return true;
+            }
+            bool in_kernel = true;
+            std::uint64_t copied = 0;
+            std::vector<char> buffer;
+            while(!stop.stop_requested()) {
+                ssize_t n = 0;
+                if(in_kernel) {
+                    n = ::copy_file_range(in, nullptr, out, nullptr, chunk_size, 0);
+                    if(n < 0 && copied == 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+                        // Too old a kernel, or a file system that cannot do it
+                        in_kernel = false;
+                        buffer.resize(buffer_size);
+                        continue;
+                    }
+                } else {
+                    n = ::read(in, buffer.data(), buffer.size());
+                    if(n > 0) {
+                        write_all(out, buffer.data(), static_cast<std::size_t>(n), s.to);
+                    }
+                }
+                if(n < 0) {
+                    if(errno == EINTR) continue;
+                    throw errno_error(s.from);
+                }
+                if(n == 0) {
+                    return true;
+                }
+                copied += static_cast<std::uint64_t>(n);
+                done += static_cast<std::uint64_t>(n);
+            }
+            return false;
+        }
+
+        // False if stopped, which leaves no partial file behind.
+        bool copy_file(const step& s, std::atomic<std::uint64_t>& done, std::stop_token stop) {
+            utils::unique_fd in(::open(s.from.c_str(), O_RDONLY | O_CLOEXEC));
+            struct stat st{};
+            if(!in || ::fstat(in.get(), &st) != 0) {
+                throw errno_error(s.from);
+            }
+            utils::unique_fd out(::open(s.to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777));
+            if(!out) {
+                throw errno_error(s.to);
+            }
+            bool copied = false;
+            try {
+                copied = copy_data(in.get(), out.get(), s, done, stop);
+            } catch(...) {
+                ::unlink(s.to.c_str());
+                throw;
+            }
+            if(!copied) {
+                ::unlink(s.to.c_str());
+                return false;
+            }
+            const std::array<timespec, 2> times{st.st_atim, st.st_mtim};
+            ::futimens(out.get(), times.data());
+            return true;
+        }
+    }
+
+    file_operation::file_operation(kind type, std::vector<std::filesystem::path> sources, std::filesystem::path target,
+        std::function<void()> finished)
+        : type(type), sources(std::move(sources)), target(std::move(target)), finished(std::move(finished))
+    {
+    }
+
+    file_operation::~file_operation() {
+        stop.request_stop();
+    }
+
+    app::progress_item::status file_operation::init(std::string& message) {
+        message = type == kind::remove ? "Deleting..."_() : type == kind::move ? "Moving..."_() : "Copying..."_();
+        // A thread of its own rather than a job: copies to slow media take
+        // minutes, which would hold a worker (or a mount's lane) all along.
+        std::thread([type = type, sources = sources, target = target, s = shared, stop = stop.get_token()]() {
+            auto set_current = [&s](const std::filesystem::path& path) {
+                std::lock_guard<std::mutex> lock(s->mutex);
+                s->current = path.filename().string();
+            };
+            try {
+                // Every source is checked before anything is touched, so one bad
+                // source does not leave the others half copied or moved
+                for(const auto& source : sources) {
+                    if(!std::filesystem::exists(std::filesystem::symlink_status(source))) {
+                        throw std::runtime_error("\"{}\" no longer exists."_(source.filename().string()));
+                    }
+                    if(type == kind::remove) {
+                        continue;
+                    }
+                    // The target is the source or below it unless the relative path leads out of it
+                    if(auto inner = target.lexically_relative(source); !inner.empty() && *inner.begin() != "..") {
+                        throw std::runtime_error("Cannot put \"{}\" into itself."_(source.filename().string()));
+                    }
+                }
+
+                std::vector<step> steps;
+                for(const auto& source : sources) {
+                    if(type == kind::remove) {
+                        plan(source, {}, steps, stop);
+                        continue;
+                    }
+                    if(type == kind::move && source.parent_path() == target) {
+                        continue; // already there
+                    }
+                    const auto to = free_name(target, source.filename());
+                    if(type == kind::move) {
+                        if(::rename(source.c_str(), to.c_str()) == 0) {
+                            continue;
+                        }
+                        if(errno != EXDEV) {
+                            throw errno_error(source);
+                        }
+                    }
+                    // Copied over, and for moves to another file system deleted after
+                    plan(source, to, steps, stop);
+                }
+                std::uint64_t total = 0;
+                for(const auto& step : steps) {
+                    total += type == kind::remove ? 1 : step.size;
+                }
+                s->total = total;
+                s->planned = true;
+
+                if(type == kind::remove) {
+                    // Reverse pre-order empties directories before they are removed
+                    for(auto it = steps.rbegin(); it != steps.rend() && !stop.stop_requested(); ++it) {
+                        set_current(it->from);
+                        std::filesystem::remove(it->from);
+                        s->done++;
+                    }
+                } else {
+                    std::vector<std::filesystem::path> skipped;
+                    for(const auto& step : steps) {
+                        if(stop.stop_requested()) break;
+                        set_current(step.from);
+                        switch(step.type) {
+                            case std::filesystem::file_type::directory:
+                                std::filesystem::create_directory(step.to, step.from);
+                                break;
+                            case std::filesystem::file_type::regular:
+                                copy_file(step, s->done, stop);
+                                break;
+                            case std::filesystem::file_type::symlink:
+                                std::filesystem::copy_symlink(step.from, step.to);
+                                break;
+                            default:
+                                spdlog::warn("Not copying special file {}", step.from.string());
+                                skipped.push_back(step.from);
+                                break;
+                        }
+                    }
+                    if(type == kind::move && !stop.stop_requested()) {
+                        if(skipped.empty()) {
+                            for(const auto& source : sources) {
+                                if(std::filesystem::exists(std::filesystem::symlink_status(source))) {
+                                    std::filesystem::remove_all(source);
+                                }
+                            }
+                        } else {
+                            // Only what was copied goes, the skipped entries and the
+                            // directories holding them stay. Reverse pre-order empties
+                            // directories before they are removed.
+                            for(auto it = steps.rbegin(); it != steps.rend() && !stop.stop_requested(); ++it) {
+                                const bool keep = std::ranges::any_of(skipped, [&](const auto& path) {
+                                    auto inner = path.lexically_relative(it->from);
+                                    return !inner.empty() && *inner.begin() != "..";
+                                });
+                                if(!keep) {
+                                    std::filesystem::remove(it->from);
+                                }
+                            }
+                        }
+                    }
+                    if(!skipped.empty()) {
+                        std::lock_guard<std::mutex> lock(s->mutex);
+                        s->notice = type == kind::move
+                            ? "{} special files (pipes, sockets or devices) were not moved and stay where they were."_(skipped.size())
+                            : "{} special files (pipes, sockets or devices) were not copied."_(skipped.size());
+                    }
+                }
+            } catch(const std::exception& e) {
+                spdlog::error("File operation failed: {}", e.what());
+                std::lock_guard<std::mutex> lock(s->mutex);
+                s->error = e.what();
+            }
+            s->complete = true;
+        }).detach();
+        return status::running;
+    }
+
+    app::progress_item::status file_operation::progress(double& progress, std::string& message) {
+        if(shared->complete) {
+            if(finished) {
+                finished();
+            }
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if(!shared->error.empty()) {
+                message = shared->error;
+                return status::error;
+            }
+            message = shared->notice;
+            return status::success;
+        }
+        const std::uint64_t total = shared->total, done = std::min<std::uint64_t>(shared->done, total);
+        progress = total > 0 ? static_cast<double>(done) / static_cast<double>(total) : 0.0;
+        if(!shared->planned) {
+            return status::running;
+        }
+        std::string current;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            current = shared->current;
+        }
+        switch(type) {
+            case kind::copy:
+                message = "Copying \"{}\"\n{} of {}"_(current, format_size(done), format_size(total));
+                break;
+            case kind::move:
+                message = "Moving \"{}\"\n{} of {}"_(current, format_size(done), format_size(total));
+                break;
+            case kind::remove:
+                message = "Deleting \"{}\"\n{} of {} items"_(current, done, total);
+                break;
+        }
+        return status::running;
+    }
+
+    bool file_operation::cancel(std::string& message) {
+        stop.request_stop();
+        message = {};
+        if(finished) {
+            finished(); // whatever was done so far stays
+        }
+        return true;
+    }
+
+}
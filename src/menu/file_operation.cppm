@@ -0,0 +1,83 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+export module openxmb.app:file_operation;
+
+import :progress_overlay;
+
+export namespace menu {
+
+// Copies, moves or deletes files on a thread of its own, shown by a
+// progress_overlay.
+//
+// File data never passes through user space where the kernel can avoid it:
+// files are reflinked with FICLONE on file systems that share extents
+// (btrfs, XFS), otherwise copied with copy_file_range(), which also lets NFS
+// and SMB copy on the server. Plain reads and writes are only the fallback
+// for file systems that support neither. Moves within one file system are
+// renames. Cancelling stops after the current chunk and removes the partial
+// file; everything finished so far stays.
+class file_operation : public app::progress_item {
+    public:
+        enum class kind { copy, move, remove };
+
+        // Copies or moves sources into the directory target, or deletes
+        // sources. finished is called on the main thread once it is over,
+        // unless the overlay is closed before.
+        file_operation(kind type, std::vector<std::filesystem::path> sources, std::filesystem::path target = {},
+            std::function<void()> finished = {});
+        ~file_operation() override;
+
+        status init(std::string& message) override;
+        status progress(double& progress, std::string& message) override;
+        bool cancel(std::string& message) override;
+    private:
+        // Shared with the thread, which may outlive the overlay for as long
+        // as a call on a slow file system takes.
+        struct state {
+            std::atomic<std::uint64_t> total{0}; // bytes, or entries when deleting
+            std::atomic<std::uint64_t> done{0};
+            std::atomic<bool> planned{false};
+            std::atomic<bool> complete{false};
+            std::mutex mutex;
+            std::string current; // name of the file being worked on
+            std::string error;
+            std::string notice; // shown once it succeeded, like files it left out
+        };
+
+        kind type;
+        std::vector<std::filesystem::path> sources;
+        std::filesystem::path target;
+        std::function<void()> finished;
+        std::shared_ptr<state> shared = std::make_shared<state>();
+        std::stop_source stop;
+};
+
+}
@@ -19,31 +19,58 @@
 module;
 
 #include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <format>
 #include <functional>
-#include <thread>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <mutex>
-#include <map>
 #include <numeric>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 #include <fstream>
 #include <nlohmann/json.hpp>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 module openxmb.app;
 
+import :archive;
+import :directory_reader;
+import :directory_sizes;
+import :file_operation;
 import :files_menu;
+import :media_library;
+import :mounts;
+import :removable_media;
+import :thumbnail_cache;
 import :menu_base;
 import :menu_utils;
 import :message_overlay;
 import :choice_overlay;
+import :keyboard_overlay;
 import :programs;
+import :progress_overlay;
 
 import openxmb.config;
+import openxmb.jobs;
+import openxmb.mime;
 import openxmb.utils;
 import dreamrender;
 import sdl2;
@@ -53,10 +80,34 @@ import i18n;
 namespace menu {
     using namespace mfk::i18n::literals;
 
+    namespace {
+        // MIME type from the extension. Files without a known one are sniffed,
+        // which costs an open and a read; scans do it on their job.
+        std::string content_type_for(int dirfd, const char* name, bool is_directory) {
+            if (is_directory) {
+                return std::string{mime::directory};
+            }
+            auto type = mime::from_name(std::filesystem::path(name).filename().native());
+            if (type.empty()) {
+                type = mime::sniff_file(dirfd, name);
+            }
+            return std::string{type.empty() ? mime::octet_stream : type};
+        }
+
+        std::filesystem::file_time_type to_file_time(const struct statx_timestamp& t) {
+            auto sys = std::chrono::sys_seconds(std::chrono::seconds(t.tv_sec)) + std::chrono::nanoseconds(t.tv_nsec);
+            return std::chrono::time_point_cast<std::filesystem::file_time_type::duration>(std::chrono::file_clock::from_sys(sys));
+        }
+
+        // Never block on an NFS attribute refresh or trigger an automount, cached attributes will do.
+        constexpr int statx_flags = AT_STATX_DONT_SYNC | AT_NO_AUTOMOUNT;
+    }
+
     // Implementation of file_info constructor
     file_info::file_info(const std::filesystem::directory_entry& entry) {
         name = entry.path().filename().string();
         display_name = name;
+        sort_key = utils::natural_sort_key(display_name);
         
         try {
             auto status = entry.status();
@@ -71,59 +122,8 @@ namespace menu {
             }
             
             modification_time = entry.last_write_time();
-            
-            // Determine content type based on file extension
-            std::string ext = entry.path().extension().string();
-            if (ext.empty()) {
-                if (is_directory) {
-                    content_type = "inode/directory";
-                } else {
-                    content_type = "application/octet-stream";
-                }
-            } else {
-                // Common MIME type mappings
-                static const std::map<std::string, std::string> mime_types = {
-                    {".txt", "text/plain"},
-                    {".md", "text/markdown"},
-                    {".html", "text/html"},
-                    {".htm", "text/html"},
-                    {".css", "text/css"},
-                    {".js", "application/javascript"},
-                    {".json", "application/json"},
-                    {".xml", "application/xml"},
-                    {".pdf", "application/pdf"},
-                    {".jpg", "image/jpeg"},
-                    {".jpeg", "image/jpeg"},
-                    {".png", "image/png"},
-                    {".gif", "image/gif"},
-                    {".bmp", "image/bmp"},
-                    {".svg", "image/svg+xml"},
-                    {".ico", "image/x-icon"},
-                    {".mp3", "audio/mpeg"},
-                    {".wav", "audio/wav"},
-                    {".ogg", "audio/ogg"},
-                    {".mp4", "video/mp4"},
-                    {".avi", "video/x-msvideo"},
-                    {".mkv", "video/x-matroska"},
-                    {".mov", "video/quicktime"},
-                    {".zip", "application/zip"},
-                    {".tar", "application/x-tar"},
-                    {".gz", "application/gzip"},
-                    {".7z", "application/x-7z-compressed"},
-                    {".exe", "application/x-executable"},
-                    {".deb", "application/vnd.debian.binary-package"},
-                    {".rpm", "application/x-rpm"},
-                    {".app", "application/x-executable"},
-                    {".dmg", "application/x-apple-diskimage"}
-                };
-                
-                auto it = mime_types.find(ext);
-                if (it != mime_types.end()) {
-                    content_type = it->second;
-                } else {
-                    content_type = "application/octet-stream";
-                }
-            }
+            has_stat = true;
+            content_type = content_type_for(AT_FDCWD, entry.path().c_str(), is_directory);
         } catch (const std::exception& e) {
             spdlog::warn("Error getting file info for {}: {}", entry.path().string(), e.what());
             content_type = "application/octet-stream";
@@ -134,192 +134,900 @@ namespace menu {
         }
     }
 
+    file_info::file_info(int dirfd, const directory_record& record, bool with_stat)
+        : name(record.name), display_name(record.name), sort_key(utils::natural_sort_key(record.name)),
+          size(0), is_directory(record.type == DT_DIR),
+          is_hidden(record.name.starts_with('.')), is_symlink(record.type == DT_LNK)
+    {
+        if (with_stat) {
+            fetch_stat(dirfd);
+        } else if (record.type == DT_LNK || record.type == DT_UNKNOWN) {
+            // d_type alone does not tell whether this leads to a directory
+            struct statx stx{};
+            if (::statx(dirfd, name.c_str(), statx_flags, STATX_TYPE, &stx) == 0) {
+                is_directory = S_ISDIR(stx.stx_mode);
+            }
+        }
+        content_type = content_type_for(dirfd, name.c_str(), is_directory);
+    }
+
+    bool file_info::fetch_stat(int dirfd) {
+        has_stat = true; // don't retry files that cannot be stat'ed
+        struct statx stx{};
+        if (::statx(dirfd, name.c_str(), statx_flags, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+            return false;
+        }
+        is_directory = S_ISDIR(stx.stx_mode);
+        size = S_ISREG(stx.stx_mode) ? stx.stx_size : 0;
+        modification_time = to_file_time(stx.stx_mtime);
+        return true;
+    }
+
+    file_info::file_info(const media_info& info)
+        : name(info.name), display_name(info.name),
+          content_type(info.is_directory ? mime::directory : info.mime), sort_key(utils::natural_sort_key(info.name)),
+          size(info.size),
+          is_directory(info.is_directory), is_hidden(info.is_hidden), is_symlink(info.is_symlink),
+          modification_time(info.modification_time), has_stat(true),
+          width(info.width), height(info.height), duration(info.duration), taken(info.taken)
+    {
+    }
+
+    file_info::file_info(const archive_member& member)
+        : name(std::filesystem::path(member.path).filename().string()), display_name(name),
+          sort_key(utils::natural_sort_key(name)), size(member.size),
+          is_directory(member.is_directory), is_hidden(name.starts_with('.')), is_symlink(false),
+          modification_time(member.modification_time), has_stat(true)
+    {
+        if (is_directory) {
+            content_type = mime::directory;
+        } else {
+            auto type = mime::from_name(name);
+            content_type = type.empty() ? mime::octet_stream : type;
+        }
+    }
+
+    namespace {
+        // Shows the file's thumbnail when it is resident, its type icon until then.
+        class thumbnail_entry : public action_menu_entry_shared {
+            public:
+                thumbnail_entry(thumbnail_cache& cache, std::filesystem::path file, std::string name,
+                    std::shared_ptr<dreamrender::texture>&& icon, std::function<result(action)> on_action)
+                    : action_menu_entry_shared(std::move(name), std::move(icon), std::function<result()>{}, std::move(on_action)),
+                      cache(cache), file(std::move(file)) {}
+
+                using action_menu_entry_shared::get_icon;
+                const dreamrender::texture& get_icon() const override {
+                    if(const auto* thumbnail = cache.get(file)) {
+                        return *thumbnail;
+                    }
+                    return action_menu_entry_shared::get_icon();
+                }
+            private:
+                thumbnail_cache& cache;
+                std::filesystem::path file;
+        };
+    }
+
     files_menu::files_menu(std::string name, dreamrender::texture&& icon, app::shell* xmb, std::filesystem::path path, dreamrender::resource_loader& loader)
     : simple_menu(std::move(name), std::move(icon)), xmb(xmb), path(std::move(path)), loader(loader)
     {
         reload();
     }
 
+    files_menu::files_menu(std::string name, dreamrender::texture&& icon, app::shell* xmb, std::filesystem::path root,
+        std::vector<file_info> files, dreamrender::resource_loader& loader)
+    : simple_menu(std::move(name), std::move(icon)), xmb(xmb), path(std::move(root)), loader(loader)
+    {
+        fixed = true;
+        cached_file_infos = std::move(files);
+        file_entries.resize(cached_file_infos.size());
+        last_scanned_path = path; // reload() only ever rebuilds the view
+    }
+
+    void files_menu::add_files(std::vector<file_info> files) {
+        const auto selected = selected_file_path();
+        const std::size_t first = cached_file_infos.size();
+        std::move(files.begin(), files.end(), std::back_inserter(cached_file_infos));
+        file_entries.resize(cached_file_infos.size());
+        files_changed();
+        if (!is_open) {
+            return; // the view is rebuilt when the menu opens
+        }
+        merge_into_view(first);
+        select_file_path(selected);
+        published_selection = selected_submenu;
+        invalidate();
+    }
+
+    void files_menu::set_files(std::vector<file_info> files) {
+        // Files that are still listed keep their entries
+        std::unordered_map<std::string_view, std::size_t> previous;
+        for (std::size_t i = 0; i < cached_file_infos.size(); i++) {
+            if (file_entries[i]) previous.emplace(cached_file_infos[i].name, i);
+        }
+        std::vector<std::unique_ptr<menu_entry>> kept(files.size());
+        for (std::size_t i = 0; i < files.size(); i++) {
+            if (auto it = previous.find(files[i].name); it != previous.end()) {
+                kept[i] = std::move(file_entries[it->second]);
+            }
+        }
+        auto selected = selected_file_path();
+        cached_file_infos = std::move(files);
+        file_entries = std::move(kept);
+        matched.clear();
+        files_changed();
+        if (!is_open) {
+            return; // the view is rebuilt when the menu opens
+        }
+        rebuild_view();
+        if (!select_file_path(selected) && selected_submenu >= first_file() + shown().size()) {
+            const unsigned int count = first_file() + shown().size();
+            selected_submenu = count > 0 ? count - 1 : 0;
+        }
+        published_selection = selected_submenu;
+        if (sort_needs_stat()) {
+            fetch_stats();
+        }
+    }
+
+    void files_menu::show_removable_media() {
+        devices.emplace([this](const removable_device& device) -> std::unique_ptr<menu_entry> {
+            dreamrender::texture icon_texture(loader.getDevice(), loader.getAllocator());
+            if (auto r = utils::resolve_icon_from_json("drive-removable-media")) {
+                try {
+                    loader.loadTexture(&icon_texture, r->string());
+                } catch (const std::exception& e) {
+                    spdlog::debug("Failed to load icon for {}: {}", device.point.string(), e.what());
+                }
+            }
+            return std::make_unique<files_menu>(device.label, std::move(icon_texture), xmb, device.point, loader);
+        });
+    }
+
     unsigned int files_menu::get_submenus_count() const {
         ensure_built();
-        return is_open ? entries.size() : 1;
+        if (!is_open) {
+            return 1;
+        }
+        return first_file() + shown().size() + (status ? 1 : 0);
     }
 
     menu::menu_entry& files_menu::get_submenu(unsigned int index) const {
         ensure_built();
+        if(index < first_file()) {
+            return *entries[index];
+        }
+        if(const unsigned int file = index - first_file(); file < shown().size()) {
+            return materialize(file);
+        } else if(status && file == shown().size()) {
+            return *status;
+        }
         return *entries.at(index);
     }
 
-    void files_menu::start_scan_async() {
-        // Cancel any in-flight scan by bumping generation
-        uint64_t gen = ++scan_generation;
-        scanning = true;
-        needs_rebuild = false;
+    void files_menu::visible_range(unsigned int first, unsigned int count) const {
+        ensure_built();
+        // Positions in the view, which starts after the device entries
+        const unsigned int from = first > first_file() ? first - first_file() : 0;
+        const unsigned int to = first + count > first_file() ? first + count - first_file() : 0;
+        const unsigned int size = shown().size();
+        const unsigned int begin = from > visible_prefetch ? from - visible_prefetch : 0;
+        const unsigned int end = std::min(size, to + visible_prefetch);
+        for(unsigned int i = begin; i < end; i++) {
+            materialize(i);
+        }
+    }
 
-        // Show a placeholder while scanning
-        entries.clear();
-        extra_data_entries.clear();
-        {
-            dreamrender::texture icon_texture(loader.getDevice(), loader.getAllocator());
-            entries.push_back(std::make_unique<action_menu_entry>(
-                std::string{"Loading..."}, std::move(icon_texture), std::function<result()>{}
-            ));
+    menu::menu_entry& files_menu::materialize(unsigned int index) const {
+        const auto file = shown().at(index);
+        auto& slot = file_entries[file];
+        if(!slot) {
+            slot = const_cast<files_menu*>(this)->make_entry(cached_file_infos[file]);
+        }
+        return *slot;
+    }
+
+    std::shared_ptr<dreamrender::texture> files_menu::type_icon(const std::string& content_type) const {
+        auto [it, inserted] = type_icons.try_emplace(content_type);
+        if(inserted) {
+            it->second = std::make_shared<dreamrender::texture>(loader.getDevice(), loader.getAllocator());
+            // Try to resolve icon from JSON config
+            if(auto r = utils::resolve_icon_from_json(content_type)) {
+                try {
+                    loader.loadTexture(it->second.get(), r->string());
+                } catch (const std::exception& e) {
+                    spdlog::debug("Failed to load icon for {}: {}", content_type, e.what());
+                }
+            }
         }
+        return it->second;
+    }
+
+    std::unique_ptr<menu::menu_entry> files_menu::make_entry(const file_info& info) {
+        auto on_action = [this, info](action a) {
+            return activate_file(info, a);
+        };
+        if ((info.content_type.starts_with("image/") || info.content_type.starts_with("video/")) && !in_archive()) {
+            // Images and videos show a downscaled preview once the thumbnail cache has one
+            return std::make_unique<thumbnail_entry>(xmb->get_thumbnail_cache(), path / info.name,
+                info.display_name, type_icon(info.content_type), std::move(on_action));
+        }
+        return std::make_unique<action_menu_entry_shared>(
+            info.display_name,
+            type_icon(info.content_type),
+            std::function<result()>{},
+            std::move(on_action)
+        );
+    }
 
-        // Launch background scan
-        std::thread([this, gen, p = path]() {
-            std::vector<file_info> file_infos;
+    std::uint64_t files_menu::get_revision() const {
+        ensure_built();
+        // Thumbnails appearing or being evicted change what the entries draw
+        auto thumbnails = xmb->get_thumbnail_cache().get_revision();
+        if(thumbnails != seen_thumbnail_revision) {
+            seen_thumbnail_revision = thumbnails;
+            const_cast<files_menu*>(this)->invalidate();
+        }
+        return simple_menu::get_revision();
+    }
+
+    void files_menu::cancel_thumbnails() {
+        xmb->get_thumbnail_cache().cancel_pending();
+    }
+
+    void files_menu::start_scan_async(bool retry) {
+        // Cancel any in-flight scan, it keeps its own state alive until it notices
+        stop_scan();
+        if (!retry) {
+            retry_at.reset();
+            retry_delay = {};
+        }
+        stalled = false;
+        if (!in_archive()) {
+            archive_file.clear();
+        }
+        // Watch before listing, so nothing created during the scan is missed
+        watch_directory();
+        // Thumbnails of the previous directory are no longer needed
+        cancel_thumbnails();
+        // Indexed directories open straight from the media library
+        from_library = false;
+        if (archive_file.empty() && list_from_library()) {
+            return;
+        }
+        scan = std::make_shared<scan_state>();
+        scan->with_stat = sort_needs_stat();
+        scan->progress = std::chrono::steady_clock::now().time_since_epoch().count();
+        // A retry keeps showing what the stalled scan found until it gets somewhere
+        replacing = retry && !cached_file_infos.empty();
+        if (!replacing) {
+            cached_file_infos.clear();
+            file_entries.clear();
+            clear_query(); // a new directory starts unfiltered
+            restore_selection = !old_selected_item.empty() && old_selected_item.parent_path() == path;
+            selection_moved = false;
+            selected_submenu = published_selection = first_file();
+            view.clear();
+            files_changed();
+            // Show a placeholder until the first batch arrives
+            set_status("Loading...");
+        }
+
+        // Launch background scan, on the mount's own thread if it is a network mount
+        std::string inner;
+        if (!archive_file.empty()) {
+            inner = path.lexically_relative(archive_file).generic_string();
+            if (inner == ".") inner.clear();
+        }
+        io_lanes::instance().submit(path, [state = scan, p = path, archive_path = archive_file, inner](std::stop_token stop) {
+            std::vector<file_info> batch;
+            auto last_publish = std::chrono::steady_clock::now();
+            // Hands the batch to the main thread; false once superseded.
+            auto publish = [&](bool complete) {
+                if (stop.stop_requested()) return false;
+                std::lock_guard<std::mutex> lk(state->mutex);
+                std::move(batch.begin(), batch.end(), std::back_inserter(state->pending));
+                batch.clear();
+                state->complete = complete;
+                state->has_pending = true;
+                return true;
+            };
+            auto progressed = [&state] {
+                state->progress = std::chrono::steady_clock::now().time_since_epoch().count();
+            };
             try {
-                std::filesystem::directory_iterator it{p};
-                for (auto iter = it; iter != std::filesystem::end(it); ++iter) {
-                    const auto& entry = *iter;
-                    try {
-                        if (scan_generation.load() != gen) return; // superseded
-                        file_info info(entry);
-                        file_infos.push_back(std::move(info));
-                    } catch (const std::exception& e) {
-                        spdlog::warn("Error processing file {}: {}", entry.path().string(), e.what());
+                if (!archive_path.empty()) {
+                    // Listed from the archive's index, which is built on first use
+                    progressed();
+                    for (const auto& member : archive::open(archive_path, progressed)->list(inner)) {
+                        batch.emplace_back(member);
                     }
+                    progressed();
+                    publish(true);
+                    return;
                 }
-                if (scan_generation.load() != gen) return; // superseded
-                {
-                    std::lock_guard<std::mutex> lk(cache_mutex);
-                    last_scanned_path = p;
-                    cached_file_infos.swap(file_infos);
+                directory_reader reader{p};
+                progressed();
+                for (auto records = reader.next(); !records.empty(); records = reader.next()) {
+                    progressed();
+                    if (stop.stop_requested()) return; // superseded
+                    const bool with_stat = state->with_stat.load();
+                    for (const auto& record : records) {
+                        batch.emplace_back(reader.fd(), record, with_stat);
+                    }
+                    auto now = std::chrono::steady_clock::now();
+                    if (batch.size() >= publish_batch || now - last_publish >= publish_interval) {
+                        if (!publish(false)) return;
+                        last_publish = now;
+                    }
                 }
-                needs_rebuild = true;
+                if (!publish(true)) return;
             } catch (const std::exception& e) {
                 spdlog::error("Error scanning directory {}: {}", p.string(), e.what());
+                publish(true); // show what we have
             }
-            scanning = false;
-        }).detach();
+        }, scan_stop.get_token(), jobs::priority::high);
+    }
+
+    void files_menu::check_scan() {
+        const auto now = std::chrono::steady_clock::now();
+        if (scan && !stalled) {
+            const std::chrono::steady_clock::time_point last{std::chrono::steady_clock::duration{scan->progress.load()}};
+            if (now - last >= scan_deadline) {
+                // Keep the scan, it may still come back, but try again later
+                stalled = true;
+                retry_delay = std::clamp(retry_delay * 2, min_retry_delay, max_retry_delay);
+                retry_at = now + retry_delay;
+                spdlog::warn("Listing {} is not responding, retrying in {} s", path.string(), retry_delay.count());
+                set_status("Not responding, retrying...");
+            }
+        }
+        if (retry_at && now >= *retry_at && is_open) {
+            retry_at.reset();
+            // The stalled call still occupies the mount's thread, the retry needs another one
+            io_lanes::instance().abandon(path);
+            start_scan_async(true);
+        }
+    }
+
+    void files_menu::set_status(std::string text) {
+        if (text.empty()) {
+            if (status) {
+                status.reset();
+                invalidate();
+            }
+            return;
+        }
+        dreamrender::texture icon_texture(loader.getDevice(), loader.getAllocator());
+        status = std::make_unique<action_menu_entry>(std::move(text), std::move(icon_texture), std::function<result()>{});
+        invalidate();
     }
 
     void files_menu::ensure_built() const {
-        if (needs_rebuild.load() && !scanning.load()) {
-            needs_rebuild = false;
-            // rebuild entries from cache
-            const_cast<files_menu*>(this)->entries.clear();
-            const_cast<files_menu*>(this)->extra_data_entries.clear();
-
-            std::vector<const file_info*> view;
-            {
-                std::lock_guard<std::mutex> lk(cache_mutex);
-                view.reserve(cached_file_infos.size());
-                for (const auto& info : cached_file_infos) {
-                    if (filter(info)) view.push_back(&info);
-                }
+        auto* self = const_cast<files_menu*>(this);
+        if (scan && scan->has_pending.load()) {
+            self->merge_pending();
+        }
+        if (scan || retry_at) {
+            self->check_scan();
+        }
+        if (sizes) {
+            if (auto now = std::chrono::steady_clock::now(); now - last_sizes >= sizes_interval) {
+                last_sizes = now;
+                self->apply_sizes();
             }
-            std::sort(view.begin(), view.end(), [this](const file_info* a, const file_info* b) {
-                bool result = sort(*a, *b);
-                return sort_descending ? !result : result;
-            });
-            for (const file_info* pinf : view) {
-                const auto& info = *pinf;
-                const_cast<files_menu*>(this)->extra_data_entries.push_back({path / info.name, info});
-
-                std::string icon_path;
-                std::string extension = std::filesystem::path(info.name).extension().string();
-                if (info.content_type.starts_with("image/") ||
-                    extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
-                    extension == ".bmp" || extension == ".gif") {
-                    icon_path = (path / info.name).string();
+        } else if (!sizes_current && is_open && !scan && sort_needs_sizes() && archive_file.empty()) {
+            // Archive indexes already sum up their directories
+            self->fetch_sizes();
+        }
+        if (devices) {
+            const unsigned int before = first_file();
+            if (int added = self->devices->update(xmb->get_removable_media(), self->entries, 0); added != 0) {
+                // Stay on the selected file, or on the device entry at the same place
+                if (selected_submenu >= before) {
+                    self->selected_submenu += added;
+                    self->published_selection += added;
                 } else {
-                    if(auto r = utils::resolve_icon_from_json(info.content_type)) {
-                        icon_path = r->string();
-                    }
+                    const unsigned int count = first_file() + shown().size() + (status ? 1 : 0);
+                    self->selected_submenu = self->published_selection = std::min(selected_submenu, count > 0 ? count - 1 : 0);
                 }
+                self->invalidate();
+            }
+        }
+        if (query_result->ready.load()) {
+            self->apply_query();
+        }
+        if (watch_fd && self->drain_watch() && is_open) {
+            self->reload();
+        }
+        if (from_library && xmb->get_media_library().get_revision() != library_revision) {
+            if (is_open) {
+                // A refreshed index is in, list again from it
+                self->old_selected_item = selected_file_path();
+                self->list_from_library();
+            } else {
+                self->last_scanned_path.clear(); // list again on open
+                self->from_library = false;
+            }
+        }
+    }
 
-                dreamrender::texture icon_texture(loader.getDevice(), loader.getAllocator());
-                auto entry = std::make_unique<action_menu_entry>(
-                    info.display_name,
-                    std::move(icon_texture),
-                    std::function<result()>{},
-                    [self = const_cast<files_menu*>(this), info](action a) { return self->activate_file(info, a); }
-                );
-                if(!icon_path.empty()) {
-                    try { loader.loadTexture(&entry->get_icon(), icon_path); }
-                    catch (const std::exception& e) { spdlog::debug("Failed to load icon for {}: {}", info.name, e.what()); }
+    bool files_menu::list_from_library() {
+        auto& library = xmb->get_media_library();
+        std::vector<file_info> infos;
+        if (!library.list(path, [&infos](const media_info& info) { infos.emplace_back(info); })) {
+            return false;
+        }
+        cached_file_infos = std::move(infos);
+        file_entries.clear();
+        file_entries.resize(cached_file_infos.size());
+        matched.clear();
+        files_changed();
+        last_scanned_path = path;
+        from_library = true;
+        library_revision = library.get_revision();
+        rebuild_view();
+        if (!select_file_path(old_selected_item)) {
+            selected_submenu = first_file();
+        }
+        published_selection = selected_submenu;
+        return true;
+    }
+
+    void files_menu::watch_directory() {
+        auto mount = find_mount(io_lanes::instance().mounts(), path);
+        if (!archive_file.empty() || (mount && mount->remote())) {
+            // inotify misses changes made on the server, and adding the watch
+            // looks the path up on the main thread, which a dead mount blocks.
+            // Inside an archive there is no directory to watch at all.
+            if (watch_wd >= 0) {
+                inotify_rm_watch(watch_fd.get(), watch_wd);
+                watch_wd = -1;
+            }
+            return;
+        }
+        if (!watch_fd) {
+            watch_fd = utils::unique_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+            if (!watch_fd) {
+                spdlog::warn("Cannot watch directories for changes: {}", std::strerror(errno));
+                return;
+            }
+        }
+        if (watch_wd >= 0) {
+            inotify_rm_watch(watch_fd.get(), watch_wd);
+        }
+        changed_names.clear();
+        watch_wd = inotify_add_watch(watch_fd.get(), path.c_str(),
+            IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE |
+            IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK);
+        if (watch_wd < 0) {
+            spdlog::debug("Cannot watch {}: {}", path.string(), std::strerror(errno));
+        }
+    }
+
+    bool files_menu::drain_watch(bool immediate) {
+        bool rescan = false, gone = false;
+        alignas(inotify_event) char buffer[16 * 1024];
+        while (true) {
+            const ssize_t n = ::read(watch_fd.get(), buffer, sizeof(buffer));
+            if (n <= 0) {
+                break; // EAGAIN, everything queued has been read
+            }
+            for (char* p = buffer; p < buffer + n;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    rescan = true;
+                } else if (event->wd != watch_wd) {
+                    continue; // left over from a previous directory
+                } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_IGNORED)) {
+                    gone = true;
+                } else if (event->len > 0) {
+                    changed_names.emplace(event->name);
+                }
+            }
+        }
+        if (gone) {
+            // Fall back to the closest directory that still exists
+            watch_wd = -1;
+            std::error_code ec;
+            while (path.has_relative_path() && !std::filesystem::is_directory(path, ec)) {
+                path = path.parent_path();
+            }
+            spdlog::info("Watched directory disappeared, showing {}", path.string());
+        }
+        if (rescan || gone) {
+            changed_names.clear();
+            last_scanned_path.clear();
+            return true;
+        }
+        if (!scan && !applying_changes && !changed_names.empty() &&
+            (immediate || std::chrono::steady_clock::now() - changes_applied_at >= change_interval)) {
+            apply_changes();
+        }
+        return false;
+    }
+
+    void files_menu::apply_changes() {
+        auto names = std::exchange(changed_names, {});
+        changes_applied_at = std::chrono::steady_clock::now();
+        applying_changes = true;
+
+        // Stat'ed like a scan does, on the job rather than the main thread
+        io_lanes::instance().submit(path, [this, dir = path, names = std::move(names), with_stat = sort_needs_stat()](std::stop_token stop) mutable {
+            std::vector<file_info> updated;
+            utils::unique_fd fd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+            for (const auto& name : names) {
+                if (stop.stop_requested()) return;
+                // Whatever is on disk now wins, names that are gone were deleted or moved away
+                struct statx stx{};
+                if (!fd || ::statx(fd.get(), name.c_str(), statx_flags | AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_INO, &stx) != 0) {
+                    continue;
                 }
-                const_cast<files_menu*>(this)->entries.push_back(std::move(entry));
+                const directory_record record{name, static_cast<unsigned char>(IFTODT(stx.stx_mode)), stx.stx_ino};
+                updated.emplace_back(fd.get(), record, with_stat);
             }
+            jobs::scheduler::instance().post_main([this, dir, names = std::move(names), updated = std::move(updated)]() mutable {
+                applying_changes = false;
+                if (dir == path) {
+                    merge_changes(names, std::move(updated));
+                }
+            }, stop);
+        }, changes_stop.get_token(), jobs::priority::high);
+    }
+
+    void files_menu::merge_changes(const std::unordered_set<std::string>& names, std::vector<file_info> updated) {
+        for (const auto& info : updated) {
+            xmb->get_thumbnail_cache().forget(path / info.name);
         }
+        const auto selected = selected_file_path();
+        remove_files(names);
+        const std::size_t first = cached_file_infos.size();
+        std::move(updated.begin(), updated.end(), std::back_inserter(cached_file_infos));
+        file_entries.resize(cached_file_infos.size());
+        files_changed();
+        if (!is_open) {
+            return; // the view is rebuilt from the cache when the menu opens
+        }
+        merge_into_view(first);
+        // A removed selection stays at its position, so the next entry gets selected
+        if (!select_file_path(selected)) {
+            unsigned int count = first_file() + shown().size();
+            selected_submenu = std::min(selected_submenu, count > 0 ? count - 1 : 0);
+        }
+        published_selection = selected_submenu;
+        invalidate();
     }
 
-    void files_menu::stop_scan() {
-        ++scan_generation; // supersede any worker
-        scanning = false;
+    void files_menu::remove_files(const std::unordered_set<std::string>& names) {
+        constexpr auto removed = std::numeric_limits<std::uint32_t>::max();
+        std::vector<std::uint32_t> moved_to(cached_file_infos.size(), removed);
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < cached_file_infos.size(); i++) {
+            if (names.contains(cached_file_infos[i].name)) {
+                continue;
+            }
+            moved_to[i] = kept;
+            if (kept != i) {
+                cached_file_infos[kept] = std::move(cached_file_infos[i]);
+                file_entries[kept] = std::move(file_entries[i]);
+            }
+            kept++;
+        }
+        cached_file_infos.resize(kept);
+        file_entries.resize(kept);
+        std::erase_if(view, [&moved_to](std::uint32_t& file) {
+            file = moved_to[file];
+            return file == removed;
+        });
+        // Matches stay valid for the files that were kept
+        std::size_t still_matched = 0;
+        for (std::size_t i = 0; i < matched.size(); i++) {
+            if (moved_to[i] != removed) {
+                matched[moved_to[i]] = matched[i];
+                still_matched++;
+            }
+        }
+        matched.resize(still_matched);
+        update_query_view();
     }
 
-    void files_menu::reload() {
-        if(selected_submenu < extra_data_entries.size()) {
-            old_selected_item = extra_data_entries[selected_submenu].path;
+    void files_menu::merge_into_view(std::size_t first) {
+        std::vector<std::uint32_t> added;
+        for (std::size_t i = first; i < cached_file_infos.size(); i++) {
+            if (filter(cached_file_infos[i])) added.push_back(i);
         }
+        auto less = [this](std::uint32_t a, std::uint32_t b) {
+            return before(cached_file_infos[a], cached_file_infos[b]);
+        };
+        jobs::parallel_stable_sort(added.begin(), added.end(), less);
+        // Merge the sorted files into the sorted view; on ties the view comes first
+        std::vector<std::uint32_t> merged;
+        merged.reserve(view.size() + added.size());
+        std::ranges::merge(view, added, std::back_inserter(merged), less);
+        view = std::move(merged);
+        update_query_view();
+    }
+
+    std::optional<std::uint32_t> files_menu::selected_file() const {
+        if (selected_submenu < first_file() || selected_submenu - first_file() >= shown().size()) {
+            return std::nullopt;
+        }
+        return shown()[selected_submenu - first_file()];
+    }
 
-        entries.clear();
-        extra_data_entries.clear();
+    std::filesystem::path files_menu::selected_file_path() const {
+        auto file = selected_file();
+        return file ? path / cached_file_infos[*file].name : std::filesystem::path{};
+    }
+
+    unsigned int files_menu::position_of(std::uint32_t file) const {
+        const auto& files = shown();
+        auto it = std::ranges::find(files, file);
+        return first_file() + (it != files.end() ? it - files.begin() : 0);
+    }
 
-        auto rebuild_from_cache = [this]() {
-            // Filter view from cached infos
-            std::vector<const file_info*> view;
-            view.reserve(cached_file_infos.size());
-            for (const auto& info : cached_file_infos) {
-                if (filter(info)) view.push_back(&info);
+    bool files_menu::select_file_path(const std::filesystem::path& file) {
+        if (file.empty()) {
+            return false;
+        }
+        // Names are relative to path, in fixed lists they may have several components
+        const auto name = file.lexically_relative(path).string();
+        if (name.empty() || name.starts_with("..")) {
+            return false;
+        }
+        const auto& files = shown();
+        auto it = std::ranges::find_if(files, [&](std::uint32_t i) { return cached_file_infos[i].name == name; });
+        if (it == files.end()) {
+            return false;
+        }
+        selected_submenu = first_file() + (it - files.begin());
+        return true;
+    }
+
+    result files_menu::on_text(std::string_view text) {
+        if (!is_open || text.empty()) {
+            return result::unsupported;
+        }
+        query += text;
+        start_query();
+        invalidate();
+        return result::success;
+    }
+
+    result files_menu::on_text_erase() {
+        if (!is_open || query.empty()) {
+            return result::unsupported | result::error_rumble;
+        }
+        // Drop one UTF-8 character, continuation bytes first
+        while (query.size() > 1 && (static_cast<unsigned char>(query.back()) & 0xC0) == 0x80) {
+            query.pop_back();
+        }
+        query.pop_back();
+        if (query.empty()) {
+            auto selected = selected_file();
+            clear_query();
+            selected_submenu = published_selection = selected ? position_of(*selected) : first_file();
+        } else {
+            start_query();
+        }
+        invalidate();
+        return result::success;
+    }
+
+    void files_menu::clear_query() {
+        query_stop.request_stop();
+        query_stop = std::stop_source{};
+        query.clear();
+        matched_query.clear();
+        matched.clear();
+        query_view.clear();
+    }
+
+    void files_menu::files_changed() {
+        names.reset();
+        files_version++;
+        // Indices moved or directories came and went, sum them up again
+        stop_sizes();
+        sizes_current = false;
+        if (!query.empty()) {
+            start_query(); // indices moved, match again
+        }
+    }
+
+    void files_menu::start_query() {
+        query_stop.request_stop(); // superseded
+        query_stop = std::stop_source{};
+        if (!names) {
+            // One folded copy of the names per listing, shared with the jobs
+            auto folded = std::make_shared<utils::folded_names>();
+            std::size_t bytes = 0;
+            for (const auto& info : cached_file_infos) bytes += info.display_name.size();
+            folded->reserve(cached_file_infos.size(), bytes);
+            for (const auto& info : cached_file_infos) folded->add(info.display_name);
+            names = std::move(folded);
+        }
+        // A longer query only needs to look at what the shorter one matched
+        std::optional<std::vector<std::uint32_t>> candidates;
+        if (!matched_query.empty() && query.starts_with(matched_query) && matched.size() == cached_file_infos.size()) {
+            candidates.emplace();
+            for (std::uint32_t i = 0; i < matched.size(); i++) {
+                if (matched[i]) candidates->push_back(i);
             }
-            // Sort view
-            std::sort(view.begin(), view.end(), [this](const file_info* a, const file_info* b) {
-                bool result = sort(*a, *b);
-                return sort_descending ? !result : result;
-            });
+        }
+        jobs::scheduler::instance().submit([state = query_result, names = names, needle = query, version = files_version,
+            candidates = std::move(candidates)](std::stop_token stop) {
+            auto found = candidates ? names->find(needle, *candidates) : names->find(needle);
+            if (stop.stop_requested()) return;
+            std::lock_guard<std::mutex> lk(state->mutex);
+            state->query = needle;
+            state->version = version;
+            state->matches = std::move(found);
+            state->ready = true;
+        }, query_stop.get_token(), jobs::priority::high);
+    }
+
+    void files_menu::apply_query() {
+        std::string for_query;
+        std::uint64_t version = 0;
+        std::vector<std::uint32_t> matches;
+        {
+            std::lock_guard<std::mutex> lk(query_result->mutex);
+            for_query = std::move(query_result->query);
+            version = query_result->version;
+            matches = std::move(query_result->matches);
+            query_result->ready = false;
+        }
+        if (for_query != query || version != files_version) {
+            return; // superseded, a newer query is running
+        }
+        auto selected = selected_file();
+        matched.assign(cached_file_infos.size(), 0);
+        for (auto i : matches) matched[i] = 1;
+        matched_query = std::move(for_query);
+        update_query_view();
+        selected_submenu = published_selection = selected && matched[*selected] ? position_of(*selected) : first_file();
+        invalidate();
+    }
+
+    void files_menu::update_query_view() {
+        if (matched_query.empty()) {
+            return;
+        }
+        query_view.clear();
+        for (auto i : view) {
+            if (i < matched.size() && matched[i]) query_view.push_back(i);
+        }
+    }
 
-            // Create menu entries
-            for (const file_info* pinf : view) {
-                const auto& info = *pinf;
-                extra_data_entries.push_back({path / info.name, info});
+    bool files_menu::before(const file_info& a, const file_info& b) const {
+        return sort_descending ? sort(b, a) : sort(a, b);
+    }
 
-                std::string icon_path;
-                std::string extension = std::filesystem::path(info.name).extension().string();
+    void files_menu::merge_pending() {
+        std::vector<file_info> batch;
+        bool complete = false;
+        {
+            std::lock_guard<std::mutex> lk(scan->mutex);
+            batch.swap(scan->pending);
+            complete = scan->complete;
+            scan->has_pending = false;
+        }
+        if (complete) {
+            last_scanned_path = path;
+            scan.reset();
+            if (sort_needs_stat()) {
+                fetch_stats(); // for entries listed before the sort changed
+            }
+        }
+        if (!batch.empty() || complete) {
+            // Going again, whether it was stalled or not
+            set_status({});
+            stalled = false;
+            retry_at.reset();
+            if (complete) retry_delay = {};
+        }
+        if (replacing && (!batch.empty() || complete)) {
+            // A retry got through, its listing replaces what the stalled scan left
+            replacing = false;
+            old_selected_item = selected_file_path();
+            restore_selection = !old_selected_item.empty();
+            selection_moved = false;
+            cached_file_infos.clear();
+            file_entries.clear();
+            view.clear();
+            matched.clear();
+            files_changed();
+            update_query_view();
+        }
+        if (batch.empty()) {
+            invalidate();
+            return;
+        }
 
-                // Try to find appropriate icon
-                if (info.content_type.starts_with("image/") ||
-                    extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
-                    extension == ".bmp" || extension == ".gif") {
-                    icon_path = (path / info.name).string();
-                } else {
-                    // Try to resolve icon from JSON config
-                    if(auto r = utils::resolve_icon_from_json(info.content_type)) {
-                        icon_path = r->string();
-                    }
-                }
+        if (selected_submenu != published_selection) {
+            selection_moved = true;
+        }
+        auto followed = selection_moved ? selected_file() : std::nullopt;
 
-                dreamrender::texture icon_texture(loader.getDevice(), loader.getAllocator());
-                auto entry = std::make_unique<action_menu_entry>(
-                    info.display_name,
-                    std::move(icon_texture),
-                    std::function<result()>{},
-                    [this, info](action a) {
-                        return activate_file(info, a);
-                    }
-                );
+        const std::size_t first = cached_file_infos.size();
+        std::move(batch.begin(), batch.end(), std::back_inserter(cached_file_infos));
+        file_entries.resize(cached_file_infos.size());
+        const std::size_t listed = view.size();
+        merge_into_view(first);
+        files_changed();
+        if (view.size() == listed) {
+            invalidate();
+            return;
+        }
 
-                if(!icon_path.empty()) {
-                    try {
-                        loader.loadTexture(&entry->get_icon(), icon_path);
-                    } catch (const std::exception& e) {
-                        spdlog::debug("Failed to load icon for {}: {}", info.name, e.what());
-                    }
+        if (restore_selection && !selection_moved) {
+            for (std::size_t i = first; i < cached_file_infos.size(); i++) {
+                if (path / cached_file_infos[i].name == old_selected_item && filter(cached_file_infos[i])) {
+                    // Follow the restored entry from now on
+                    restore_selection = false;
+                    selection_moved = true;
+                    followed = i;
+                    break;
                 }
-
-                entries.push_back(std::move(entry));
             }
-        };
+        }
+        if (followed) {
+            selected_submenu = position_of(*followed);
+        } else if (!selection_moved || selected_submenu >= first_file()) {
+            selected_submenu = first_file();
+        }
+        published_selection = selected_submenu;
+        invalidate();
+    }
+
+    void files_menu::rebuild_view() {
+        invalidate();
+
+        // Filter and sort a permutation of the cached infos. Entries stay in
+        // file_entries, so no I/O happens and no icon is loaded again.
+        view.clear();
+        view.reserve(cached_file_infos.size());
+        for (std::size_t i = 0; i < cached_file_infos.size(); i++) {
+            if (filter(cached_file_infos[i])) view.push_back(i);
+        }
+        jobs::parallel_stable_sort(view.begin(), view.end(), [this](std::uint32_t a, std::uint32_t b) {
+            return before(cached_file_infos[a], cached_file_infos[b]);
+        });
+        update_query_view();
+    }
+
+    void files_menu::stop_scan() {
+        scan_stop.request_stop(); // supersede any running scan
+        scan_stop = std::stop_source{};
+        scan.reset();
+        stat_stop.request_stop();
+        stat_stop = std::stop_source{};
+        changes_stop.request_stop();
+        changes_stop = std::stop_source{};
+        applying_changes = false;
+    }
+
+    void files_menu::reload() {
+        if(auto selected = selected_file_path(); !selected.empty()) {
+            old_selected_item = std::move(selected);
+        }
 
         try {
+            // Bring the cache up to date with the watched directory first
+            if (last_scanned_path == path && watch_fd) {
+                drain_watch(true);
+            }
             // Asynchronous rescan if path changed; otherwise rebuild from cached data
             if (last_scanned_path != path) {
                 start_scan_async();
             } else {
-                rebuild_from_cache();
+                rebuild_view();
+                select_file_path(old_selected_item);
+                if (sort_needs_stat()) {
+                    fetch_stats();
+                }
             }
         } catch (const std::exception& e) {
             spdlog::error("Error reloading files menu: {}", e.what());
@@ -335,6 +1043,14 @@ namespace menu {
                 path = file_path;
                 reload();
                 return result::success;
+            } else if (in_archive()) {
+                return open_member(info);
+            } else if (archive::supported(info.content_type)) {
+                // Browse the archive like a directory
+                archive_file = file_path;
+                path = file_path;
+                reload();
+                return result::success;
             } else {
                 // Try to open file with appropriate program
                 auto open_infos = programs::get_open_infos(file_path, programs::file_info(file_path));
@@ -358,6 +1074,45 @@ namespace menu {
         return result::unsupported;
     }
 
+    result files_menu::open_member(const file_info& info) {
+        const auto member = (path / info.name).lexically_relative(archive_file).generic_string();
+        io_lanes::instance().submit(archive_file, [this, file = archive_file, member](std::stop_token stop) {
+            std::shared_ptr<utils::unique_fd> fd;
+            bool too_large = false;
+            try {
+                fd = std::make_shared<utils::unique_fd>(archive::open(file)->extract(member, stop));
+            } catch (const member_too_large& e) {
+                spdlog::warn("Not extracting {}: {}", member, e.what());
+                too_large = true;
+            } catch (const std::exception& e) {
+                spdlog::error("Cannot extract {} from {}: {}", member, file.string(), e.what());
+            }
+            if (stop.stop_requested()) return;
+            jobs::scheduler::instance().post_main([this, fd, too_large, file, member]() {
+                if (fd && *fd) {
+                    // Programs open it by path, the name still tells them the type
+                    const std::filesystem::path proc = std::format("/proc/self/fd/{}", fd->get());
+                    auto type = programs::file_info(proc);
+                    auto open_infos = programs::get_open_infos(file / member, type);
+                    if (!open_infos.empty()) {
+                        if (auto component = open_infos[0].create(proc, loader)) {
+                            extracted.push_back(fd);
+                            if (extracted.size() > max_extracted) extracted.pop_front();
+                            xmb->push_overlay(std::move(component));
+                            return;
+                        }
+                    }
+                }
+                xmb->emplace_overlay<app::message_overlay>(
+                    "Cannot Open File"_(),
+                    too_large ? "The file is too large to open from inside the archive. Extract it first."_() :
+                    fd && *fd ? "No suitable program found to open this file type."_() : "The file could not be extracted from the archive."_()
+                );
+            }, stop);
+        }, open_stop.get_token(), jobs::priority::high);
+        return result::success;
+    }
+
     result files_menu::activate(action action) {
         if(action == action::extra) {
             selected_filter = (selected_filter + 1) % filters.size();
@@ -365,15 +1120,16 @@ namespace menu {
             resort();
             return result::unsupported;
         } else if(action == action::options) {
-            selected_sort = (selected_sort + 1) % sorts.size();
-            sort = sorts[selected_sort].second;
-            resort();
-            return result::unsupported;
+            show_options();
+            return result::success;
         } else if(action == action::cancel) {
             sort_descending = !sort_descending;
             resort();
             return result::unsupported;
         }
+        if(is_open && selected_submenu >= first_file() && selected_submenu - first_file() < shown().size()) {
+            return materialize(selected_submenu - first_file()).activate(action);
+        }
         return simple_menu::activate(action);
     }
 
@@ -381,65 +1137,227 @@ namespace menu {
         v.emplace_back(action::none, "");
         v.emplace_back(action::none, "");
         v.emplace_back(action::extra, filters[selected_filter].first);
-        v.emplace_back(action::options, sorts[selected_sort].first);
+        v.emplace_back(action::options, "Options"_());
         v.emplace_back(action::cancel, sort_descending ? "Ascending"_() : "Descending"_());
     }
 
+    void files_menu::show_options() {
+        // Files only change in real directories, fixed lists and archives can only be copied from
+        const auto file = in_archive() ? std::filesystem::path{} : selected_file_path();
+        const bool writable = !fixed && !in_archive() && is_open;
+        const auto& clipboard = xmb->get_clipboard();
+        const bool can_paste = writable && clipboard && std::holds_alternative<std::function<bool(std::filesystem::path)>>(*clipboard);
+
+        std::vector<std::string> labels;
+        std::vector<std::function<void()>> choices;
+        if (is_open) {
+            labels.push_back("Search"_());
+            choices.push_back([this] { xmb->emplace_overlay<app::keyboard_overlay>(*this); });
+        }
+        if (!query.empty()) {
+            labels.push_back("Clear search"_());
+            choices.push_back([this] {
+                auto selected = selected_file();
+                clear_query();
+                selected_submenu = published_selection = selected ? position_of(*selected) : first_file();
+                invalidate();
+            });
+        }
+        if (!file.empty()) {
+            labels.push_back("Copy"_());
+            choices.push_back([this, file] { put_on_clipboard(file, file_operation::kind::copy); });
+        }
+        if (!file.empty() && writable) {
+            labels.push_back("Move"_());
+            choices.push_back([this, file] { put_on_clipboard(file, file_operation::kind::move); });
+        }
+        if (can_paste) {
+            labels.push_back("Paste"_());
+            choices.push_back([this] {
+                const auto& clipboard = xmb->get_clipboard();
+                if (clipboard && std::get<std::function<bool(std::filesystem::path)>>(*clipboard)(path) && watch_wd < 0) {
+                    // Nothing tells an unwatched directory when the paste is done, list it again on open
+                    last_scanned_path.clear();
+                }
+            });
+        }
+        if (!file.empty() && writable) {
+            labels.push_back("Delete"_());
+            choices.push_back([this, file] { delete_file(file); });
+        }
+        const auto next_sort = (selected_sort + 1) % sorts.size();
+        labels.push_back("Sort by {}"_(sorts[next_sort].first));
+        choices.push_back([this, next_sort] {
+            selected_sort = next_sort;
+            sort = sorts[selected_sort].second;
+            resort();
+        });
+        xmb->emplace_overlay<app::choice_overlay>(labels, 0, [choices = std::move(choices)](unsigned int index) {
+            if (index < choices.size()) {
+                choices[index]();
+            }
+        });
+    }
+
+    void files_menu::put_on_clipboard(const std::filesystem::path& file, file_operation::kind kind) {
+        // Pasting runs the operation into the directory it is pasted in; a move only works once
+        auto pasted = std::make_shared<bool>(false);
+        xmb->set_clipboard(std::function<bool(std::filesystem::path)>{[xmb = xmb, file, kind, pasted](std::filesystem::path target) {
+            if (*pasted) {
+                return false;
+            }
+            *pasted = kind == file_operation::kind::move;
+            xmb->emplace_overlay<app::progress_overlay>(kind == file_operation::kind::move ? "Move"_() : "Copy"_(),
+                std::make_unique<file_operation>(kind, std::vector{file}, std::move(target)));
+            return true;
+        }});
+    }
+
+    void files_menu::delete_file(const std::filesystem::path& file) {
+        xmb->emplace_overlay<app::message_overlay>("Delete"_(), "Delete \"{}\"?"_(file.filename().string()),
+            std::vector<std::string>{"Yes"_(), "No"_()}, [this, file, alive = std::weak_ptr<bool>(exists_flag)](unsigned int choice) {
+                if (choice != 0 || alive.expired()) {
+                    return;
+                }
+                xmb->emplace_overlay<app::progress_overlay>("Delete"_(),
+                    std::make_unique<file_operation>(file_operation::kind::remove, std::vector{file}, std::filesystem::path{},
+                        [this, alive] {
+                            if (!alive.expired()) rescan_unwatched();
+                        }));
+            });
+    }
+
+    void files_menu::rescan_unwatched() {
+        if (watch_wd >= 0) {
+            return; // the watch picks the changes up
+        }
+        last_scanned_path.clear();
+        if (is_open) {
+            reload();
+        }
+    }
+
     void files_menu::on_open() {
         simple_menu::on_open();
         reload();
     }
 
-    void files_menu::resort() {
-        // Rebuild entries from cached_file_infos without rescanning I/O
-        entries.clear();
-        extra_data_entries.clear();
+    bool files_menu::sort_needs_stat() const {
+        // Sorting by size or date looks at the stat fields
+        const auto sort = sorts[selected_sort].second;
+        return sort == static_cast<sort_entry_type::second_type>(sort_by_size) ||
+            sort == static_cast<sort_entry_type::second_type>(sort_by_date);
+    }
 
-        // Delegate to reload()'s internal logic by simulating no path change
-        // but without touching last_scanned_path; replicate builder here
-        try {
-            // Filter view
-            std::vector<const file_info*> view;
-            view.reserve(cached_file_infos.size());
-            for (const auto& info : cached_file_infos) {
-                if (filter(info)) view.push_back(&info);
-            }
-            // Sort view
-            std::sort(view.begin(), view.end(), [this](const file_info* a, const file_info* b) {
-                bool result = sort(*a, *b);
-                return sort_descending ? !result : result;
-            });
-            // Create entries
-            for (const file_info* pinf : view) {
-                const auto& info = *pinf;
-                extra_data_entries.push_back({path / info.name, info});
-
-                std::string icon_path;
-                std::string extension = std::filesystem::path(info.name).extension().string();
-                if (info.content_type.starts_with("image/") ||
-                    extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
-                    extension == ".bmp" || extension == ".gif") {
-                    icon_path = (path / info.name).string();
-                } else {
-                    if(auto r = utils::resolve_icon_from_json(info.content_type)) {
-                        icon_path = r->string();
+    bool files_menu::sort_needs_sizes() const {
+        return sorts[selected_sort].second == static_cast<sort_entry_type::second_type>(sort_by_size);
+    }
+
+    void files_menu::fetch_sizes() {
+        stop_sizes();
+        sizes_current = true;
+        std::vector<std::pair<std::string, std::uint32_t>> directories;
+        for (std::uint32_t i = 0; i < cached_file_infos.size(); i++) {
+            const auto& info = cached_file_infos[i];
+            if (info.is_directory && !info.is_symlink) {
+                directories.emplace_back(info.name, i);
+            }
+        }
+        if (!directories.empty()) {
+            sizes = compute_directory_sizes(path, directories, sizes_stop.get_token());
+        }
+    }
+
+    void files_menu::apply_sizes() {
+        const bool done = sizes->remaining.load() == 0;
+        bool changed = false;
+        for (const auto& entry : sizes->entries) {
+            auto& info = cached_file_infos[entry.file];
+            const auto bytes = entry.bytes.load();
+            // Partial sums only grow, so a size from an earlier run stays until this one passes it
+            if (entry.complete() ? bytes != info.size : bytes > info.size) {
+                info.size = bytes;
+                changed = true;
+            }
+        }
+        if (done) {
+            sizes.reset();
+        }
+        if (changed && is_open) {
+            auto selected = selected_file_path();
+            rebuild_view();
+            select_file_path(selected);
+            published_selection = selected_submenu;
+        }
+    }
+
+    void files_menu::stop_sizes() {
+        sizes_stop.request_stop();
+        sizes_stop = std::stop_source{};
+        sizes.reset();
+    }
+
+    void files_menu::fetch_stats() {
+        std::vector<std::string> names;
+        for (const auto& info : cached_file_infos) {
+            if (!info.has_stat) names.push_back(info.name);
+        }
+        if (names.empty()) {
+            return;
+        }
+        stat_stop.request_stop();
+        stat_stop = std::stop_source{};
+        io_lanes::instance().submit(path, [this, dir = path, names = std::move(names)](std::stop_token stop) {
+            utils::unique_fd fd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+            if (!fd) {
+                return;
+            }
+            std::vector<file_info> stats;
+            stats.reserve(names.size());
+            for (const auto& name : names) {
+                if (stop.stop_requested()) return;
+                auto& info = stats.emplace_back();
+                info.name = name;
+                info.size = 0;
+                info.fetch_stat(fd.get());
+            }
+            // Only touches the menu on the main thread, and not at all once cancelled
+            jobs::scheduler::instance().post_main([this, dir, stats = std::move(stats)]() {
+                if (dir != path) return;
+                std::unordered_map<std::string_view, const file_info*> by_name;
+                for (const auto& s : stats) by_name.emplace(s.name, &s);
+                for (auto& info : cached_file_infos) {
+                    if (auto it = by_name.find(info.name); it != by_name.end() && !info.has_stat) {
+                        if (!info.is_directory) info.size = it->second->size; // see fetch_sizes()
+                        info.modification_time = it->second->modification_time;
+                        info.has_stat = true;
                     }
                 }
-                dreamrender::texture icon_texture(loader.getDevice(), loader.getAllocator());
-                auto entry = std::make_unique<action_menu_entry>(
-                    info.display_name,
-                    std::move(icon_texture),
-                    std::function<result()>{},
-                    [this, info](action a) { return activate_file(info, a); }
-                );
-                if(!icon_path.empty()) {
-                    try { loader.loadTexture(&entry->get_icon(), icon_path); }
-                    catch (const std::exception& e) { spdlog::debug("Failed to load icon for {}: {}", info.name, e.what()); }
+                if (is_open && !scan) {
+                    auto selected = selected_file_path();
+                    rebuild_view();
+                    select_file_path(selected);
                 }
-                entries.push_back(std::move(entry));
-            }
-        } catch(const std::exception& e) {
-            spdlog::error("Error resorting files menu: {}", e.what());
+            }, stop);
+        }, stat_stop.get_token(), jobs::priority::high);
+    }
+
+    void files_menu::resort() {
+        if (scan) {
+            scan->with_stat = sort_needs_stat();
+        }
+        if (!sort_needs_sizes()) {
+            stop_sizes();
+            sizes_current = false;
+        }
+        // Only the permutation is rebuilt, staying on the selected file
+        auto selected = selected_file_path();
+        rebuild_view();
+        select_file_path(selected);
+        published_selection = selected_submenu;
+        if (sort_needs_stat()) {
+            // Sizes arrive in the background and the view is sorted again then
+            fetch_stats();
         }
     }
 
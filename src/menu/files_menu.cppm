@@ -24,16 +24,21 @@
 module;
 
 #include <array>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <functional>
-#include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <stop_token>
 #include <string>
-#include <thread>
+#include <string_view>
 #include <atomic>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 export module openxmb.app:files_menu;
@@ -41,9 +46,16 @@ export module openxmb.app:files_menu;
 import spdlog;
 import dreamrender;
 import openxmb.config;
+import openxmb.jobs;
 import openxmb.utils;
+import :archive;
+import :directory_reader;
+import :directory_sizes;
+import :file_operation;
+import :media_library;
 import :menu_base;
 import :menu_utils;
+import :removable_media;
 
 namespace app {
     class shell;
@@ -56,45 +68,102 @@ struct file_info {
     std::string name;
     std::string display_name;
     std::string content_type;
+    // utils::natural_sort_key() of display_name, computed once when listed
+    std::string sort_key;
     std::uint64_t size;
     bool is_directory;
     bool is_hidden;
     bool is_symlink;
     std::filesystem::file_time_type modification_time;
+    // Whether size and modification_time were fetched. Scans only stat for
+    // them while the active sort needs them, see files_menu::fetch_stats().
+    bool has_stat = false;
+    // Media metadata, only known for entries listed from the media library.
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::chrono::milliseconds duration{0};
+    std::optional<std::chrono::sys_seconds> taken;
     
     file_info() = default;
     file_info(const std::filesystem::directory_entry& entry);
+    // From a directory_reader listing of the directory open as dirfd.
+    file_info(int dirfd, const directory_record& record, bool with_stat);
+    // Fetches size and modification_time; false if the file cannot be stat'ed.
+    bool fetch_stat(int dirfd);
+    explicit file_info(const media_info& info);
+    // A member of an archive, named by the last part of its path.
+    explicit file_info(const archive_member& member);
 };
 
-class files_menu : public simple_menu {
+class files_menu : public simple_menu, public text_receiver {
     public:
         files_menu(std::string name, dreamrender::texture&& icon, app::shell* xmb, std::filesystem::path path, dreamrender::resource_loader& loader);
-        ~files_menu() override = default;
+        // A fixed list of files somewhere below root, named relative to it.
+        // Nothing is scanned or watched, the owner updates it with set_files().
+        files_menu(std::string name, dreamrender::texture&& icon, app::shell* xmb, std::filesystem::path root,
+            std::vector<file_info> files, dreamrender::resource_loader& loader);
+        ~files_menu() override {
+            stop_scan();
+            open_stop.request_stop();
+        }
+
+        // Replaces the files of a fixed list, staying on the selected file if it is still there.
+        void set_files(std::vector<file_info> files);
+        // Adds files to a fixed list, merging them into the sorted view.
+        void add_files(std::vector<file_info> files);
+        // Lists the mounted USB drives and SD cards before the files, see main_menu.
+        void show_removable_media();
+        [[nodiscard]] std::size_t file_count() const { return cached_file_infos.size(); }
 
         void on_open() override;
         void on_close() override {
             simple_menu::on_close();
-            if(selected_submenu < extra_data_entries.size()) {
-                old_selected_item = extra_data_entries[selected_submenu].path;
+            if(auto selected = selected_file_path(); !selected.empty()) {
+                old_selected_item = std::move(selected);
+            }
+            view.clear();
+            clear_query();
+            set_status({});
+            retry_at.reset();
+            stop_sizes();
+            sizes_current = false;
+            if(watch_wd < 0 && !fixed) {
+                // Without a watch the cache would go stale while closed
+                last_scanned_path.clear();
+                cached_file_infos.clear();
+                file_entries.clear();
             }
-            entries.clear();
-            extra_data_entries.clear();
-            last_scanned_path.clear();
-            cached_file_infos.clear();
+            stop_scan();
+            cancel_thumbnails();
+            invalidate();
         }
 
         unsigned int get_submenus_count() const override;
         menu_entry& get_submenu(unsigned int index) const override;
+        void visible_range(unsigned int first, unsigned int count) const override;
+        std::uint64_t get_revision() const override;
         result activate(action action) override;
 
         void get_button_actions(std::vector<std::pair<action, std::string>>& v) override;
 
+        // Type-to-filter: only files whose name contains the typed text are
+        // shown, on top of the selected filter. Keyboards type directly, the
+        // "Search" option opens the on-screen keyboard for controllers.
+        result on_text(std::string_view text) override;
+        result on_text_erase() override;
+        std::string_view get_text() const override {
+            return query;
+        }
+
         static constexpr auto filter_all = [](const file_info&) { return true; };
         static constexpr auto filter_visible = [](const file_info& info) {
             return !info.is_hidden;
         };
 
         static constexpr auto sort_by_name = [](const file_info& a, const file_info& b) {
+            if(int c = a.sort_key.compare(b.sort_key); c != 0) {
+                return c < 0;
+            }
             return a.display_name.compare(b.display_name) < 0;
         };
         static constexpr auto sort_by_size = [](const file_info& a, const file_info& b) {
@@ -103,6 +172,14 @@ class files_menu : public simple_menu {
         static constexpr auto sort_by_type = [](const file_info& a, const file_info& b) {
             return a.content_type.compare(b.content_type) < 0;
         };
+        static constexpr auto sort_by_date = [](const file_info& a, const file_info& b) {
+            // When a photo or video was taken if the library knows, otherwise when it was last written
+            auto date = [](const file_info& f) {
+                return f.taken ? *f.taken : std::chrono::time_point_cast<std::chrono::seconds>(
+                    std::chrono::file_clock::to_sys(f.modification_time));
+            };
+            return date(a) < date(b);
+        };
 
         using filter_entry_type = std::pair<std::string_view, std::add_pointer_t<bool(const file_info&)>>;
         static constexpr std::array filters{
@@ -115,24 +192,99 @@ class files_menu : public simple_menu {
             sort_entry_type{"Name", sort_by_name},
             sort_entry_type{"Size", sort_by_size},
             sort_entry_type{"Type", sort_by_type},
+            sort_entry_type{"Date", sort_by_date},
         };
     private:
-        void start_scan_async();
+        void start_scan_async(bool retry = false);
+        void check_scan(); // notices stalled scans and retries them
+        void set_status(std::string text); // shown after the files, empty to remove
         void ensure_built() const; // may rebuild view entries from cache lazily
+        void rebuild_view();
+        void merge_pending(); // merges entries published by a running scan
+        void merge_into_view(std::size_t first); // adds the files from first on to the sorted view
+        void remove_files(const std::unordered_set<std::string>& names);
+        bool before(const file_info& a, const file_info& b) const;
+        std::optional<std::uint32_t> selected_file() const;
+        std::filesystem::path selected_file_path() const;
+        bool select_file_path(const std::filesystem::path& file);
+        unsigned int position_of(std::uint32_t file) const;
+        menu_entry& materialize(unsigned int index) const;
+        std::unique_ptr<menu_entry> make_entry(const file_info& info);
+        std::shared_ptr<dreamrender::texture> type_icon(const std::string& content_type) const;
+        // Menu position of the first file, after the device entries
+        unsigned int first_file() const {
+            return entries.size();
+        }
+        const std::vector<std::uint32_t>& shown() const {
+            return matched_query.empty() ? view : query_view;
+        }
+        void clear_query();
+        void files_changed(); // the cached files were replaced, added or removed
+        void start_query();
+        void apply_query();
+        void update_query_view();
         void stop_scan();
+        void watch_directory();
+        bool list_from_library();
+        // Applies queued inotify events without blocking, at most every
+        // change_interval unless immediate; true if a rescan is needed.
+        bool drain_watch(bool immediate = false);
+        void apply_changes(); // stats the changed names on a job, then merge_changes()
+        void merge_changes(const std::unordered_set<std::string>& names, std::vector<file_info> updated);
+        void cancel_thumbnails();
         void reload();
         void resort();
+        bool sort_needs_stat() const;
+        void fetch_stats(); // stats entries the scan skipped, then sorts again
+        bool sort_needs_sizes() const;
+        void fetch_sizes(); // sums up the directories, see compute_directory_sizes()
+        void apply_sizes();
+        void stop_sizes();
         result activate_file(const file_info& info, action action);
+        // Whether path is archive_file or a directory inside it
+        bool in_archive() const {
+            if (archive_file.empty()) return false;
+            const auto inner = path.lexically_relative(archive_file);
+            return !inner.empty() && !inner.native().starts_with("..");
+        }
+        result open_member(const file_info& info); // extracts it, then opens it like a file
+        void show_options(); // copy, move, paste and delete, and the sort order
+        void put_on_clipboard(const std::filesystem::path& file, file_operation::kind kind);
+        void delete_file(const std::filesystem::path& file);
+        void rescan_unwatched(); // after our own changes, which inotify would have shown otherwise
 
         app::shell* xmb;
         std::filesystem::path path;
         dreamrender::resource_loader& loader;
 
-        struct extra_data {
-            std::filesystem::path path;
-            file_info info;
+        // The view is a permutation of indices into cached_file_infos, so
+        // sorting and filtering never touch the entries. file_entries holds
+        // one slot per cached file that stays empty until the entry is first
+        // drawn or activated; entries only holds the removable devices.
+        std::vector<std::uint32_t> view;
+        mutable std::vector<std::unique_ptr<menu_entry>> file_entries;
+        // Type icons, loaded once and shared by every entry of that type
+        mutable std::unordered_map<std::string, std::shared_ptr<dreamrender::texture>> type_icons;
+        static constexpr unsigned int visible_prefetch = 8;
+
+        // Type-to-filter. Matching runs on a job over a folded copy of the
+        // names; while the query grows only the previous matches are searched.
+        // Until the first result is in, the unfiltered view stays.
+        std::string query;
+        std::string matched_query; // the query matched holds the result of
+        std::vector<std::uint8_t> matched; // per cached file
+        std::vector<std::uint32_t> query_view; // view restricted to the matches
+        std::shared_ptr<const utils::folded_names> names; // null once the files change
+        std::uint64_t files_version = 0;
+        struct query_state {
+            std::mutex mutex;
+            std::string query;
+            std::uint64_t version = 0;
+            std::vector<std::uint32_t> matches;
+            std::atomic<bool> ready{false};
         };
-        std::vector<extra_data> extra_data_entries;
+        std::shared_ptr<query_state> query_result = std::make_shared<query_state>();
+        std::stop_source query_stop;
 
         std::function<bool(const file_info&)> filter = filter_visible;
         std::function<bool(const file_info& a, const file_info& b)> sort = sort_by_name;
@@ -148,11 +300,73 @@ class files_menu : public simple_menu {
         // Cache last directory scan to avoid I/O on resort/filter changes
         std::filesystem::path last_scanned_path;
         mutable std::vector<file_info> cached_file_infos;
-        // Async scan machinery
-        mutable std::mutex cache_mutex;
-        mutable std::atomic<bool> scanning{false};
-        mutable std::atomic<bool> needs_rebuild{false};
-        mutable std::atomic<uint64_t> scan_generation{0};
+        // Async scan machinery. The scan job publishes into the shared state in
+        // batches, which the main thread merges into the sorted view. The job
+        // only holds the state, so a slow directory never blocks closing the menu.
+        struct scan_state {
+            std::mutex mutex;
+            std::vector<file_info> pending;
+            bool complete = false;
+            std::atomic<bool> has_pending{false};
+            std::atomic<bool> with_stat{false}; // whether to fetch size and mtime too
+            // steady_clock time of the last listing call that returned
+            std::atomic<std::chrono::steady_clock::rep> progress{0};
+        };
+        std::shared_ptr<scan_state> scan;
+        std::stop_source scan_stop;
+        std::stop_source stat_stop;
+        // Recursive directory sizes, computed while sorting by size and
+        // applied a few times a second as they grow.
+        std::shared_ptr<directory_sizes> sizes;
+        std::stop_source sizes_stop;
+        bool sizes_current = false; // whether sizes is for the current files
+        mutable std::chrono::steady_clock::time_point last_sizes;
+        static constexpr auto sizes_interval = std::chrono::milliseconds(250);
+        std::unique_ptr<menu_entry> status; // "Loading..." and the like
+        // A scan without progress for scan_deadline (e.g. on a dead network
+        // mount) keeps running but is retried with doubling delays; the files
+        // it found stay shown until a retry gets through.
+        bool stalled = false;
+        bool replacing = false;
+        std::optional<std::chrono::steady_clock::time_point> retry_at;
+        std::chrono::seconds retry_delay{0};
+        static constexpr auto scan_deadline = std::chrono::seconds(3);
+        static constexpr auto min_retry_delay = std::chrono::seconds(2);
+        static constexpr auto max_retry_delay = std::chrono::seconds(60);
+        // inotify watch on path. It stays while the menu is closed, so
+        // reopening applies the changes instead of rescanning. Names changed
+        // during a scan are applied once it completes. Changes are batched, so
+        // a file being written or a burst of copies re-sorts the view a few
+        // times a second rather than once per event.
+        utils::unique_fd watch_fd;
+        int watch_wd = -1;
+        std::unordered_set<std::string> changed_names;
+        std::chrono::steady_clock::time_point changes_applied_at{};
+        bool applying_changes = false; // one batch at a time, so they merge in order
+        std::stop_source changes_stop;
+        static constexpr auto change_interval = std::chrono::milliseconds(250);
+        // Set while the listing came from the media library, which may
+        // replace it with a fresher index later.
+        bool from_library = false;
+        std::uint64_t library_revision = 0;
+        bool fixed = false; // see set_files()
+        std::optional<device_entries> devices; // see show_removable_media()
+        // Set while browsing inside an archive, which is listed from its index
+        // instead of scanned. Opened members live in memfds, the last few are
+        // kept so the program showing one can still reopen it.
+        std::filesystem::path archive_file;
+        std::deque<std::shared_ptr<utils::unique_fd>> extracted;
+        static constexpr std::size_t max_extracted = 4;
+        std::stop_source open_stop;
+        // Selection handling while batches arrive: stay on the first entry (or
+        // old_selected_item once it shows up) until the user moves, then
+        // follow the selected entry.
+        bool restore_selection = false;
+        bool selection_moved = false;
+        unsigned int published_selection = 0;
+        static constexpr std::size_t publish_batch = 256;
+        static constexpr auto publish_interval = std::chrono::milliseconds(16);
+        mutable std::uint64_t seen_thumbnail_revision = 0;
 };
 
 }
@@ -0,0 +1,653 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/dict.h>
+}
+
+module openxmb.app;
+
+import :directory_reader;
+import :media_library;
+
+import openxmb.jobs;
+import openxmb.mime;
+import openxmb.utils;
+import spdlog;
+
+namespace menu {
+
+namespace {
+    constexpr std::array<char, 4> magic = {'O', 'X', 'L', 'I'};
+    // Bump whenever the layout or the probed metadata change.
+    constexpr std::uint32_t version = 1;
+
+    // On-disk layout: header, directories sorted by path, entries grouped by
+    // directory and sorted by name, then one blob with all strings.
+    struct header {
+        std::array<char, 4> magic;
+        std::uint32_t version;
+        std::uint64_t dir_count;
+        std::uint64_t entry_count;
+        std::uint64_t strings_size;
+    };
+    struct dir_record {
+        std::uint32_t path_offset, path_length; // relative to the root, "" for the root itself
+        std::uint32_t first_entry, entry_count;
+        std::int64_t mtime_ns;
+    };
+    struct entry_record {
+        std::uint32_t name_offset, name_length;
+        std::uint32_t mime_offset, mime_length;
+        std::uint64_t size;
+        std::int64_t mtime_ns;
+        std::int64_t taken; // seconds since the epoch, 0 if unknown
+        std::uint32_t width, height;
+        std::uint32_t duration_ms;
+        std::uint32_t flags;
+    };
+    enum entry_flags : std::uint32_t {
+        flag_directory = 1 << 0,
+        flag_hidden = 1 << 1,
+        flag_symlink = 1 << 2,
+    };
+
+    // Never block on an NFS attribute refresh or trigger an automount.
+    constexpr int statx_flags = AT_STATX_DONT_SYNC | AT_NO_AUTOMOUNT;
+
+    std::int64_t to_ns(const struct statx_timestamp& t) {
+        return t.tv_sec * 1'000'000'000ll + t.tv_nsec;
+    }
+
+    std::filesystem::path default_root() {
+        if(const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+            return std::filesystem::path(cache) / "openxmb" / "library";
+        }
+        const char* home = std::getenv("HOME");
+        return std::filesystem::path(home ? home : "") / ".cache" / "openxmb" / "library";
+    }
+
+    std::uint64_t fnv1a(std::string_view s) {
+        std::uint64_t h = 14695981039346656037ull;
+        for(char c : s) {
+            h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return h;
+    }
+
+    // Entry as built by a crawl, before it is written out.
+    struct built_entry {
+        std::string name;
+        std::string_view mime; // static storage from openxmb.mime or the previous index's strings
+        std::uint64_t size = 0;
+        std::int64_t mtime_ns = 0;
+        std::int64_t taken = 0;
+        std::uint32_t width = 0, height = 0, duration_ms = 0;
+        std::uint32_t flags = 0;
+    };
+    struct built_dir {
+        std::string path;
+        std::int64_t mtime_ns = 0;
+        std::vector<built_entry> entries;
+    };
+
+    // Reads "YYYY:MM:DD HH:MM:SS" (EXIF) or "YYYY-MM-DDTHH:MM:SS" (ISO 8601).
+    std::optional<std::chrono::sys_seconds> parse_date(std::string_view s) {
+        if(s.size() < 19) {
+            return std::nullopt;
+        }
+        auto number = [&](std::size_t pos, std::size_t len) -> std::optional<int> {
+            int v = 0;
+            for(std::size_t i = pos; i < pos + len; i++) {
+                if(s[i] < '0' || s[i] > '9') return std::nullopt;
+                v = v * 10 + (s[i] - '0');
+            }
+            return v;
+        };
+        auto y = number(0, 4), mo = number(5, 2), d = number(8, 2), h = number(11, 2), mi = number(14, 2), se = number(17, 2);
+        if(!y || !mo || !d || !h || !mi || !se || *y < 1900) {
+            return std::nullopt;
+        }
+        std::chrono::year_month_day date{std::chrono::year(*y), std::chrono::month(*mo), std::chrono::day(*d)};
+        if(!date.ok()) {
+            return std::nullopt;
+        }
+        return std::chrono::sys_days(date) + std::chrono::hours(*h) + std::chrono::minutes(*mi) + std::chrono::seconds(*se);
+    }
+
+    // DateTimeOriginal (or DateTime) from the EXIF block of a JPEG file.
+    std::optional<std::chrono::sys_seconds> read_exif_date(int dirfd, const char* name) {
+        utils::unique_fd fd(::openat(dirfd, name, O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY));
+        if(!fd) {
+            return std::nullopt;
+        }
+        // EXIF lives in APP1, right after the start of image marker.
+        std::vector<unsigned char> data(64 * 1024);
+        const ssize_t n = ::pread(fd.get(), data.data(), data.size(), 0);
+        if(n < 4 || data[0] != 0xff || data[1] != 0xd8) {
+            return std::nullopt;
+        }
+        data.resize(static_cast<std::size_t>(n));
+
+        std::size_t pos = 2;
+        while(pos + 4 <= data.size() && data[pos] == 0xff) {
+            const unsigned char marker = data[pos + 1];
+            const std::size_t length = (std::size_t{data[pos + 2]} << 8) | data[pos + 3];
+            if(marker == 0xda || length < 2) {
+                break; // image data starts, no EXIF before it
+            }
+            if(marker == 0xe1 && pos + 4 + length - 2 <= data.size() && length >= 8 &&
+                std::memcmp(&data[pos + 4], "Exif\0\0", 6) == 0)
+            {
+                const std::span<const unsigned char> tiff(&data[pos + 10], length - 8);
+                if(tiff.size() < 8) {
+                    return std::nullopt;
+                }
+                const bool little = tiff[0] == 'I';
+                auto u16 = [&](std::size_t o) -> std::uint32_t {
+                    if(o + 2 > tiff.size()) return 0;
+                    return little ? tiff[o] | (tiff[o + 1] << 8) : (tiff[o] << 8) | tiff[o + 1];
+                };
+                auto u32 = [&](std::size_t o) -> std::uint32_t {
+                    if(o + 4 > tiff.size()) return 0;
+                    return little ? u16(o) | (u16(o + 2) << 16) : (u16(o) << 16) | u16(o + 2);
+                };
+                // Value offset of tag in the IFD at offset ifd, if present.
+                auto find_tag = [&](std::uint32_t ifd, std::uint32_t tag) -> std::optional<std::uint32_t> {
+                    const std::uint32_t count = u16(ifd);
+                    for(std::uint32_t i = 0; i < count; i++) {
+                        const std::size_t e = ifd + 2 + i * 12;
+                        if(e + 12 > tiff.size()) break;
+                        if(u16(e) == tag) return u32(e + 8);
+                    }
+                    return std::nullopt;
+                };
+                auto date_at = [&](std::uint32_t offset) -> std::optional<std::chrono::sys_seconds> {
+                    if(offset + 19 > tiff.size()) return std::nullopt;
+                    return parse_date(std::string_view(reinterpret_cast<const char*>(&tiff[offset]), 19));
+                };
+                const std::uint32_t ifd0 = u32(4);
+                if(auto exif = find_tag(ifd0, 0x8769)) {
+                    if(auto original = find_tag(*exif, 0x9003)) {
+                        if(auto date = date_at(*original)) return date;
+                    }
+                }
+                if(auto modified = find_tag(ifd0, 0x0132)) {
+                    return date_at(*modified);
+                }
+                return std::nullopt;
+            }
+            pos += 2 + length;
+        }
+        return std::nullopt;
+    }
+
+    // Fills in dimensions, duration and capture date of a media file.
+    void probe(const std::filesystem::path& file, int dirfd, built_entry& entry, std::stop_token& stop) {
+        const bool image = entry.mime.starts_with("image/");
+        if(!image && !entry.mime.starts_with("video/") && !entry.mime.starts_with("audio/")) {
+            return;
+        }
+        if(entry.mime == "image/jpeg") {
+            if(auto date = read_exif_date(dirfd, entry.name.c_str())) {
+                entry.taken = date->time_since_epoch().count();
+            }
+        }
+
+        AVFormatContext* format_ctx = avformat_alloc_context();
+        if(!format_ctx) {
+            return;
+        }
+        format_ctx->interrupt_callback.callback = [](void* opaque) -> int {
+            return static_cast<std::stop_token*>(opaque)->stop_requested() ? 1 : 0;
+        };
+        format_ctx->interrupt_callback.opaque = &stop;
+        if(avformat_open_input(&format_ctx, file.c_str(), nullptr, nullptr) != 0) {
+            return; // frees format_ctx
+        }
+        if(avformat_find_stream_info(format_ctx, nullptr) >= 0) {
+            if(!image && format_ctx->duration > 0) {
+                entry.duration_ms = static_cast<std::uint32_t>(format_ctx->duration / (AV_TIME_BASE / 1000));
+            }
+            const int video = av_find_best_stream(format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+            if(video >= 0) {
+                entry.width = static_cast<std::uint32_t>(format_ctx->streams[video]->codecpar->width);
+                entry.height = static_cast<std::uint32_t>(format_ctx->streams[video]->codecpar->height);
+            }
+            if(entry.taken == 0) {
+                if(const auto* tag = av_dict_get(format_ctx->metadata, "creation_time", nullptr, 0)) {
+                    if(auto date = parse_date(tag->value)) {
+                        entry.taken = date->time_since_epoch().count();
+                    }
+                }
+            }
+        }
+        avformat_close_input(&format_ctx);
+    }
+}
+
+class media_library::index_file {
+    public:
+        // Maps file, or returns nullptr if it is missing or not a valid index.
+        static std::shared_ptr<const index_file> open(const std::filesystem::path& file) {
+            utils::unique_fd fd(::open(file.c_str(), O_RDONLY | O_CLOEXEC));
+            struct stat st{};
+            if(!fd || ::fstat(fd.get(), &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(header)) {
+                return nullptr;
+            }
+            const auto size = static_cast<std::size_t>(st.st_size);
+            void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+            if(data == MAP_FAILED) {
+                return nullptr;
+            }
+            auto index = std::shared_ptr<index_file>(new index_file(data, size));
+            if(!index->valid()) {
+                spdlog::warn("Ignoring invalid media library index {}", file.string());
+                return nullptr;
+            }
+            return index;
+        }
+        ~index_file() {
+            ::munmap(data, size);
+        }
+
+        const dir_record* find_dir(std::string_view path) const {
+            auto it = std::ranges::lower_bound(dirs, path, {}, [this](const dir_record& d) { return string(d.path_offset, d.path_length); });
+            return it != dirs.end() && string(it->path_offset, it->path_length) == path ? &*it : nullptr;
+        }
+        std::span<const dir_record> all_dirs() const {
+            return dirs;
+        }
+        std::span<const entry_record> entries_of(const dir_record& dir) const {
+            return entries.subspan(dir.first_entry, dir.entry_count);
+        }
+        const entry_record* find_entry(const dir_record& dir, std::string_view name) const {
+            auto list = entries_of(dir);
+            auto it = std::ranges::lower_bound(list, name, {}, [this](const entry_record& e) { return string(e.name_offset, e.name_length); });
+            return it != list.end() && string(it->name_offset, it->name_length) == name ? &*it : nullptr;
+        }
+        std::string_view string(std::uint32_t offset, std::uint32_t length) const {
+            return std::string_view(strings.data() + offset, length);
+        }
+        media_info info(const entry_record& e) const {
+            media_info m;
+            m.name = string(e.name_offset, e.name_length);
+            m.mime = string(e.mime_offset, e.mime_length);
+            m.size = e.size;
+            m.modification_time = std::chrono::time_point_cast<std::filesystem::file_time_type::duration>(
+                std::chrono::file_clock::from_sys(std::chrono::sys_time<std::chrono::nanoseconds>(std::chrono::nanoseconds(e.mtime_ns))));
+            m.width = e.width;
+            m.height = e.height;
+            m.duration = std::chrono::milliseconds(e.duration_ms);
+            if(e.taken != 0) {
+                m.taken = std::chrono::sys_seconds(std::chrono::seconds(e.taken));
+            }
+            m.is_directory = e.flags & flag_directory;
+            m.is_hidden = e.flags & flag_hidden;
+            m.is_symlink = e.flags & flag_symlink;
+            return m;
+        }
+        built_entry rebuild(const entry_record& e) const {
+            return {std::string(string(e.name_offset, e.name_length)), string(e.mime_offset, e.mime_length),
+                e.size, e.mtime_ns, e.taken, e.width, e.height, e.duration_ms, e.flags};
+        }
+    private:
+        index_file(void* data, std::size_t size) : data(data), size(size) {}
+
+        bool valid() {
+            const auto* h = static_cast<const header*>(data);
+            if(h->magic != magic || h->version != version) {
+                return false;
+            }
+            const std::size_t dirs_bytes = h->dir_count * sizeof(dir_record);
+            const std::size_t entries_bytes = h->entry_count * sizeof(entry_record);
+            if(h->dir_count > size || h->entry_count > size || h->strings_size > size ||
+                sizeof(header) + dirs_bytes + entries_bytes + h->strings_size != size)
+            {
+                return false;
+            }
+            const auto* base = static_cast<const char*>(data);
+            dirs = {reinterpret_cast<const dir_record*>(base + sizeof(header)), h->dir_count};
+            entries = {reinterpret_cast<const entry_record*>(base + sizeof(header) + dirs_bytes), h->entry_count};
+            strings = {base + sizeof(header) + dirs_bytes + entries_bytes, h->strings_size};
+            // Check every reference once, so lookups need no bounds checks.
+            auto in_strings = [&](std::uint64_t offset, std::uint64_t length) { return offset + length <= strings.size(); };
+            return std::ranges::all_of(dirs, [&](const dir_record& d) {
+                return in_strings(d.path_offset, d.path_length) && std::uint64_t{d.first_entry} + d.entry_count <= entries.size();
+            }) && std::ranges::all_of(entries, [&](const entry_record& e) {
+                return in_strings(e.name_offset, e.name_length) && in_strings(e.mime_offset, e.mime_length);
+            });
+        }
+
+        void* data;
+        std::size_t size;
+        std::span<const dir_record> dirs;
+        std::span<const entry_record> entries;
+        std::span<const char> strings;
+};
+
+namespace {
+    // Writes the index atomically, so a crash never leaves a torn file behind.
+    bool write_index(const std::filesystem::path& file, std::vector<built_dir>& dirs) {
+        std::ranges::sort(dirs, {}, &built_dir::path);
+
+        std::string strings;
+        std::unordered_map<std::string_view, std::uint32_t> mime_offsets;
+        auto add_string = [&strings](std::string_view s) {
+            auto offset = static_cast<std::uint32_t>(strings.size());
+            strings.append(s);
+            return offset;
+        };
+
+        std::vector<dir_record> dir_records;
+        std::vector<entry_record> entry_records;
+        dir_records.reserve(dirs.size());
+        for(auto& dir : dirs) {
+            std::ranges::sort(dir.entries, {}, &built_entry::name);
+            dir_records.push_back({add_string(dir.path), static_cast<std::uint32_t>(dir.path.size()),
+                static_cast<std::uint32_t>(entry_records.size()), static_cast<std::uint32_t>(dir.entries.size()), dir.mtime_ns});
+            for(const auto& e : dir.entries) {
+                auto [it, inserted] = mime_offsets.try_emplace(e.mime, 0);
+                if(inserted) {
+                    it->second = add_string(e.mime);
+                }
+                entry_records.push_back({add_string(e.name), static_cast<std::uint32_t>(e.name.size()),
+                    it->second, static_cast<std::uint32_t>(e.mime.size()),
+                    e.size, e.mtime_ns, e.taken, e.width, e.height, e.duration_ms, e.flags});
+            }
+        }
+        if(strings.size() > UINT32_MAX) {
+            spdlog::warn("Media library too large to index: {}", file.string());
+            return false;
+        }
+
+        try {
+            std::filesystem::create_directories(file.parent_path());
+            auto temp = file;
+            temp += std::format(".{}.tmp", ::getpid());
+            {
+                std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+                const header h{magic, version, dir_records.size(), entry_records.size(), strings.size()};
+                out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+                out.write(reinterpret_cast<const char*>(dir_records.data()), static_cast<std::streamsize>(dir_records.size() * sizeof(dir_record)));
+                out.write(reinterpret_cast<const char*>(entry_records.data()), static_cast<std::streamsize>(entry_records.size() * sizeof(entry_record)));
+                out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+                if(!out) {
+                    std::filesystem::remove(temp);
+                    return false;
+                }
+            }
+            std::filesystem::rename(temp, file);
+            return true;
+        } catch(const std::exception& e) {
+            spdlog::warn("Failed to write media library index {}: {}", file.string(), e.what());
+            return false;
+        }
+    }
+}
+
+media_library::media_library(const std::vector<std::filesystem::path>& paths) {
+    for(const auto& path : paths) {
+        std::error_code ec;
+        if(path.empty() || !std::filesystem::is_directory(path, ec)) {
+            continue;
+        }
+        auto canonical = std::filesystem::weakly_canonical(path, ec);
+        if(ec) {
+            canonical = path;
+        }
+        make_root(canonical);
+    }
+}
+
+media_library::~media_library() = default;
+
+std::shared_ptr<media_library::root> media_library::make_root(const std::filesystem::path& path, std::string_view identity) {
+    auto file = default_root() / (identity.empty() ? std::format("{:016x}.oxli", fnv1a(path.native())) :
+        std::format("volume-{:016x}.oxli", fnv1a(identity)));
+    auto r = std::make_shared<root>(path, file, index_file::open(file));
+    roots.push_back(r);
+    return r;
+}
+
+void media_library::add_root(const std::filesystem::path& path, std::string_view identity) {
+    if(std::ranges::any_of(roots, [&](const auto& r) { return r->path == path; })) {
+        return;
+    }
+    // The index of an earlier visit lists the device right away, the crawl freshens it
+    auto r = make_root(path, identity);
+    if(r->current) {
+        revision++;
+    }
+    crawl(r);
+}
+
+void media_library::remove_root(const std::filesystem::path& path) {
+    auto it = std::ranges::find_if(roots, [&](const auto& r) { return r->path == path; });
+    if(it == roots.end()) {
+        return;
+    }
+    (*it)->cancel.request_stop();
+    roots.erase(it);
+    revision++;
+}
+
+bool media_library::list(const std::filesystem::path& dir, const std::function<void(const media_info&)>& fn) const {
+    for(const auto& r : roots) {
+        const auto& root = *r;
+        if(!root.current) {
+            continue;
+        }
+        auto relative = dir.lexically_normal().lexically_relative(root.path);
+        if(relative.empty() || *relative.begin() == "..") {
+            continue;
+        }
+        if(relative == ".") {
+            relative.clear();
+        }
+        const auto* record = root.current->find_dir(relative.native());
+        if(!record) {
+            return false; // inside the root but not indexed (yet), e.g. a hidden directory
+        }
+        for(const auto& entry : root.current->entries_of(*record)) {
+            fn(root.current->info(entry));
+        }
+        return true;
+    }
+    return false;
+}
+
+media_library::snapshot media_library::files() const {
+    snapshot s;
+    for(const auto& r : roots) {
+        if(r->current) {
+            s.indexes.emplace_back(r->path, r->current);
+        }
+    }
+    return s;
+}
+
+void media_library::snapshot::for_each_file(const std::function<void(const std::filesystem::path&, const media_info&)>& fn) const {
+    for(const auto& [path, index] : indexes) {
+        for(const auto& dir : index->all_dirs()) {
+            const auto directory = dir.path_length ? path / index->string(dir.path_offset, dir.path_length) : path;
+            for(const auto& entry : index->entries_of(dir)) {
+                if(entry.flags & (flag_directory | flag_hidden)) {
+                    continue;
+                }
+                fn(directory, index->info(entry));
+            }
+        }
+    }
+}
+
+void media_library::refresh() {
+    for(const auto& r : roots) {
+        crawl(r);
+    }
+}
+
+void media_library::crawl(const std::shared_ptr<root>& r) {
+    if(r->refreshing) {
+        return;
+    }
+    r->refreshing = true;
+    crawls.submit([this, r, root = r->path, file = r->file, previous = r->current,
+        removed = r->cancel.get_token()](std::stop_token cancelled)
+    {
+        // Stops with the library, or when the root is removed (e.g. the device was unmounted)
+        std::stop_source stopping;
+        std::stop_callback on_cancel(cancelled, [&stopping] { stopping.request_stop(); });
+        std::stop_callback on_remove(removed, [&stopping] { stopping.request_stop(); });
+        auto stop = stopping.get_token();
+
+        auto start = std::chrono::steady_clock::now();
+        // FAT does not keep directory mtimes up to date (or at all), so an
+        // unchanged one proves nothing and every directory is listed again.
+        constexpr long msdos_magic = 0x4d44, exfat_magic = 0x2011bab0;
+        struct statfs fs{};
+        const bool dir_mtimes = ::statfs(root.c_str(), &fs) != 0 || (fs.f_type != msdos_magic && fs.f_type != exfat_magic);
+        std::size_t probed = 0, files = 0;
+        std::vector<built_dir> dirs;
+        std::vector<std::string> pending{""};
+        while(!pending.empty()) {
+            if(stop.stop_requested()) {
+                return;
+            }
+            auto relative = std::move(pending.back());
+            pending.pop_back();
+            const auto path = relative.empty() ? root : root / relative;
+
+            struct statx dir_stat{};
+            if(::statx(AT_FDCWD, path.c_str(), statx_flags, STATX_MTIME, &dir_stat) != 0) {
+                continue;
+            }
+            built_dir dir{relative, to_ns(dir_stat.stx_mtime), {}};
+            const dir_record* old = previous ? previous->find_dir(relative) : nullptr;
+            try {
+                directory_reader reader{path};
+                // A probe is only reused while the file's own size and mtime match
+                auto add = [&](const std::string& name, bool symlink) {
+                    struct statx stx{};
+                    if(::statx(reader.fd(), name.c_str(), statx_flags, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0) {
+                        return;
+                    }
+                    built_entry e;
+                    e.name = name;
+                    e.mtime_ns = to_ns(stx.stx_mtime);
+                    e.flags = (S_ISDIR(stx.stx_mode) ? flag_directory : 0) | (name.starts_with('.') ? flag_hidden : 0) |
+                        (symlink ? flag_symlink : 0);
+                    if(e.flags & flag_directory) {
+                        e.mime = mime::directory;
+                    } else {
+                        e.size = stx.stx_size;
+                        const entry_record* known = old ? previous->find_entry(*old, name) : nullptr;
+                        if(known && known->size == e.size && known->mtime_ns == e.mtime_ns) {
+                            e = previous->rebuild(*known);
+                        } else {
+                            e.mime = mime::from_name(name);
+                            if(e.mime.empty()) e.mime = mime::sniff_file(reader.fd(), name.c_str());
+                            if(e.mime.empty()) e.mime = mime::octet_stream;
+                            probe(path / name, reader.fd(), e, stop);
+                            probed++;
+                        }
+                    }
+                    dir.entries.push_back(std::move(e));
+                };
+                if(dir_mtimes && old && old->mtime_ns == dir.mtime_ns) {
+                    // Nothing was added, removed or renamed here since the last crawl,
+                    // so skip listing; files rewritten in place keep the directory
+                    // mtime though, and are still checked one by one.
+                    for(const auto& known : previous->entries_of(*old)) {
+                        if(stop.stop_requested()) {
+                            return;
+                        }
+                        add(std::string(previous->string(known.name_offset, known.name_length)), known.flags & flag_symlink);
+                    }
+                } else {
+                    for(auto records = reader.next(); !records.empty(); records = reader.next()) {
+                        for(const auto& record : records) {
+                            if(stop.stop_requested()) {
+                                return;
+                            }
+                            add(record.name, record.type == DT_LNK);
+                        }
+                    }
+                }
+            } catch(const std::exception& e) {
+                spdlog::debug("Error indexing {}: {}", path.string(), e.what());
+                continue;
+            }
+            for(const auto& e : dir.entries) {
+                // Symlinked directories could form loops, hidden ones are caches and the like
+                if((e.flags & flag_directory) && !(e.flags & (flag_symlink | flag_hidden))) {
+                    pending.push_back(relative.empty() ? e.name : relative + "/" + e.name);
+                }
+            }
+            files += dir.entries.size();
+            dirs.push_back(std::move(dir));
+        }
+
+        // The strings of reused entries still point into previous, which this job keeps mapped.
+        std::shared_ptr<const index_file> mapped;
+        if(write_index(file, dirs)) {
+            mapped = index_file::open(file);
+        }
+        spdlog::info("Indexed {} ({} entries, {} probed) in {} ms", root.string(), files, probed,
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+        crawls.post_main([this, r, mapped] {
+            r->refreshing = false;
+            if(mapped && !r->cancel.stop_requested()) {
+                r->current = mapped;
+                revision++;
+            }
+        }, stop);
+    });
+}
+
+}
@@ -0,0 +1,122 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+export module openxmb.app:media_library;
+
+import openxmb.jobs;
+
+export namespace menu {
+
+// Metadata of one indexed file. The strings point into the mapped index and
+// stay valid until the next refresh is swapped in on the main thread.
+struct media_info {
+    std::string_view name;
+    std::string_view mime;
+    std::uint64_t size = 0;
+    std::filesystem::file_time_type modification_time;
+    unsigned int width = 0; // 0 if unknown or not an image or video
+    unsigned int height = 0;
+    std::chrono::milliseconds duration{0};
+    std::optional<std::chrono::sys_seconds> taken; // EXIF DateTimeOriginal or container creation time
+    bool is_directory = false;
+    bool is_hidden = false;
+    bool is_symlink = false;
+};
+
+// Persistent index of the media libraries (Pictures, Music, Videos).
+//
+// Every root has a compact index file under $XDG_CACHE_HOME/openxmb/library
+// which is memory-mapped, so even libraries with hundreds of thousands of
+// items are available right after startup without a scan. refresh() crawls
+// the roots in a low priority job: directories whose mtime did not change
+// are taken over from the previous index without listing them, and only new
+// or changed files are probed for dimensions, duration and capture date.
+class media_library {
+    public:
+        explicit media_library(const std::vector<std::filesystem::path>& roots);
+        ~media_library();
+        media_library(const media_library&) = delete;
+        media_library& operator=(const media_library&) = delete;
+
+        // Calls fn for every entry of dir, sorted by name, and returns true if
+        // dir lies within an indexed root. Main thread only.
+        bool list(const std::filesystem::path& dir, const std::function<void(const media_info&)>& fn) const;
+
+        // Starts crawling every root that is not being crawled already.
+        void refresh();
+
+        // Indexes another root, e.g. a removable device, in the background.
+        // An index kept from an earlier visit is listed until the crawl is done.
+        // Indexes are kept by path, or by identity if given, so different
+        // volumes mounted at the same point do not share one.
+        void add_root(const std::filesystem::path& path, std::string_view identity = {});
+        // Drops a root added before and stops its crawl.
+        void remove_root(const std::filesystem::path& path);
+
+        // Bumped whenever a refreshed index replaces the previous one.
+        [[nodiscard]] std::uint64_t get_revision() const {
+            return revision;
+        }
+
+        // The indexes as they are now. The snapshot keeps them mapped, so it
+        // can be read on any thread while refreshes replace them.
+        class snapshot;
+        [[nodiscard]] snapshot files() const;
+    private:
+        class index_file;
+        struct root {
+            std::filesystem::path path;
+            std::filesystem::path file;
+            std::shared_ptr<const index_file> current; // null until the first crawl is done
+            bool refreshing = false;
+            std::stop_source cancel; // stopped when the root is removed
+        };
+        std::shared_ptr<root> make_root(const std::filesystem::path& path, std::string_view identity = {});
+        void crawl(const std::shared_ptr<root>& r);
+
+        // Crawls hold on to their root, so removing one never waits for I/O.
+        std::vector<std::shared_ptr<root>> roots;
+        std::uint64_t revision = 0;
+
+        jobs::group crawls{jobs::priority::low}; // last, so crawls stop before the roots go
+};
+
+class media_library::snapshot {
+    public:
+        // Calls fn for every indexed file that is neither a directory nor
+        // hidden, along with the directory containing it.
+        void for_each_file(const std::function<void(const std::filesystem::path&, const media_info&)>& fn) const;
+    private:
+        friend class media_library;
+        std::vector<std::pair<std::filesystem::path, std::shared_ptr<const index_file>>> indexes;
+};
+
+}
@@ -0,0 +1,270 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+module openxmb.app;
+
+import :crawler;
+import :files_menu;
+import :media_library;
+import :media_view;
+import :menu_base;
+import :removable_media;
+
+import openxmb.utils;
+import dreamrender;
+import spdlog;
+import i18n;
+
+namespace menu {
+    using namespace mfk::i18n::literals;
+
+    namespace {
+        dreamrender::texture load_icon(dreamrender::resource_loader& loader, const std::string& name) {
+            dreamrender::texture icon(loader.getDevice(), loader.getAllocator());
+            if(auto path = utils::resolve_icon_from_json(name)) {
+                try {
+                    loader.loadTexture(&icon, *path);
+                } catch(const std::exception& e) {
+                    spdlog::debug("Failed to load icon {}: {}", name, e.what());
+                }
+            }
+            return icon;
+        }
+
+        std::chrono::year_month month_of(const file_info& info) {
+            // When a photo or video was taken if the library knows, otherwise when it was last written
+            auto date = info.taken ? *info.taken : std::chrono::time_point_cast<std::chrono::seconds>(
+                std::chrono::file_clock::to_sys(info.modification_time));
+            std::chrono::year_month_day day{std::chrono::floor<std::chrono::days>(date)};
+            return day.year() / day.month();
+        }
+    }
+
+    media_view::media_view(std::string name, dreamrender::texture&& icon, app::shell* xmb, std::filesystem::path root,
+        std::string mime_prefix, dreamrender::resource_loader& loader)
+    : simple_menu(std::move(name), std::move(icon)), xmb(xmb), root(std::move(root)), mime_prefix(std::move(mime_prefix)), loader(loader)
+    {
+        entries.push_back(std::make_unique<files_menu>("Folders"_(), load_icon(loader, "inode/directory"),
+            xmb, this->root, loader));
+    }
+
+    media_view::~media_view() {
+        crawl_stop.request_stop();
+    }
+
+    void media_view::on_open() {
+        simple_menu::on_open();
+        if(!crawl_state && (!last_crawl || std::chrono::steady_clock::now() - *last_crawl >= recrawl_interval)) {
+            start_crawl();
+        }
+    }
+
+    void media_view::start_crawl() {
+        crawl_state = std::make_shared<crawl_results>();
+        crawled.clear();
+        live = groups.empty();
+        last_crawl = std::chrono::steady_clock::now();
+
+        crawl_options options;
+        options.accept = [prefix = mime_prefix](std::string_view mime) { return mime.starts_with(prefix); };
+        // The crawl only holds the results, so it can outlive the menu until it notices the stop
+        crawl(root, std::move(options),
+            [state = crawl_state](std::vector<crawled_file>&& files) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                std::move(files.begin(), files.end(), std::back_inserter(state->pending));
+                state->has_pending = true;
+            },
+            [state = crawl_state]() {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->complete = true;
+                state->has_pending = true;
+            },
+            crawl_stop.get_token());
+    }
+
+    void media_view::show_removable_media() {
+        devices.emplace([this](const removable_device& device) -> std::unique_ptr<menu_entry> {
+            return std::make_unique<media_view>(device.label, load_icon(loader, "drive-removable-media"),
+                xmb, device.point, mime_prefix, loader);
+        });
+    }
+
+    void media_view::update() {
+        if(devices) {
+            menu_entry* selected = selected_submenu < entries.size() ? entries[selected_submenu].get() : nullptr;
+            if(devices->update(xmb->get_removable_media(), entries, 1) != 0) {
+                reselect(selected);
+            }
+            // The devices are media views of their own
+            for(std::size_t i = 1; i < 1 + devices->size(); i++) {
+                if(auto* device = dynamic_cast<menu*>(entries[i].get())) {
+                    device->update();
+                }
+            }
+        }
+        if(crawl_state && crawl_state->has_pending.load()) {
+            // Regrouping is cheap but not free, so batches are applied a few times a second
+            auto now = std::chrono::steady_clock::now();
+            if(now - last_apply >= apply_interval) {
+                last_apply = now;
+                apply_pending();
+            }
+        }
+    }
+
+    file_info media_view::make_info(const crawled_file& file,
+        const std::function<const file_info*(std::string_view)>& library) const
+    {
+        file_info info;
+        info.name = file.relative_path;
+        info.display_name = std::filesystem::path(file.relative_path).filename().string();
+        info.content_type = file.mime;
+        info.sort_key = utils::natural_sort_key(info.display_name);
+        info.size = file.size;
+        info.is_directory = false;
+        info.is_hidden = false;
+        info.is_symlink = false;
+        info.modification_time = file.modification_time;
+        info.has_stat = true;
+        if(const auto* indexed = library(file.relative_path)) {
+            info.width = indexed->width;
+            info.height = indexed->height;
+            info.duration = indexed->duration;
+            info.taken = indexed->taken;
+        }
+        return info;
+    }
+
+    void media_view::apply_pending() {
+        std::vector<crawled_file> batch;
+        bool complete = false;
+        {
+            std::lock_guard<std::mutex> lock(crawl_state->mutex);
+            batch.swap(crawl_state->pending);
+            complete = crawl_state->complete;
+            crawl_state->has_pending = false;
+        }
+
+        // Capture dates come from the media library, listed once per directory
+        auto& library = xmb->get_media_library();
+        std::unordered_map<std::string, std::unordered_map<std::string, file_info>> indexed;
+        auto lookup = [&](std::string_view relative) -> const file_info* {
+            const auto slash = relative.rfind('/');
+            const std::string dir{slash == std::string_view::npos ? std::string_view{} : relative.substr(0, slash)};
+            auto [it, inserted] = indexed.try_emplace(dir);
+            if(inserted) {
+                library.list(dir.empty() ? root : root / dir, [&files = it->second](const media_info& info) {
+                    files.emplace(std::string(info.name), file_info(info));
+                });
+            }
+            auto file = it->second.find(std::string(relative.substr(slash + 1)));
+            return file != it->second.end() ? &file->second : nullptr;
+        };
+
+        // A live crawl only hands the new files of each month to its group
+        std::map<std::chrono::year_month, std::vector<file_info>, std::greater<>> added;
+        auto& into = live ? added : crawled;
+        for(const auto& file : batch) {
+            auto info = make_info(file, lookup);
+            into[month_of(info)].push_back(std::move(info));
+        }
+
+        menu_entry* selected = selected_submenu < entries.size() ? entries[selected_submenu].get() : nullptr;
+        for(auto& [month, files] : added) {
+            add_to_group(month, std::move(files));
+        }
+        if(complete) {
+            if(!live) {
+                // Months without files any more go, the rest is replaced at once
+                std::vector<std::chrono::year_month> gone;
+                for(const auto& [month, group] : groups) {
+                    if(!crawled.contains(month)) gone.push_back(month);
+                }
+                for(auto month : gone) {
+                    retire_group(month);
+                }
+                for(auto& [month, files] : crawled) {
+                    update_group(month, std::move(files));
+                }
+            }
+            spdlog::debug("Crawled {} for {}: {} months", root.string(), mime_prefix, groups.size());
+            crawled.clear();
+            crawl_state.reset();
+        }
+
+        reselect(selected);
+    }
+
+    void media_view::reselect(const menu_entry* selected) {
+        // Stay on the selected entry while others are inserted before it
+        if(auto it = std::ranges::find_if(entries, [selected](const auto& e) { return e.get() == selected; }); it != entries.end()) {
+            selected_submenu = it - entries.begin();
+        } else if(selected_submenu >= entries.size()) {
+            selected_submenu = entries.size() - 1;
+        }
+        invalidate();
+    }
+
+    void media_view::update_group(std::chrono::year_month month, std::vector<file_info> files) {
+        if(auto it = groups.find(month); it != groups.end()) {
+            it->second->set_files(std::move(files));
+            return;
+        }
+        auto group = std::make_unique<files_menu>(std::format("{:%B %Y}", month), load_icon(loader, "inode/directory"),
+            xmb, root, std::move(files), loader);
+        auto [it, inserted] = groups.emplace(month, group.get());
+        // After "Folders" and the devices, in the same order as the map
+        const auto first = 1 + (devices ? devices->size() : 0);
+        entries.insert(entries.begin() + first + std::distance(groups.begin(), it), std::move(group));
+    }
+
+    void media_view::add_to_group(std::chrono::year_month month, std::vector<file_info> files) {
+        if(auto it = groups.find(month); it != groups.end()) {
+            it->second->add_files(std::move(files));
+        } else {
+            update_group(month, std::move(files));
+        }
+    }
+
+    void media_view::retire_group(std::chrono::year_month month) {
+        auto it = groups.find(month);
+        auto entry = std::ranges::find_if(entries, [group = it->second](const auto& e) { return e.get() == group; });
+        retired.push_back(std::move(*entry));
+        entries.erase(entry);
+        groups.erase(it);
+    }
+
+}
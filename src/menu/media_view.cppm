@@ -0,0 +1,107 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+export module openxmb.app:media_view;
+
+import dreamrender;
+import :crawler;
+import :files_menu;
+import :menu_base;
+import :removable_media;
+
+namespace app {
+    class shell;
+}
+
+export namespace menu {
+
+// A media category as one library: every file of the category's type below
+// root, grouped by month with the newest first, after a "Folders" entry
+// holding the usual directory view (and the removable devices, if shown).
+//
+// The tree is crawled in parallel the first time the category is opened.
+// Months appear and fill while the first crawl runs; later crawls replace
+// the groups once they are complete. Groups are updated in place, so an open
+// group stays valid while results arrive.
+class media_view : public simple_menu {
+    public:
+        media_view(std::string name, dreamrender::texture&& icon, app::shell* xmb, std::filesystem::path root,
+            std::string mime_prefix, dreamrender::resource_loader& loader);
+        ~media_view() override;
+
+        void on_open() override;
+        void update() override;
+
+        // Lists the mounted USB drives and SD cards after "Folders", each as a
+        // media_view of its own, see main_menu.
+        void show_removable_media();
+    private:
+        void start_crawl();
+        void apply_pending();
+        file_info make_info(const crawled_file& file, const std::function<const file_info*(std::string_view)>& library) const;
+        void update_group(std::chrono::year_month month, std::vector<file_info> files);
+        void add_to_group(std::chrono::year_month month, std::vector<file_info> files);
+        void retire_group(std::chrono::year_month month);
+        void reselect(const menu_entry* selected); // after entries were inserted or removed
+
+        app::shell* xmb;
+        std::filesystem::path root;
+        std::string mime_prefix;
+        dreamrender::resource_loader& loader;
+
+        struct crawl_results {
+            std::mutex mutex;
+            std::vector<crawled_file> pending;
+            bool complete = false;
+            std::atomic<bool> has_pending{false};
+        };
+        std::shared_ptr<crawl_results> crawl_state;
+        std::stop_source crawl_stop;
+        bool live = false; // whether the running crawl updates the groups as it goes
+        std::optional<std::chrono::steady_clock::time_point> last_crawl;
+        std::chrono::steady_clock::time_point last_apply;
+        static constexpr auto apply_interval = std::chrono::milliseconds(250);
+        static constexpr auto recrawl_interval = std::chrono::minutes(5);
+
+        // Files of a crawl that replaces the groups once complete, by month,
+        // and the groups showing them. A live crawl hands each batch straight
+        // to its groups instead. Retired groups stay alive, main_menu may
+        // still hold one.
+        std::map<std::chrono::year_month, std::vector<file_info>, std::greater<>> crawled;
+        std::map<std::chrono::year_month, files_menu*, std::greater<>> groups;
+        std::vector<std::unique_ptr<menu_entry>> retired;
+        // Between "Folders" and the groups
+        std::optional<device_entries> devices;
+};
+
+}
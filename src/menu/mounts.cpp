@@ -0,0 +1,234 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+module openxmb.app;
+
+import :mounts;
+
+import openxmb.jobs;
+import spdlog;
+
+namespace menu {
+
+namespace {
+    // mountinfo escapes space, tab, newline and backslash as \ooo.
+    std::string unescape(std::string_view s) {
+        std::string out;
+        out.reserve(s.size());
+        for(std::size_t i = 0; i < s.size(); i++) {
+            const bool octal = i + 3 < s.size() &&
+                std::ranges::all_of(s.substr(i + 1, 3), [](char c) { return c >= '0' && c <= '7'; });
+            if(s[i] == '\\' && octal) {
+                out.push_back(static_cast<char>((s[i + 1] - '0') * 64 + (s[i + 2] - '0') * 8 + (s[i + 3] - '0')));
+                i += 3;
+            } else {
+                out.push_back(s[i]);
+            }
+        }
+        return out;
+    }
+}
+
+bool mount_entry::remote() const {
+    static constexpr std::array<std::string_view, 12> network{
+        "nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "afs", "ceph", "glusterfs", "lustre", "davfs", "ncpfs",
+    };
+    // FUSE mounts show up as "fuse.<daemon>"; fuseblk (ntfs-3g, exfat-fuse)
+    // and daemons like gocryptfs or mergerfs are backed by a local disk.
+    static constexpr std::array<std::string_view, 14> network_fuse{
+        "sshfs", "rclone", "gvfsd-fuse", "s3fs", "gcsfuse", "goofys", "blobfuse", "blobfuse2", "curlftpfs",
+        "smbnetfs", "davfs2", "glusterfs", "google-drive-ocamlfuse", "onedriver",
+    };
+    if(type.starts_with("fuse.")) {
+        return std::ranges::find(network_fuse, std::string_view(type).substr(5)) != network_fuse.end();
+    }
+    return std::ranges::find(network, type) != network.end();
+}
+
+std::vector<mount_entry> read_mounts() {
+    std::vector<mount_entry> mounts;
+    std::ifstream in("/proc/self/mountinfo");
+    std::string line;
+    while(std::getline(in, line)) {
+        // id parent major:minor root mount-point options [optional fields...] - type source super-options
+        std::istringstream fields(line);
+        mount_entry m;
+        std::string parent, device, root, point, field;
+        if(!(fields >> m.id >> parent >> device >> root >> point)) {
+            continue;
+        }
+        while(fields >> field && field != "-") {}
+        if(!(fields >> m.type >> m.source)) {
+            continue;
+        }
+        m.point = unescape(point);
+        m.source = unescape(m.source);
+        mounts.push_back(std::move(m));
+    }
+    return mounts;
+}
+
+std::optional<mount_entry> find_mount(const std::vector<mount_entry>& mounts, const std::filesystem::path& path) {
+    const auto p = path.lexically_normal();
+    const mount_entry* best = nullptr;
+    std::size_t best_length = 0;
+    for(const auto& m : mounts) {
+        auto [mi, pi] = std::mismatch(m.point.begin(), m.point.end(), p.begin(), p.end());
+        const auto length = m.point.native().size();
+        // Later lines are mounted on top of earlier ones at the same point
+        if(mi == m.point.end() && (!best || length >= best_length)) {
+            best = &m;
+            best_length = length;
+        }
+    }
+    return best ? std::optional{*best} : std::nullopt;
+}
+
+struct io_lanes::lane {
+    std::mutex mutex;
+    std::condition_variable_any wake;
+    std::deque<std::pair<jobs::job, std::stop_token>> tasks;
+    std::stop_source stop;
+
+    // Detached, so exiting never waits for a call stuck on a dead server;
+    // the thread only holds the lane.
+    static void run(std::shared_ptr<lane> l) {
+        while(true) {
+            std::unique_lock<std::mutex> lock(l->mutex);
+            l->wake.wait(lock, l->stop.get_token(), [&l] { return !l->tasks.empty(); });
+            if(l->stop.stop_requested()) {
+                return;
+            }
+            auto [fn, token] = std::move(l->tasks.front());
+            l->tasks.pop_front();
+            lock.unlock();
+            if(token.stop_requested()) {
+                continue;
+            }
+            try {
+                fn(token);
+            } catch(const std::exception& e) {
+                spdlog::error("Unhandled exception in I/O job: {}", e.what());
+            }
+        }
+    }
+};
+
+io_lanes& io_lanes::instance() {
+    static io_lanes lanes;
+    return lanes;
+}
+
+io_lanes::~io_lanes() {
+    for(auto& [id, l] : lanes) {
+        l->stop.request_stop();
+    }
+}
+
+std::vector<mount_entry> io_lanes::mounts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if(!table_valid || now - table_time >= table_lifetime) {
+        table = read_mounts();
+        table_time = now;
+        table_valid = true;
+        // Threads of mounts that are gone finish their current job and exit
+        std::erase_if(lanes, [this](const auto& entry) {
+            if(std::ranges::any_of(table, [&entry](const mount_entry& m) { return m.id == entry.first; })) {
+                return false;
+            }
+            entry.second->stop.request_stop();
+            return true;
+        });
+    }
+    return table;
+}
+
+void io_lanes::invalidate_mounts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    table_valid = false;
+}
+
+void io_lanes::abandon(const std::filesystem::path& path) {
+    const auto mount = find_mount(mounts(), path);
+    if(!mount) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = lanes.find(mount->id);
+    if(it == lanes.end()) {
+        return; // not a remote mount, its jobs run on the pool
+    }
+    auto fresh = std::make_shared<lane>();
+    {
+        std::lock_guard<std::mutex> old_lock(it->second->mutex);
+        fresh->tasks = std::exchange(it->second->tasks, {});
+        it->second->stop.request_stop();
+    }
+    it->second = fresh;
+    std::thread(lane::run, fresh).detach();
+    spdlog::warn("I/O on {} is stuck, moving its jobs to a new thread", mount->point.string());
+}
+
+void io_lanes::submit(const std::filesystem::path& path, jobs::job fn, std::stop_token token, jobs::priority p) {
+    const auto mount = find_mount(mounts(), path);
+    std::shared_ptr<lane> l;
+    if(mount && mount->remote()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& slot = lanes[mount->id];
+        if(!slot) {
+            slot = std::make_shared<lane>();
+            std::thread(lane::run, slot).detach();
+            spdlog::info("Using a dedicated I/O thread for {} ({})", mount->point.string(), mount->type);
+        }
+        l = slot;
+    }
+    if(!l) {
+        jobs::scheduler::instance().submit(std::move(fn), std::move(token), p);
+        return;
+    }
+    // One job at a time per mount, in order; priorities only matter on the pool
+    {
+        std::lock_guard<std::mutex> lock(l->mutex);
+        l->tasks.emplace_back(std::move(fn), std::move(token));
+    }
+    l->wake.notify_one();
+}
+
+}
@@ -0,0 +1,96 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+export module openxmb.app:mounts;
+
+import openxmb.jobs;
+
+export namespace menu {
+
+// One line of /proc/self/mountinfo.
+struct mount_entry {
+    int id = 0;
+    std::filesystem::path point;
+    std::string type;   // e.g. "ext4", "nfs4", "fuse.sshfs"
+    std::string source; // e.g. "/dev/sdb1", "server:/export"
+    // Network file systems, including FUSE daemons talking to a server,
+    // whose calls may block for as long as the server does not answer.
+    [[nodiscard]] bool remote() const;
+};
+
+// Parses /proc/self/mountinfo; empty if it cannot be read.
+std::vector<mount_entry> read_mounts();
+
+// The mount that path lies on, by the longest matching mount point. Purely
+// lexical, so it never touches (and never blocks on) the file system.
+std::optional<mount_entry> find_mount(const std::vector<mount_entry>& mounts, const std::filesystem::path& path);
+
+// Routes file system work by mount.
+//
+// Work on local file systems runs on the shared scheduler. Each remote mount
+// gets one thread of its own instead, so a stalled NFS server or hung FUSE
+// daemon only blocks the jobs for that mount while the pool stays free.
+// Owners detect a stall by the lack of progress, see files_menu, and call
+// abandon() so their retry does not queue up behind the stuck call.
+class io_lanes {
+    public:
+        static io_lanes& instance();
+
+        io_lanes() = default;
+        ~io_lanes();
+        io_lanes(const io_lanes&) = delete;
+        io_lanes& operator=(const io_lanes&) = delete;
+
+        // Runs fn for I/O below path, unless token is stopped before it starts.
+        void submit(const std::filesystem::path& path, jobs::job fn, std::stop_token token = {},
+            jobs::priority p = jobs::priority::normal);
+
+        // Gives the mount of path a fresh thread and moves the jobs still
+        // queued there over. The old thread exits once its stuck call
+        // returns, if it ever does.
+        void abandon(const std::filesystem::path& path);
+
+        // The current mount table, read again when it may have changed.
+        std::vector<mount_entry> mounts();
+        // Called when the mount table changed, e.g. by a mountinfo watch.
+        void invalidate_mounts();
+    private:
+        struct lane;
+        std::mutex mutex;
+        std::vector<mount_entry> table;
+        std::chrono::steady_clock::time_point table_time;
+        bool table_valid = false;
+        std::map<int, std::shared_ptr<lane>> lanes; // by mount id
+
+        // Without a watch the table is read again after this long.
+        static constexpr auto table_lifetime = std::chrono::seconds(2);
+};
+
+}
@@ -0,0 +1,234 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+module openxmb.app;
+
+import :media_library;
+import :menu_base;
+import :mounts;
+import :removable_media;
+
+import openxmb.jobs;
+import openxmb.utils;
+import spdlog;
+
+namespace menu {
+
+namespace {
+    // Whether the block device behind a mount is a USB drive or a memory card.
+    // Desktops mount those below /media or /run/media; otherwise the disk has
+    // to be marked removable, sit on a USB bus or be an SD card.
+    bool is_removable(const mount_entry& m) {
+        if(!m.source.starts_with("/dev/")) {
+            return false;
+        }
+        const auto& point = m.point.native();
+        if(point.starts_with("/media/") || point.starts_with("/run/media/")) {
+            return true;
+        }
+        std::error_code ec;
+        const auto device = std::filesystem::canonical(m.source, ec);
+        if(ec) {
+            return false;
+        }
+        // Partitions live below their disk, which has the "removable" attribute
+        auto sys = std::filesystem::canonical(std::filesystem::path("/sys/class/block") / device.filename(), ec);
+        if(ec) {
+            return false;
+        }
+        if(sys.native().find("/usb") != std::string::npos) {
+            return true;
+        }
+        for(auto disk = sys; disk.has_relative_path() && disk.filename() != "block"; disk = disk.parent_path()) {
+            std::ifstream removable(disk / "removable");
+            char c = 0;
+            if(!(removable >> c)) {
+                continue;
+            }
+            std::ifstream type(disk / "device" / "type"); // "SD" or "MMC" for eMMC, which is built in
+            std::string t;
+            return c == '1' || (type >> t && t == "SD");
+        }
+        return false;
+    }
+
+    std::string volume_identity(const mount_entry& m) {
+        std::error_code ec;
+        const auto device = std::filesystem::canonical(m.source, ec);
+        if(!ec) {
+            for(const auto& link : std::filesystem::directory_iterator("/dev/disk/by-uuid", ec)) {
+                if(std::filesystem::equivalent(link.path(), device, ec)) {
+                    return "uuid:" + link.path().filename().string();
+                }
+            }
+        }
+        struct statfs fs{};
+        if(::statfs(m.point.c_str(), &fs) == 0) {
+            return std::format("fsid:{:08x}{:08x}:{}", static_cast<unsigned int>(fs.f_fsid.__val[0]),
+                static_cast<unsigned int>(fs.f_fsid.__val[1]), m.source);
+        }
+        return "source:" + m.source;
+    }
+
+    std::vector<removable_device> scan_devices() {
+        std::vector<removable_device> found;
+        for(const auto& m : read_mounts()) {
+            if(is_removable(m) && std::ranges::none_of(found, [&](const auto& d) { return d.point == m.point; })) {
+                found.push_back({m.point, m.point.filename().string(), volume_identity(m)});
+            }
+        }
+        std::ranges::sort(found, {}, &removable_device::point);
+        return found;
+    }
+
+    // A different volume at the same point (swapped between two scans) counts as gone and new
+    bool same_device(const removable_device& a, const removable_device& b) {
+        return a.point == b.point && a.identity == b.identity;
+    }
+}
+
+removable_media::removable_media(media_library& library) : library(library) {
+    mountinfo = utils::unique_fd(::open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC));
+    epoll = utils::unique_fd(::epoll_create1(EPOLL_CLOEXEC));
+    if(mountinfo && epoll) {
+        epoll_event event{};
+        event.events = EPOLLPRI | EPOLLERR;
+        if(::epoll_ctl(epoll.get(), EPOLL_CTL_ADD, mountinfo.get(), &event) != 0) {
+            spdlog::warn("Cannot watch the mount table, removable media will not be detected");
+            epoll.reset();
+        }
+    }
+    rescan();
+}
+
+removable_media::~removable_media() = default;
+
+void removable_media::poll() {
+    if(!epoll) {
+        return;
+    }
+    std::array<epoll_event, 1> events{};
+    if(::epoll_wait(epoll.get(), events.data(), events.size(), 0) <= 0) {
+        return;
+    }
+    rescan();
+}
+
+void removable_media::rescan() {
+    if(scan_running) {
+        scan_pending = true;
+        return;
+    }
+    if(mountinfo) {
+        // Reading the watched file to its end is what rearms POLLPRI
+        std::array<char, 4096> discard{};
+        ::lseek(mountinfo.get(), 0, SEEK_SET);
+        while(::read(mountinfo.get(), discard.data(), discard.size()) > 0) {}
+    }
+
+    io_lanes::instance().invalidate_mounts();
+
+    scan_running = true;
+    scanning.submit([this](std::stop_token stop) {
+        auto found = scan_devices();
+        scanning.post_main([this, found = std::move(found)]() mutable {
+            scan_running = false;
+            apply(std::move(found));
+            if(scan_pending) {
+                scan_pending = false;
+                rescan();
+            }
+        }, stop);
+    });
+}
+
+void removable_media::apply(std::vector<removable_device> found) {
+    bool changed = false;
+    for(const auto& d : current) {
+        if(std::ranges::none_of(found, [&](const auto& f) { return same_device(f, d); })) {
+            spdlog::info("Removable media at {} is gone", d.point.string());
+            library.remove_root(d.point);
+            changed = true;
+        }
+    }
+    for(const auto& d : found) {
+        if(std::ranges::none_of(current, [&](const auto& c) { return same_device(c, d); })) {
+            spdlog::info("Removable media mounted at {}", d.point.string());
+            library.add_root(d.point, d.identity);
+            changed = true;
+        }
+    }
+    if(changed) {
+        current = std::move(found);
+        revision++;
+    }
+}
+
+int device_entries::update(const removable_media& media, std::vector<std::unique_ptr<menu_entry>>& entries, std::size_t first) {
+    if(media.get_revision() == revision) {
+        return 0;
+    }
+    revision = media.get_revision();
+
+    const auto old_size = shown.size();
+    std::vector<std::unique_ptr<menu_entry>> old(std::make_move_iterator(entries.begin() + first),
+        std::make_move_iterator(entries.begin() + first + old_size));
+    entries.erase(entries.begin() + first, entries.begin() + first + old_size);
+
+    std::vector<std::unique_ptr<menu_entry>> updated;
+    for(const auto& device : media.devices()) {
+        auto it = std::ranges::find_if(shown, [&](const auto& d) { return same_device(d, device); });
+        if(it != shown.end()) {
+            updated.push_back(std::move(old[it - shown.begin()]));
+        } else {
+            updated.push_back(make(device));
+        }
+    }
+    for(auto& entry : old) {
+        if(entry) {
+            retired.push_back(std::move(entry));
+        }
+    }
+    entries.insert(entries.begin() + first, std::make_move_iterator(updated.begin()), std::make_move_iterator(updated.end()));
+    shown = media.devices();
+    return static_cast<int>(shown.size()) - static_cast<int>(old_size);
+}
+
+}
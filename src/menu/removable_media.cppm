@@ -0,0 +1,110 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+export module openxmb.app:removable_media;
+
+import openxmb.jobs;
+import openxmb.utils;
+import :media_library;
+import :menu_base;
+
+export namespace menu {
+
+struct removable_device {
+    std::filesystem::path point;
+    std::string label; // the last component of the mount point, usually the volume label
+    // Tells apart different volumes mounted at the same point: the file
+    // system UUID, or its fsid and device node if it has none.
+    std::string identity;
+};
+
+// Watches /proc/self/mountinfo for USB drives and SD cards.
+//
+// The kernel flags the file with POLLPRI whenever the mount table changes, so
+// poll() only reads it then. Telling which mounts are removable touches sysfs
+// and /dev/disk, so that scan runs in a job and its result is applied on the
+// main thread. Every device found is added to the media library, which indexes
+// it in a low priority job; unmounting removes it again, which also stops its
+// crawl.
+class removable_media {
+    public:
+        explicit removable_media(media_library& library);
+        ~removable_media();
+        removable_media(const removable_media&) = delete;
+        removable_media& operator=(const removable_media&) = delete;
+
+        // Starts a scan when the mount table changed, and applies finished
+        // scans. Never blocks. Main thread only.
+        void poll();
+
+        [[nodiscard]] const std::vector<removable_device>& devices() const {
+            return current;
+        }
+        // Bumped whenever a device appears or goes.
+        [[nodiscard]] std::uint64_t get_revision() const {
+            return revision;
+        }
+    private:
+        void rescan();
+        void apply(std::vector<removable_device> found);
+
+        media_library& library;
+        utils::unique_fd mountinfo;
+        utils::unique_fd epoll;
+        std::vector<removable_device> current;
+        std::uint64_t revision = 0;
+        bool scan_running = false;
+        bool scan_pending = false; // the table changed again while scanning
+        jobs::group scanning{jobs::priority::high}; // last, so the scan stops before the rest goes
+};
+
+// The entries a category shows for the removable devices, see main_menu.
+// update() keeps them at entries[first, first + size()), reusing the entries of
+// devices that stay: same mount point and same volume, as a swapped card must
+// not keep the old card's entry. Entries of devices that went are kept alive,
+// as main_menu may still hold them.
+class device_entries {
+    public:
+        using factory = std::function<std::unique_ptr<menu_entry>(const removable_device&)>;
+
+        explicit device_entries(factory make) : make(std::move(make)) {}
+
+        // Returns by how much the number of entries changed.
+        int update(const removable_media& media, std::vector<std::unique_ptr<menu_entry>>& entries, std::size_t first);
+        [[nodiscard]] std::size_t size() const {
+            return shown.size();
+        }
+    private:
+        factory make;
+        std::uint64_t revision = 0;
+        std::vector<removable_device> shown; // of the entries, in order
+        std::vector<std::unique_ptr<menu_entry>> retired;
+};
+
+}
@@ -0,0 +1,307 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+module openxmb.app;
+
+import :search_index;
+
+import openxmb.jobs;
+import openxmb.utils;
+import spdlog;
+
+namespace menu {
+
+namespace {
+    // Separates the name from the detail in the indexed text; never typed,
+    // so no query matches across it.
+    constexpr char detail_separator = '\n';
+
+    // Folded like utils::folded_names, so keys agree with its search.
+    std::string folded(std::string_view s) {
+        std::string out(s.size(), '\0');
+        std::ranges::transform(s, out.begin(), [](char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        });
+        return out;
+    }
+
+    // Keys of the postings: trigrams anywhere in the text use the low 24
+    // bits, the first one or two characters of a word are tagged above them.
+    constexpr std::uint32_t word_start_tag = 1u << 31;
+
+    std::uint32_t key(std::string_view s) {
+        std::uint32_t k = 0;
+        for(std::size_t i = 0; i < s.size(); i++) {
+            k |= static_cast<std::uint32_t>(static_cast<std::uint8_t>(s[i])) << (8 * i);
+        }
+        return s.size() == 3 ? k : k | word_start_tag | static_cast<std::uint32_t>(s.size()) << 24;
+    }
+
+    bool is_word_start(std::string_view text, std::size_t i) {
+        auto alnum = [](char c) {
+            return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || static_cast<std::uint8_t>(c) >= 0x80;
+        };
+        return alnum(text[i]) && (i == 0 || !alnum(text[i - 1]));
+    }
+
+    // Calls fn for the key of every trigram of text that does not span the
+    // separator, and of the first one and two characters of every word.
+    template<typename F>
+    void for_each_key(std::string_view text, F&& fn) {
+        for(std::size_t i = 0; i < text.size(); i++) {
+            const auto rest = text.substr(i, 3);
+            const auto end = rest.find(detail_separator);
+            if(is_word_start(text, i)) {
+                fn(key(rest.substr(0, 1)));
+                if(end > 1 && rest.size() > 1) {
+                    fn(key(rest.substr(0, 2)));
+                }
+            }
+            if(end == std::string_view::npos && rest.size() == 3) {
+                fn(key(rest));
+            }
+        }
+    }
+}
+
+struct search_index::segment {
+    std::vector<search_item> items;
+    // Per item its name, then the separator and the detail if that is searched.
+    utils::folded_names text;
+    // Postings: the items holding keys[k] are ids[offsets[k], offsets[k+1]).
+    std::vector<std::uint32_t> keys; // ascending
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> ids; // ascending per key
+
+    std::span<const std::uint32_t> postings(std::uint32_t k) const {
+        auto it = std::ranges::lower_bound(keys, k);
+        if(it == keys.end() || *it != k) {
+            return {};
+        }
+        const auto i = static_cast<std::size_t>(it - keys.begin());
+        return std::span(ids).subspan(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    // Ids of the matching items, ascending, for a folded query: items whose
+    // text contains it, or for one or two characters, that have a word
+    // starting with it. Those would match nearly everything anywhere.
+    std::vector<std::uint32_t> matches(std::string_view query) const {
+        if(query.size() < 3) {
+            auto list = postings(key(query));
+            return {list.begin(), list.end()};
+        }
+        std::vector<std::span<const std::uint32_t>> lists;
+        for(std::size_t i = 0; i + 3 <= query.size(); i++) {
+            auto list = postings(key(query.substr(i, 3)));
+            if(list.empty()) {
+                return {};
+            }
+            lists.push_back(list);
+        }
+        std::ranges::sort(lists, {}, &std::span<const std::uint32_t>::size);
+
+        // Holding every trigram does not mean holding them in order, the
+        // few candidates left are checked by a real search
+        std::vector<std::uint32_t> candidates(lists.front().begin(), lists.front().end());
+        for(std::size_t k = 1; k < lists.size() && !candidates.empty(); k++) {
+            // Galloping: the candidates are ascending and the lists long
+            std::erase_if(candidates, [list = lists[k], from = lists[k].begin()](std::uint32_t id) mutable {
+                auto to = from;
+                for(std::ptrdiff_t step = 1; to != list.end() && *to < id; step *= 2) {
+                    from = to;
+                    to = list.end() - to > step ? to + step : list.end();
+                }
+                from = std::lower_bound(from, to, id);
+                return from == list.end() || *from != id;
+            });
+        }
+        return text.find(query, candidates);
+    }
+};
+
+search_index::~search_index() = default;
+
+std::shared_ptr<const search_index::segment> search_index::build(std::vector<search_item> items) {
+    auto s = std::make_shared<segment>();
+    s->items = std::move(items);
+
+    std::size_t bytes = 0;
+    for(const auto& item : s->items) {
+        bytes += item.name.size() + 1 + (item.type == search_item::kind::media ? 0 : item.detail.size());
+    }
+    s->text.reserve(s->items.size(), bytes);
+    std::string joined;
+    for(const auto& item : s->items) {
+        if(item.type == search_item::kind::media || item.detail.empty()) {
+            s->text.add(item.name);
+            continue;
+        }
+        joined.assign(item.name);
+        joined += detail_separator;
+        joined += item.detail;
+        s->text.add(joined);
+    }
+
+    // Count first, so the postings are laid out in one array. Going through
+    // the items in order keeps every list ascending, and an item holding a
+    // key twice is the last one on its list.
+    std::unordered_map<std::uint32_t, std::uint32_t> slots;
+    std::vector<std::uint32_t> last_id;
+    for(std::uint32_t id = 0; id < s->items.size(); id++) {
+        for_each_key(s->text[id], [&](std::uint32_t t) {
+            auto [it, inserted] = slots.try_emplace(t, static_cast<std::uint32_t>(last_id.size()));
+            if(inserted) {
+                last_id.push_back(id);
+                s->offsets.push_back(1);
+            } else if(last_id[it->second] != id) {
+                last_id[it->second] = id;
+                s->offsets[it->second]++;
+            }
+        });
+    }
+
+    // Order the keys, then turn their counts into offsets
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> order(slots.begin(), slots.end());
+    std::ranges::sort(order);
+    std::vector<std::uint32_t> counts = std::move(s->offsets);
+    s->keys.reserve(order.size());
+    s->offsets.reserve(order.size() + 1);
+    std::uint32_t total = 0;
+    for(auto& [t, slot] : order) {
+        s->keys.push_back(t);
+        s->offsets.push_back(total);
+        total += counts[slot];
+        counts[slot] = s->offsets.back(); // where the next id of this key goes
+    }
+    s->offsets.push_back(total);
+
+    s->ids.resize(total);
+    std::ranges::fill(last_id, UINT32_MAX);
+    for(std::uint32_t id = 0; id < s->items.size(); id++) {
+        for_each_key(s->text[id], [&](std::uint32_t t) {
+            const auto slot = slots.find(t)->second;
+            if(last_id[slot] != id) {
+                last_id[slot] = id;
+                s->ids[counts[slot]++] = id;
+            }
+        });
+    }
+    return s;
+}
+
+void search_index::update(std::string source, std::vector<search_item> items) {
+    update(std::move(source), [items = std::move(items)]() mutable { return std::move(items); });
+}
+
+void search_index::update(std::string source, std::function<std::vector<search_item>()> collect) {
+    std::uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation = ++sources[source].generation;
+    }
+    builds.submit([this, source = std::move(source), generation, collect = std::move(collect)](std::stop_token) {
+        auto is_latest = [&] {
+            return sources.find(source)->second.generation == generation;
+        };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!is_latest()) {
+                return; // superseded while it was queued
+            }
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto built = build(collect());
+        std::shared_ptr<const segment> previous;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!is_latest()) {
+                return;
+            }
+            // The old segment is freed outside the lock, queries only wait for the swap
+            previous = std::exchange(sources.find(source)->second.current, built);
+        }
+        revision++;
+        spdlog::debug("Indexed {} search items of {} in {} ms", built->items.size(), source,
+            std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+    });
+}
+
+std::vector<std::shared_ptr<const search_item>> search_index::find(std::string_view query, std::size_t limit) const {
+    const auto q = folded(query);
+    if(q.empty() || limit == 0) {
+        return {};
+    }
+    std::vector<std::shared_ptr<const segment>> segments;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(const auto& [name, s] : sources) {
+            if(s.current) {
+                segments.push_back(s.current);
+            }
+        }
+    }
+
+    struct hit {
+        int rank; // 0: the name starts with the query, 1: contains it, 2: only the detail does
+        std::string_view name; // folded
+        std::uint32_t segment;
+        std::uint32_t id;
+    };
+    std::vector<hit> hits;
+    for(std::uint32_t k = 0; k < segments.size(); k++) {
+        const auto& s = *segments[k];
+        for(auto id : s.matches(q)) {
+            auto text = s.text[id];
+            auto name = text.substr(0, text.find(detail_separator));
+            const auto pos = name.find(q);
+            hits.push_back({pos == 0 ? 0 : pos != std::string_view::npos ? 1 : 2, name, k, id});
+        }
+    }
+    // Shorter names match more closely, the name order keeps results stable
+    const auto best = hits.begin() + static_cast<std::ptrdiff_t>(std::min(limit, hits.size()));
+    std::partial_sort(hits.begin(), best, hits.end(), [](const hit& a, const hit& b) {
+        return std::tuple(a.rank, a.name.size(), a.name) < std::tuple(b.rank, b.name.size(), b.name);
+    });
+
+    std::vector<std::shared_ptr<const search_item>> results;
+    results.reserve(static_cast<std::size_t>(best - hits.begin()));
+    for(auto it = hits.begin(); it != best; ++it) {
+        const auto& s = segments[it->segment];
+        results.emplace_back(s, &s->items[it->id]); // keeps the segment alive
+    }
+    return results;
+}
+
+}
@@ -0,0 +1,108 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module openxmb.app:search_index;
+
+import openxmb.jobs;
+
+export namespace menu {
+
+// Something the search overlay can find.
+struct search_item {
+    enum class kind : std::uint8_t {
+        application,
+        setting,
+        user,
+        media,
+    };
+    kind type = kind::media;
+    std::string name;
+    // Shown below the name: the comment of an application, the description
+    // of a setting or the directory of a media file. Only menu entries are
+    // searched by it, media files by their name alone.
+    std::string detail;
+    // Where the entry is in the main menu: the category and the names of the
+    // entries leading to it. Unused for media files, which open by path.
+    unsigned int category = 0;
+    std::vector<std::string> location;
+};
+
+// In-memory trigram index over everything the search overlay can find.
+//
+// Items come in per source ("menus", "media") and every source is indexed
+// into an immutable segment of its own by a low priority job, which maps each
+// trigram of the case-folded text to the ascending ids of the items holding
+// it. A finished segment replaces the previous one of its source, so the
+// index fills in as sources arrive and a query never waits for a build.
+//
+// A query intersects the id lists of its trigrams, shortest first, and only
+// checks the few candidates left. Queries of one or two characters would
+// match nearly everything, they find the words starting with them instead,
+// which are indexed as well.
+class search_index {
+    public:
+        search_index() = default;
+        ~search_index();
+        search_index(const search_index&) = delete;
+        search_index& operator=(const search_index&) = delete;
+
+        // Replaces the items of source once they are indexed.
+        void update(std::string source, std::vector<search_item> items);
+        // Same, but the items are collected by the indexing job, e.g. from a
+        // media_library::snapshot.
+        void update(std::string source, std::function<std::vector<search_item>()> collect);
+
+        // Items containing query, at most limit: names starting with it come
+        // first, then names containing it, then matching details. Fast enough
+        // to run on the main thread for every key typed.
+        std::vector<std::shared_ptr<const search_item>> find(std::string_view query, std::size_t limit) const;
+
+        // Bumped whenever a source was indexed, so shown results can be redone.
+        [[nodiscard]] std::uint64_t get_revision() const {
+            return revision.load();
+        }
+    private:
+        struct segment;
+        static std::shared_ptr<const segment> build(std::vector<search_item> items);
+
+        struct source_state {
+            std::shared_ptr<const segment> current;
+            std::uint64_t generation = 0; // of the latest update, older builds are dropped
+        };
+
+        mutable std::mutex mutex;
+        std::map<std::string, source_state, std::less<>> sources;
+        std::atomic<std::uint64_t> revision{0};
+
+        jobs::group builds{jobs::priority::low}; // last, so builds stop before the sources go
+};
+
+}
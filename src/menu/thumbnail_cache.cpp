@@ -0,0 +1,377 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libswscale/swscale.h>
+}
+
+module openxmb.app;
+
+import :thumbnail_cache;
+import :thumbnail_store;
+
+import dreamrender;
+import openxmb.jobs;
+import openxmb.render;
+import openxmb.utils;
+import spdlog;
+import vma;
+
+namespace menu {
+
+namespace {
+    // Packets read after the seek before giving up on finding a keyframe
+    constexpr int max_packets = 4096;
+
+    struct thumbnail_decoder {
+        AVFormatContext* format_ctx = nullptr;
+        AVCodecContext* codec_ctx = nullptr;
+        AVPacket* packet = nullptr;
+        AVFrame* frame = nullptr;
+        SwsContext* sws_ctx = nullptr;
+
+        ~thumbnail_decoder() {
+            if (sws_ctx) sws_freeContext(sws_ctx);
+            if (frame) av_frame_free(&frame);
+            if (packet) av_packet_free(&packet);
+            if (codec_ctx) avcodec_free_context(&codec_ctx);
+            if (format_ctx) avformat_close_input(&format_ctx);
+        }
+    };
+}
+
+std::optional<thumbnail_image> decode_thumbnail(const std::filesystem::path& path, unsigned int max_size,
+    const std::function<bool()>& abort)
+{
+    thumbnail_decoder d;
+    d.format_ctx = avformat_alloc_context();
+    if (!d.format_ctx) {
+        return std::nullopt;
+    }
+    if (abort) {
+        // Lets a slow or stuck read (network mounts, huge remuxes) be cut short
+        d.format_ctx->interrupt_callback.callback = [](void* opaque) -> int {
+            return (*static_cast<const std::function<bool()>*>(opaque))() ? 1 : 0;
+        };
+        d.format_ctx->interrupt_callback.opaque = const_cast<std::function<bool()>*>(&abort);
+    }
+    if (avformat_open_input(&d.format_ctx, path.c_str(), nullptr, nullptr) != 0) {
+        return std::nullopt;
+    }
+    if (avformat_find_stream_info(d.format_ctx, nullptr) < 0) {
+        return std::nullopt;
+    }
+    const AVCodec* codec = nullptr;
+    int stream = av_find_best_stream(d.format_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    if (stream < 0) {
+        return std::nullopt;
+    }
+    const AVCodecParameters* params = d.format_ctx->streams[stream]->codecpar;
+    d.codec_ctx = avcodec_alloc_context3(codec);
+    if (!d.codec_ctx || avcodec_parameters_to_context(d.codec_ctx, params) < 0) {
+        return std::nullopt;
+    }
+
+    // Decoders that support it (JPEG) can skip straight to a reduced
+    // resolution, which is most of the work for large camera images.
+    int lowres = 0;
+    const int largest = std::max(params->width, params->height);
+    while (lowres < codec->max_lowres && (largest >> (lowres + 1)) >= static_cast<int>(max_size)) {
+        lowres++;
+    }
+    d.codec_ctx->lowres = lowres;
+    d.codec_ctx->thread_count = 1;
+    if (avcodec_open2(d.codec_ctx, codec, nullptr) < 0) {
+        return std::nullopt;
+    }
+
+    // Videos: jump to a keyframe a tenth of the way in (skipping intros and
+    // black leaders) and only ever decode keyframes from there.
+    const bool attached_picture = d.format_ctx->streams[stream]->disposition & AV_DISPOSITION_ATTACHED_PIC;
+    if (!attached_picture && d.format_ctx->duration > AV_TIME_BASE) {
+        std::int64_t target = std::min<std::int64_t>(d.format_ctx->duration / 10, std::int64_t{180} * AV_TIME_BASE);
+        if (d.format_ctx->start_time != AV_NOPTS_VALUE) {
+            target += d.format_ctx->start_time;
+        }
+        if (av_seek_frame(d.format_ctx, -1, target, AVSEEK_FLAG_BACKWARD) < 0) {
+            av_seek_frame(d.format_ctx, -1, 0, AVSEEK_FLAG_BACKWARD);
+        }
+        d.codec_ctx->skip_frame = AVDISCARD_NONKEY;
+    }
+
+    d.packet = av_packet_alloc();
+    d.frame = av_frame_alloc();
+    bool decoded = false;
+    for (int packets = 0; !decoded && packets < max_packets && av_read_frame(d.format_ctx, d.packet) >= 0; packets++) {
+        if (d.packet->stream_index == stream && avcodec_send_packet(d.codec_ctx, d.packet) == 0) {
+            decoded = avcodec_receive_frame(d.codec_ctx, d.frame) == 0;
+        }
+        av_packet_unref(d.packet);
+        if (abort && abort()) {
+            return std::nullopt;
+        }
+    }
+    if (!decoded) {
+        avcodec_send_packet(d.codec_ctx, nullptr);
+        decoded = avcodec_receive_frame(d.codec_ctx, d.frame) == 0;
+    }
+    if (!decoded || d.frame->width <= 0 || d.frame->height <= 0) {
+        return std::nullopt;
+    }
+
+    const int width = d.frame->width;
+    const int height = d.frame->height;
+    const double scale = std::min(1.0, static_cast<double>(max_size) / std::max(width, height));
+    thumbnail_image image;
+    image.width = std::max(1, static_cast<int>(std::lround(width * scale)));
+    image.height = std::max(1, static_cast<int>(std::lround(height * scale)));
+
+    // swscale converts to RGBA and averages down to at most twice the size,
+    // which keeps the intermediate image small; the last step is Lanczos.
+    const unsigned int rgba_width = std::min(static_cast<unsigned int>(width), image.width * 2);
+    const unsigned int rgba_height = std::min(static_cast<unsigned int>(height), image.height * 2);
+    d.sws_ctx = sws_getContext(width, height, static_cast<AVPixelFormat>(d.frame->format),
+        rgba_width, rgba_height, AV_PIX_FMT_RGBA, SWS_AREA, nullptr, nullptr, nullptr);
+    if (!d.sws_ctx) {
+        return std::nullopt;
+    }
+    std::vector<std::uint8_t> rgba(static_cast<std::size_t>(rgba_width) * rgba_height * 4);
+    std::uint8_t* dst[4] = {rgba.data(), nullptr, nullptr, nullptr};
+    int dst_stride[4] = {static_cast<int>(rgba_width * 4), 0, 0, 0};
+    sws_scale(d.sws_ctx, d.frame->data, d.frame->linesize, 0, height, dst, dst_stride);
+    if (rgba_width == image.width && rgba_height == image.height) {
+        image.pixels = std::move(rgba);
+    } else {
+        image.pixels = utils::downscale_rgba(rgba, rgba_width, rgba_height, image.width, image.height,
+            utils::scale_filter::lanczos);
+    }
+    return image;
+}
+
+thumbnail_cache::thumbnail_cache(vma::Allocator allocator, render::texture_uploader& uploader)
+    : allocator(allocator), uploader(uploader)
+{
+    max_workers = std::clamp(jobs::scheduler::instance().thread_count() / 2, 1u, max_threads);
+}
+
+thumbnail_cache::~thumbnail_cache() {
+    workers.cancel();
+    workers.wait();
+}
+
+const dreamrender::texture* thumbnail_cache::get(const std::filesystem::path& path) {
+    std::string key = path.string();
+    if(auto it = slots.find(key); it != slots.end()) {
+        lru.splice(lru.begin(), lru, it->second.lru);
+        return it->second.texture->loaded ? it->second.texture.get() : nullptr;
+    }
+    if(failed.contains(key) || requested.contains(key)) {
+        return nullptr;
+    }
+
+    requested.insert(key);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_front(std::move(key));
+        while(requests.size() > max_requests) {
+            requested.erase(requests.back());
+            requests.pop_back();
+        }
+        if(active_workers < max_workers) {
+            active_workers++;
+            workers.submit([this](std::stop_token stop) { worker(stop); });
+        }
+    }
+    return nullptr;
+}
+
+void thumbnail_cache::cancel_pending() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(const auto& path : requests) {
+        requested.erase(path);
+    }
+    requests.clear();
+    ++generation;
+}
+
+void thumbnail_cache::forget(const std::filesystem::path& path) {
+    const auto key = path.string();
+    failed.erase(key);
+    if(slots.contains(key)) {
+        evict(key);
+        ++revision;
+    }
+}
+
+void thumbnail_cache::tick() {
+    std::vector<result> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(results);
+    }
+
+    bool changed = false;
+    for(auto& r : done) {
+        requested.erase(r.path);
+        if(r.cancelled) {
+            continue; // asked for again if it is still wanted
+        }
+        if(!r.image) {
+            failed.insert(std::move(r.path));
+            continue;
+        }
+        if(slots.contains(r.path)) {
+            continue;
+        }
+        slot s;
+        s.bytes = r.image->pixels.size();
+        s.texture = uploader.create(std::move(r.image->pixels), r.image->width, r.image->height);
+        lru.push_front(r.path);
+        s.lru = lru.begin();
+        resident_bytes += s.bytes;
+        uploading.push_back(r.path);
+        slots.emplace(std::move(r.path), std::move(s));
+    }
+
+    // Uploads are recorded during the frame, so they show up one tick later.
+    std::erase_if(uploading, [&](const std::string& key) {
+        auto it = slots.find(key);
+        if(it == slots.end()) {
+            return true;
+        }
+        if(it->second.texture->loaded) {
+            changed = true;
+            return true;
+        }
+        return false;
+    });
+
+    const std::size_t limit = budget();
+    while(resident_bytes > limit && lru.size() > min_resident) {
+        evict(lru.back());
+        changed = true;
+    }
+
+    if(changed) {
+        ++revision;
+    }
+}
+
+std::size_t thumbnail_cache::budget() const {
+    std::uint64_t total{}, usage{};
+    for(const auto& b : allocator.getHeapBudgets()) {
+        total += b.budget;
+        usage += b.usage;
+    }
+    std::size_t limit = std::clamp<std::size_t>(total / 16, min_budget, max_budget);
+    // Close to the device budget: give back half of what we hold.
+    if(usage > total / 10 * 9) {
+        limit = std::min(limit, resident_bytes / 2);
+    }
+    return limit;
+}
+
+void thumbnail_cache::evict(const std::string& key) {
+    auto it = slots.find(key);
+    if(it == slots.end()) {
+        return;
+    }
+    resident_bytes -= it->second.bytes;
+    // Frames in flight may still sample the texture.
+    uploader.retire(std::move(it->second.texture));
+    lru.erase(it->second.lru); // key may refer to the list node, so this goes last
+    slots.erase(it);
+}
+
+void thumbnail_cache::worker(std::stop_token stop) {
+    // Runs as a job until the queue is empty; get() starts another one for
+    // requests arriving after that.
+    while(true) {
+        std::string path;
+        std::uint64_t gen{};
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(requests.empty() || stop.stop_requested()) {
+                active_workers--;
+                return;
+            }
+            path = std::move(requests.front());
+            requests.pop_front();
+            gen = generation.load();
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() + max_decode_time;
+        bool timed_out = false;
+        std::function<bool()> abort = [&] {
+            if(stop.stop_requested() || generation.load() != gen) {
+                return true;
+            }
+            timed_out = std::chrono::steady_clock::now() > deadline;
+            return timed_out;
+        };
+
+        std::optional<thumbnail_image> image;
+        try {
+            image = load(path, abort);
+        } catch(const std::exception& e) {
+            spdlog::debug("Failed to decode thumbnail for {}: {}", path, e.what());
+        }
+        const bool cancelled = !image && !timed_out && generation.load() != gen;
+        if(timed_out) {
+            spdlog::debug("Gave up on thumbnail for {} after {}s", path, max_decode_time.count());
+        } else if(!image && !cancelled) {
+            spdlog::debug("No thumbnail for {}", path);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back({std::move(path), std::move(image), cancelled});
+    }
+}
+
+std::optional<thumbnail_image> thumbnail_cache::load(const std::filesystem::path& path, const std::function<bool()>& abort) const {
+    if(auto stored = store.find(path, max_size)) {
+        if(auto image = decode_thumbnail(*stored, max_size, abort)) {
+            return image;
+        }
+    }
+    auto image = decode_thumbnail(path, max_size, abort);
+    if(image && !store.save(path, *image, max_size)) {
+        spdlog::trace("Could not store thumbnail for {}", path.string());
+    }
+    return image;
+}
+
+}
@@ -0,0 +1,143 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+export module openxmb.app:thumbnail_cache;
+
+import dreamrender;
+import openxmb.jobs;
+import openxmb.render;
+import vma;
+import :thumbnail_store;
+
+export namespace menu {
+
+// Decodes the image (or a keyframe of the video) at path so that neither side
+// exceeds max_size. Gives up as soon as abort returns true, which is also
+// polled while FFmpeg is blocked on I/O.
+std::optional<thumbnail_image> decode_thumbnail(const std::filesystem::path& path, unsigned int max_size,
+    const std::function<bool()>& abort = {});
+
+// Bounded-size thumbnail textures for file menus.
+//
+// Thumbnails are decoded by a few jobs on the shared scheduler, most
+// recently requested first, and only for entries that are actually being
+// drawn. Previews already in the freedesktop thumbnail store are loaded from
+// there; generated ones are written back so they survive restarts. Resident
+// textures are evicted least-recently-used first once they exceed a share of
+// the VRAM budget reported by the allocator.
+class thumbnail_cache {
+    public:
+        thumbnail_cache(vma::Allocator allocator, render::texture_uploader& uploader);
+        ~thumbnail_cache();
+
+        // Returns the thumbnail for path if it is resident and uploaded.
+        // Otherwise queues a decode and returns nullptr; the caller should
+        // draw a fallback icon in the meantime.
+        const dreamrender::texture* get(const std::filesystem::path& path);
+
+        // Drops queued requests and aborts decodes in progress, e.g. because
+        // the directory they belong to is no longer shown.
+        void cancel_pending();
+
+        // Drops the thumbnail of path, e.g. because the file was rewritten,
+        // so the next get() decodes it again.
+        void forget(const std::filesystem::path& path);
+
+        // Called once per frame on the main thread: uploads finished decodes
+        // and evicts textures over budget.
+        void tick();
+
+        // Bumped whenever a thumbnail becomes visible or is evicted, so
+        // retained views know to look up their icons again.
+        [[nodiscard]] std::uint64_t get_revision() const {
+            return revision;
+        }
+
+        static constexpr unsigned int max_size = 256;
+    private:
+        struct slot {
+            std::unique_ptr<dreamrender::texture> texture;
+            std::size_t bytes = 0;
+            std::list<std::string>::iterator lru;
+        };
+        struct result {
+            std::string path;
+            std::optional<thumbnail_image> image;
+            bool cancelled = false;
+        };
+
+        void worker(std::stop_token stop);
+        std::optional<thumbnail_image> load(const std::filesystem::path& path, const std::function<bool()>& abort) const;
+        std::size_t budget() const;
+        void evict(const std::string& key);
+
+        vma::Allocator allocator;
+        render::texture_uploader& uploader;
+        thumbnail_store store;
+
+        // main thread only
+        std::unordered_map<std::string, slot> slots;
+        std::list<std::string> lru; // front is most recently used
+        std::unordered_set<std::string> requested;
+        std::unordered_set<std::string> failed;
+        std::vector<std::string> uploading;
+        std::size_t resident_bytes = 0;
+        std::uint64_t revision = 0;
+
+        // shared with the workers
+        std::mutex mutex;
+        std::deque<std::string> requests; // front is most recently requested
+        std::vector<result> results;
+        std::atomic<std::uint64_t> generation{0};
+        unsigned int active_workers = 0;
+        unsigned int max_workers = 1;
+
+        jobs::group workers{jobs::priority::normal}; // last, so it stops before the rest goes
+
+        // Only the newest requests are kept; older ones were scrolled past
+        // and are dropped instead of decoded.
+        static constexpr std::size_t max_requests = 64;
+        // Never evict below this many thumbnails, they are likely on screen.
+        static constexpr std::size_t min_resident = 32;
+        static constexpr unsigned int max_threads = 4;
+        // Per-file cap, so one huge or slow file cannot hold up the queue.
+        static constexpr auto max_decode_time = std::chrono::seconds(3);
+        static constexpr std::size_t min_budget = 32ull * 1024 * 1024;
+        static constexpr std::size_t max_budget = 256ull * 1024 * 1024;
+};
+
+}
@@ -0,0 +1,286 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/crc.h>
+#include <libavutil/frame.h>
+#include <libavutil/md5.h>
+}
+
+module openxmb.app;
+
+import :thumbnail_store;
+
+import spdlog;
+
+namespace menu {
+
+namespace {
+    constexpr std::array<std::uint8_t, 8> png_signature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    std::uint32_t read_be32(const std::uint8_t* p) {
+        return (std::uint32_t{p[0]} << 24) | (std::uint32_t{p[1]} << 16) | (std::uint32_t{p[2]} << 8) | std::uint32_t{p[3]};
+    }
+    void append_be32(std::vector<std::uint8_t>& out, std::uint32_t v) {
+        out.push_back(v >> 24);
+        out.push_back(v >> 16);
+        out.push_back(v >> 8);
+        out.push_back(v);
+    }
+
+    // Reads the tEXt chunks in front of the image data without decoding it.
+    std::unordered_map<std::string, std::string> read_png_text(const std::filesystem::path& path) {
+        std::unordered_map<std::string, std::string> text;
+        std::ifstream in(path, std::ios::binary);
+        std::array<std::uint8_t, 8> signature{};
+        if(!in.read(reinterpret_cast<char*>(signature.data()), signature.size()) || signature != png_signature) {
+            return text;
+        }
+
+        constexpr std::uint32_t max_text_chunk = 64 * 1024;
+        std::array<std::uint8_t, 8> header{};
+        std::string data;
+        while(in.read(reinterpret_cast<char*>(header.data()), header.size())) {
+            std::uint32_t length = read_be32(header.data());
+            std::string_view type(reinterpret_cast<const char*>(header.data()+4), 4);
+            if(type == "IDAT" || type == "IEND") {
+                break;
+            }
+            if(type == "tEXt" && length <= max_text_chunk) {
+                data.resize(length);
+                if(!in.read(data.data(), length)) {
+                    break;
+                }
+                if(auto sep = data.find('\0'); sep != std::string::npos) {
+                    text.emplace(data.substr(0, sep), data.substr(sep+1));
+                }
+                in.seekg(4, std::ios::cur); // CRC
+            } else {
+                in.seekg(std::streamoff{length} + 4, std::ios::cur);
+            }
+        }
+        return text;
+    }
+
+    void append_text_chunk(std::vector<std::uint8_t>& out, std::string_view key, std::string_view value) {
+        std::vector<std::uint8_t> chunk;
+        chunk.reserve(4 + key.size() + 1 + value.size());
+        chunk.insert(chunk.end(), {'t', 'E', 'X', 't'});
+        chunk.insert(chunk.end(), key.begin(), key.end());
+        chunk.push_back('\0');
+        chunk.insert(chunk.end(), value.begin(), value.end());
+
+        const std::uint32_t crc = av_crc(av_crc_get_table(AV_CRC_32_IEEE_LE), UINT32_MAX, chunk.data(), chunk.size()) ^ UINT32_MAX;
+        append_be32(out, chunk.size() - 4);
+        out.insert(out.end(), chunk.begin(), chunk.end());
+        append_be32(out, crc);
+    }
+
+    std::vector<std::uint8_t> encode_png(const thumbnail_image& image) {
+        std::vector<std::uint8_t> png;
+        const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_PNG);
+        if(!codec) {
+            return png;
+        }
+        AVCodecContext* ctx = avcodec_alloc_context3(codec);
+        AVFrame* frame = av_frame_alloc();
+        AVPacket* packet = av_packet_alloc();
+        if(ctx && frame && packet) {
+            ctx->width = static_cast<int>(image.width);
+            ctx->height = static_cast<int>(image.height);
+            ctx->pix_fmt = AV_PIX_FMT_RGBA;
+            ctx->time_base = AVRational{1, 1};
+            frame->format = AV_PIX_FMT_RGBA;
+            frame->width = ctx->width;
+            frame->height = ctx->height;
+            if(avcodec_open2(ctx, codec, nullptr) == 0 && av_frame_get_buffer(frame, 0) == 0) {
+                const std::size_t row = std::size_t{image.width} * 4;
+                for(unsigned int y = 0; y < image.height; y++) {
+                    std::memcpy(frame->data[0] + y * frame->linesize[0], image.pixels.data() + y * row, row);
+                }
+                if(avcodec_send_frame(ctx, frame) == 0 && avcodec_receive_packet(ctx, packet) == 0) {
+                    png.assign(packet->data, packet->data + packet->size);
+                }
+            }
+        }
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+        return png;
+    }
+
+    std::filesystem::path default_root() {
+        if(const char* cache = std::getenv("XDG_CACHE_HOME"); cache && *cache) {
+            return std::filesystem::path(cache) / "thumbnails";
+        }
+        const char* home = std::getenv("HOME");
+        return std::filesystem::path(home ? home : "") / ".cache" / "thumbnails";
+    }
+}
+
+thumbnail_store::thumbnail_store() : thumbnail_store(default_root()) {}
+thumbnail_store::thumbnail_store(std::filesystem::path root) : root(std::move(root)) {}
+
+std::string thumbnail_store::file_uri(const std::filesystem::path& file) {
+    // Same escaping as GLib's g_filename_to_uri(), so hashes match other apps.
+    constexpr std::string_view allowed = "!$&'()*+,-./:=@_~";
+    std::string uri = "file://";
+    for(unsigned char c : std::filesystem::absolute(file).lexically_normal().string()) {
+        if((c < 0x80 && std::isalnum(c)) || allowed.find(static_cast<char>(c)) != std::string_view::npos) {
+            uri += static_cast<char>(c);
+        } else {
+            uri += std::format("%{:02X}", c);
+        }
+    }
+    return uri;
+}
+
+std::string thumbnail_store::uri_hash(std::string_view uri) {
+    std::array<std::uint8_t, 16> digest{};
+    av_md5_sum(digest.data(), reinterpret_cast<const std::uint8_t*>(uri.data()), uri.size());
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for(auto b : digest) {
+        hex += std::format("{:02x}", b);
+    }
+    return hex;
+}
+
+bool thumbnail_store::contains(const std::filesystem::path& file) const {
+    auto rel = std::filesystem::absolute(file).lexically_normal().lexically_relative(root);
+    return !rel.empty() && *rel.begin() != "..";
+}
+
+std::optional<std::filesystem::path> thumbnail_store::find(const std::filesystem::path& file, unsigned int max_size) const {
+    struct stat st{};
+    if(::stat(file.c_str(), &st) != 0) {
+        return std::nullopt;
+    }
+    const std::string uri = file_uri(file);
+    const std::string name = uri_hash(uri) + ".png";
+    const std::string mtime = std::to_string(static_cast<long long>(st.st_mtime));
+
+    // Prefer the smallest flavour that is large enough, then anything smaller.
+    std::vector<flavour> order;
+    for(const auto& f : flavours) {
+        if(f.size >= max_size) order.push_back(f);
+    }
+    for(auto it = std::rbegin(flavours); it != std::rend(flavours); ++it) {
+        if(it->size < max_size) order.push_back(*it);
+    }
+
+    for(const auto& f : order) {
+        auto candidate = root / f.name / name;
+        std::error_code ec;
+        if(!std::filesystem::is_regular_file(candidate, ec)) {
+            continue;
+        }
+        auto text = read_png_text(candidate);
+        auto it = text.find("Thumb::MTime");
+        if(it == text.end() || it->second != mtime) {
+            continue; // stale, the original has changed since
+        }
+        if(auto u = text.find("Thumb::URI"); u != text.end() && u->second != uri) {
+            continue;
+        }
+        return candidate;
+    }
+    return std::nullopt;
+}
+
+bool thumbnail_store::save(const std::filesystem::path& file, const thumbnail_image& image, unsigned int max_size) const {
+    if(contains(file)) {
+        return false;
+    }
+    struct stat st{};
+    if(::stat(file.c_str(), &st) != 0) {
+        return false;
+    }
+    auto f = std::ranges::find_if(flavours, [&](const flavour& f) { return f.size >= max_size; });
+    if(f == std::end(flavours)) {
+        return false;
+    }
+
+    std::vector<std::uint8_t> encoded = encode_png(image);
+    constexpr std::size_t ihdr_end = 8 + 4 + 4 + 13 + 4;
+    if(encoded.size() < ihdr_end || !std::equal(png_signature.begin(), png_signature.end(), encoded.begin()) ||
+        std::string_view(reinterpret_cast<const char*>(encoded.data() + 12), 4) != "IHDR") {
+        return false;
+    }
+
+    // Our metadata goes right after IHDR so readers find it before IDAT.
+    const std::string uri = file_uri(file);
+    std::vector<std::uint8_t> png(encoded.begin(), encoded.begin() + ihdr_end);
+    append_text_chunk(png, "Thumb::URI", uri);
+    append_text_chunk(png, "Thumb::MTime", std::to_string(static_cast<long long>(st.st_mtime)));
+    append_text_chunk(png, "Thumb::Size", std::to_string(static_cast<long long>(st.st_size)));
+    append_text_chunk(png, "Software", "OpenXMB");
+    png.insert(png.end(), encoded.begin() + ihdr_end, encoded.end());
+
+    try {
+        auto dir = root / f->name;
+        std::filesystem::create_directories(dir);
+        std::filesystem::permissions(root, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+        std::filesystem::permissions(dir, std::filesystem::perms::owner_all, std::filesystem::perm_options::replace);
+
+        // Write to a temporary file and rename, so readers never see a partial PNG.
+        auto target = dir / (uri_hash(uri) + ".png");
+        auto temp = dir / std::format("{}.{}.{}.tmp", target.filename().string(), ::getpid(),
+            std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+            if(!out) {
+                std::filesystem::remove(temp);
+                return false;
+            }
+        }
+        std::filesystem::permissions(temp, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write,
+            std::filesystem::perm_options::replace);
+        std::filesystem::rename(temp, target);
+    } catch(const std::exception& e) {
+        spdlog::debug("Failed to store thumbnail for {}: {}", file.string(), e.what());
+        return false;
+    }
+    return true;
+}
+
+}
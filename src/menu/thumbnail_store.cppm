@@ -0,0 +1,77 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+export module openxmb.app:thumbnail_store;
+
+export namespace menu {
+
+// Small RGBA8 image produced by a thumbnail decoder.
+struct thumbnail_image {
+    std::vector<std::uint8_t> pixels;
+    unsigned int width = 0;
+    unsigned int height = 0;
+};
+
+// Persistent thumbnails following the freedesktop.org thumbnail spec, so
+// previews survive restarts and are shared with other desktop applications.
+//
+// Thumbnails live in $XDG_CACHE_HOME/thumbnails/<flavour>/<md5 of URI>.png
+// and are only used while their Thumb::MTime matches the original file.
+class thumbnail_store {
+    public:
+        // Uses $XDG_CACHE_HOME/thumbnails, falling back to ~/.cache/thumbnails.
+        thumbnail_store();
+        explicit thumbnail_store(std::filesystem::path root);
+
+        // Path of a valid stored thumbnail for file that is at least max_size
+        // large if possible (smaller ones are used if nothing better exists).
+        std::optional<std::filesystem::path> find(const std::filesystem::path& file, unsigned int max_size) const;
+
+        // Stores image (already scaled to at most max_size) as the thumbnail of file.
+        bool save(const std::filesystem::path& file, const thumbnail_image& image, unsigned int max_size) const;
+
+        // Whether file is part of the store itself and must not be thumbnailed.
+        bool contains(const std::filesystem::path& file) const;
+
+        static std::string file_uri(const std::filesystem::path& file);
+        static std::string uri_hash(std::string_view uri);
+    private:
+        struct flavour {
+            std::string_view name;
+            unsigned int size;
+        };
+        static constexpr flavour flavours[] = {
+            {"normal", 128},
+            {"large", 256},
+            {"x-large", 512},
+            {"xx-large", 1024},
+        };
+
+        std::filesystem::path root;
+};
+
+}
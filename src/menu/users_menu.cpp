@@ -131,6 +131,7 @@ namespace menu {
 
     void users_menu::reload() {
         entries.clear();
+        invalidate();
         users = scan_users();
         
         for (const auto& user : users) {
@@ -0,0 +1,302 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+module openxmb.mime;
+
+import openxmb.utils;
+
+namespace mime {
+
+using namespace std::string_view_literals;
+
+namespace {
+    struct extension_entry {
+        std::string_view ext; // lower case, without the dot
+        std::string_view type;
+    };
+    constexpr std::array extensions{
+        extension_entry{"txt", "text/plain"},
+        extension_entry{"log", "text/plain"},
+        extension_entry{"md", "text/markdown"},
+        extension_entry{"html", "text/html"},
+        extension_entry{"htm", "text/html"},
+        extension_entry{"css", "text/css"},
+        extension_entry{"csv", "text/csv"},
+        extension_entry{"js", "application/javascript"},
+        extension_entry{"json", "application/json"},
+        extension_entry{"xml", "application/xml"},
+        extension_entry{"pdf", "application/pdf"},
+        extension_entry{"jpg", "image/jpeg"},
+        extension_entry{"jpeg", "image/jpeg"},
+        extension_entry{"png", "image/png"},
+        extension_entry{"gif", "image/gif"},
+        extension_entry{"bmp", "image/bmp"},
+        extension_entry{"webp", "image/webp"},
+        extension_entry{"tif", "image/tiff"},
+        extension_entry{"tiff", "image/tiff"},
+        extension_entry{"heic", "image/heic"},
+        extension_entry{"avif", "image/avif"},
+        extension_entry{"svg", "image/svg+xml"},
+        extension_entry{"ico", "image/x-icon"},
+        extension_entry{"mp3", "audio/mpeg"},
+        extension_entry{"wav", "audio/wav"},
+        extension_entry{"ogg", "audio/ogg"},
+        extension_entry{"opus", "audio/ogg"},
+        extension_entry{"flac", "audio/flac"},
+        extension_entry{"m4a", "audio/mp4"},
+        extension_entry{"aac", "audio/aac"},
+        extension_entry{"mp4", "video/mp4"},
+        extension_entry{"m4v", "video/mp4"},
+        extension_entry{"avi", "video/x-msvideo"},
+        extension_entry{"mkv", "video/x-matroska"},
+        extension_entry{"webm", "video/webm"},
+        extension_entry{"mov", "video/quicktime"},
+        extension_entry{"mpg", "video/mpeg"},
+        extension_entry{"mpeg", "video/mpeg"},
+        extension_entry{"ts", "video/mp2t"},
+        extension_entry{"zip", "application/zip"},
+        extension_entry{"tar", "application/x-tar"},
+        extension_entry{"gz", "application/gzip"},
+        extension_entry{"tgz", "application/gzip"},
+        extension_entry{"7z", "application/x-7z-compressed"},
+        extension_entry{"exe", "application/x-executable"},
+        extension_entry{"deb", "application/vnd.debian.binary-package"},
+        extension_entry{"rpm", "application/x-rpm"},
+        extension_entry{"app", "application/x-executable"},
+        extension_entry{"dmg", "application/x-apple-diskimage"},
+        extension_entry{"iso", "application/x-iso9660-image"},
+    };
+    // Longest extension in the table, longer ones cannot match.
+    constexpr std::size_t max_extension = 4;
+
+    constexpr std::uint32_t hash(std::string_view s, std::uint32_t seed) {
+        std::uint32_t h = 2166136261u ^ seed; // FNV-1a
+        for(char c : s) {
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        }
+        // The low bits of a product only depend on the low bits of its
+        // factors, so without folding the high bits in, slot = h % table_size
+        // could only tell table_size seeds apart.
+        h ^= h >> 16;
+        h *= 0x85ebca6bu;
+        h ^= h >> 13;
+        return h;
+    }
+
+    // Perfect hash: the seed is searched at compile time so that every
+    // extension lands in its own slot, a lookup is then one hash and one
+    // string compare. A table four times the number of extensions needs a
+    // hundred or so seeds tried on average.
+    constexpr std::size_t table_size = 256;
+    static_assert(extensions.size() * 4 <= table_size);
+
+    constexpr bool collision_free(std::uint32_t seed) {
+        std::array<bool, table_size> used{};
+        for(const auto& e : extensions) {
+            auto slot = hash(e.ext, seed) % table_size;
+            if(used[slot]) {
+                return false;
+            }
+            used[slot] = true;
+        }
+        return true;
+    }
+    constexpr std::uint32_t max_seed = 4096;
+    constexpr std::uint32_t find_seed() {
+        for(std::uint32_t seed = 0; seed < max_seed; seed++) {
+            if(collision_free(seed)) {
+                return seed;
+            }
+        }
+        return max_seed;
+    }
+    constexpr std::uint32_t seed = find_seed();
+    static_assert(seed < max_seed, "no collision-free seed for the extension table, make table_size larger");
+
+    constexpr auto build_table() {
+        std::array<const extension_entry*, table_size> table{};
+        for(const auto& e : extensions) {
+            table[hash(e.ext, seed) % table_size] = &e;
+        }
+        return table;
+    }
+    constexpr auto table = build_table();
+
+    constexpr bool starts_with_at(std::string_view data, std::size_t offset, std::string_view magic) {
+        return data.size() >= offset + magic.size() && data.substr(offset, magic.size()) == magic;
+    }
+
+    // Whether data is plausibly UTF-8 text; a truncated last sequence is fine.
+    bool looks_like_text(std::string_view data) {
+        std::size_t i = 0;
+        while(i < data.size()) {
+            const auto c = static_cast<unsigned char>(data[i]);
+            if(c < 0x80) {
+                if(c < 0x20 && c != '\t' && c != '\n' && c != '\r' && c != '\f') {
+                    return false;
+                }
+                i++;
+                continue;
+            }
+            const std::size_t length = (c & 0xe0) == 0xc0 ? 2 : (c & 0xf0) == 0xe0 ? 3 : (c & 0xf8) == 0xf0 ? 4 : 0;
+            if(length == 0) {
+                return false;
+            }
+            for(std::size_t k = 1; k < length; k++) {
+                if(i + k >= data.size()) {
+                    return true;
+                }
+                if((static_cast<unsigned char>(data[i + k]) & 0xc0) != 0x80) {
+                    return false;
+                }
+            }
+            i += length;
+        }
+        return true;
+    }
+
+    // ISO base media files (MP4, MOV, HEIF) name their flavour in the ftyp box.
+    std::string_view sniff_ftyp(std::string_view brand) {
+        if(brand == "qt  ") return "video/quicktime";
+        if(brand == "M4A " || brand == "M4B ") return "audio/mp4";
+        if(brand == "heic" || brand == "heix" || brand == "mif1") return "image/heic";
+        if(brand == "avif" || brand == "avis") return "image/avif";
+        return "video/mp4";
+    }
+}
+
+std::string_view from_extension(std::string_view ext) {
+    if(ext.starts_with('.')) {
+        ext.remove_prefix(1);
+    }
+    if(ext.empty() || ext.size() > max_extension) {
+        return {};
+    }
+    std::array<char, max_extension> folded{};
+    std::ranges::transform(ext, folded.begin(), [](char c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    const std::string_view key(folded.data(), ext.size());
+    const auto* entry = table[hash(key, seed) % table_size];
+    return entry && entry->ext == key ? entry->type : std::string_view{};
+}
+
+std::string_view from_name(std::string_view name) {
+    const auto dot = name.rfind('.');
+    if(dot == std::string_view::npos || dot == 0) {
+        return {}; // no extension, or a dotfile like ".bashrc"
+    }
+    return from_extension(name.substr(dot + 1));
+}
+
+std::string_view sniff(std::string_view h) {
+    h = h.substr(0, sniff_size);
+    if(starts_with_at(h, 0, "\x89PNG\r\n\x1a\n")) return "image/png";
+    if(starts_with_at(h, 0, "\xff\xd8\xff")) return "image/jpeg";
+    if(starts_with_at(h, 0, "GIF87a") || starts_with_at(h, 0, "GIF89a")) return "image/gif";
+    if(starts_with_at(h, 0, "RIFF")) {
+        if(starts_with_at(h, 8, "WEBP")) return "image/webp";
+        if(starts_with_at(h, 8, "WAVE")) return "audio/wav";
+        if(starts_with_at(h, 8, "AVI ")) return "video/x-msvideo";
+    }
+    if(starts_with_at(h, 0, "BM") && h.size() >= 14) return "image/bmp";
+    if(starts_with_at(h, 0, "II*\0"sv) || starts_with_at(h, 0, "MM\0*"sv)) return "image/tiff";
+    if(starts_with_at(h, 4, "ftyp") && h.size() >= 12) return sniff_ftyp(h.substr(8, 4));
+    if(starts_with_at(h, 0, "\x1a\x45\xdf\xa3")) {
+        // The EBML header names the document type within the first few bytes
+        return h.substr(0, 64).find("webm") != std::string_view::npos ? "video/webm" : "video/x-matroska";
+    }
+    if(starts_with_at(h, 0, "OggS")) return "audio/ogg";
+    if(starts_with_at(h, 0, "fLaC")) return "audio/flac";
+    if(starts_with_at(h, 0, "ID3")) return "audio/mpeg";
+    if(h.size() >= 2 && static_cast<unsigned char>(h[0]) == 0xff && (static_cast<unsigned char>(h[1]) & 0xe0) == 0xe0) {
+        // MPEG audio frame sync; layer bits of zero mean an ADTS AAC stream
+        const auto layer = static_cast<unsigned char>(h[1]) & 0x06;
+        if(layer != 0) return "audio/mpeg";
+        if((static_cast<unsigned char>(h[1]) & 0xf0) == 0xf0) return "audio/aac";
+    }
+    if(starts_with_at(h, 0, "\x47") && starts_with_at(h, 188, "\x47")) return "video/mp2t";
+    if(starts_with_at(h, 0, "\x00\x00\x01\xba"sv) || starts_with_at(h, 0, "\x00\x00\x01\xb3"sv)) return "video/mpeg";
+    if(starts_with_at(h, 0, "%PDF-")) return "application/pdf";
+    if(starts_with_at(h, 0, "PK\x03\x04")) return "application/zip";
+    if(starts_with_at(h, 0, "\x1f\x8b")) return "application/gzip";
+    if(starts_with_at(h, 0, "7z\xbc\xaf\x27\x1c")) return "application/x-7z-compressed";
+    if(starts_with_at(h, 257, "ustar")) return "application/x-tar";
+    if(starts_with_at(h, 0, "!<arch>\ndebian")) return "application/vnd.debian.binary-package";
+    if(starts_with_at(h, 0, "\xed\xab\xee\xdb")) return "application/x-rpm";
+    if(starts_with_at(h, 0, "\x7f" "ELF")) return "application/x-executable";
+    if(starts_with_at(h, 0, "MZ")) return "application/x-executable";
+    if(starts_with_at(h, 0, "\x00\x00\x01\x00"sv)) return "image/x-icon";
+    if(looks_like_text(h) && !h.empty()) {
+        auto start = h.substr(std::min(h.find_first_not_of(" \t\r\n\xef\xbb\xbf"), h.size()));
+        if(start.starts_with("<svg") || (start.starts_with("<?xml") && h.find("<svg") != std::string_view::npos)) return "image/svg+xml";
+        if(start.starts_with("<?xml")) return "application/xml";
+        if(start.starts_with("<!DOCTYPE html") || start.starts_with("<!doctype html") || start.starts_with("<html")) return "text/html";
+        if(start.starts_with("{") || start.starts_with("[")) return "application/json";
+        return "text/plain";
+    }
+    return {};
+}
+
+std::string_view sniff_file(int dirfd, const char* name) {
+    utils::unique_fd fd(::openat(dirfd, name, O_RDONLY | O_CLOEXEC | O_NONBLOCK | O_NOCTTY));
+    if(!fd) {
+        return {};
+    }
+    struct stat st{};
+    if(::fstat(fd.get(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return {};
+    }
+    std::array<char, sniff_size> buffer;
+    const ssize_t n = ::pread(fd.get(), buffer.data(), buffer.size(), 0);
+    if(n <= 0) {
+        return {};
+    }
+    return sniff(std::string_view(buffer.data(), static_cast<std::size_t>(n)));
+}
+
+std::string_view detect(const std::filesystem::path& path) {
+    const auto by_extension = from_name(path.filename().native());
+    const auto by_content = sniff_file(AT_FDCWD, path.c_str());
+    if(by_extension.empty()) {
+        return by_content.empty() ? octet_stream : by_content;
+    }
+    // Text is what most unknown binary-free files look like, it is no reason to
+    // doubt the extension; a real signature is.
+    if(!by_content.empty() && by_content != by_extension && !by_content.starts_with("text/") &&
+        by_content != "application/json" && by_content != "application/xml")
+    {
+        return by_content;
+    }
+    return by_extension;
+}
+
+}
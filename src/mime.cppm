@@ -0,0 +1,58 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+export module openxmb.mime;
+
+export namespace mime {
+
+// Returned when nothing more specific is known.
+inline constexpr std::string_view octet_stream = "application/octet-stream";
+inline constexpr std::string_view directory = "inode/directory";
+
+// Number of leading bytes sniff() looks at.
+inline constexpr std::size_t sniff_size = 512;
+
+// MIME type for a file extension, with or without the leading dot and in any
+// case (".JPG" works). Empty if the extension is not known.
+std::string_view from_extension(std::string_view ext);
+
+// Same, for the extension of a file name.
+std::string_view from_name(std::string_view name);
+
+// MIME type identified from the first (up to sniff_size) bytes of a file, or
+// empty if they match no known signature. Plain text is only reported when
+// the whole sample looks like UTF-8 text.
+std::string_view sniff(std::string_view header);
+
+// Reads the start of the regular file name, relative to dirfd (or AT_FDCWD),
+// and sniffs it. Empty for anything that is not a readable regular file;
+// never blocks on FIFOs or devices.
+std::string_view sniff_file(int dirfd, const char* name);
+
+// Best guess for a file that is about to be opened. The extension wins unless
+// the content clearly says otherwise; extension-less and unknown files are
+// sniffed. Falls back to octet_stream.
+std::string_view detect(const std::filesystem::path& path);
+
+}
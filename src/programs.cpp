@@ -21,11 +21,11 @@ module;
 #include <filesystem>
 #include <fstream>
 #include <nlohmann/json.hpp>
-#include <map>
 
 module openxmb.app;
 
 import :programs;
+import openxmb.mime;
 
 namespace programs {
 
@@ -33,59 +33,14 @@ file_info::file_info(const std::filesystem::path& path) {
     name = path.filename().string();
     display_name = name;
     
-    // Determine MIME type based on file extension
-    std::string ext = path.extension().string();
-    if (ext.empty()) {
-        mime_type = "application/octet-stream";
+    // Extension first, content if the extension is missing or wrong
+    mime_type = mime::detect(path);
+    if (mime_type == mime::octet_stream) {
         content_type = "unknown";
         fast_content_type = "unknown";
     } else {
-        // Common MIME type mappings
-        static const std::map<std::string, std::string> mime_types = {
-            {".txt", "text/plain"},
-            {".md", "text/markdown"},
-            {".html", "text/html"},
-            {".htm", "text/html"},
-            {".css", "text/css"},
-            {".js", "application/javascript"},
-            {".json", "application/json"},
-            {".xml", "application/xml"},
-            {".pdf", "application/pdf"},
-            {".jpg", "image/jpeg"},
-            {".jpeg", "image/jpeg"},
-            {".png", "image/png"},
-            {".gif", "image/gif"},
-            {".bmp", "image/bmp"},
-            {".svg", "image/svg+xml"},
-            {".ico", "image/x-icon"},
-            {".mp3", "audio/mpeg"},
-            {".wav", "audio/wav"},
-            {".ogg", "audio/ogg"},
-            {".mp4", "video/mp4"},
-            {".avi", "video/x-msvideo"},
-            {".mkv", "video/x-matroska"},
-            {".mov", "video/quicktime"},
-            {".zip", "application/zip"},
-            {".tar", "application/x-tar"},
-            {".gz", "application/gzip"},
-            {".7z", "application/x-7z-compressed"},
-            {".exe", "application/x-executable"},
-            {".deb", "application/vnd.debian.binary-package"},
-            {".rpm", "application/x-rpm"},
-            {".app", "application/x-executable"},
-            {".dmg", "application/x-apple-diskimage"}
-        };
-        
-        auto it = mime_types.find(ext);
-        if (it != mime_types.end()) {
-            mime_type = it->second;
-            content_type = it->second;
-            fast_content_type = it->second;
-        } else {
-            mime_type = "application/octet-stream";
-            content_type = "unknown";
-            fast_content_type = "unknown";
-        }
+        content_type = mime_type;
+        fast_content_type = mime_type;
     }
     
     // Try to determine icon name based on file type
@@ -23,6 +23,8 @@
 
 module;
 
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <functional>
 #include <iterator>
@@ -108,7 +110,10 @@ export std::vector<open_info> get_open_infos(const std::filesystem::path& path,
     std::vector<open_info> infos;
 
     program_registry::get_program_mime(info.fast_content_type, std::back_inserter(infos));
-    program_registry::get_program_ext(path.extension().string(), std::back_inserter(infos));
+    // Programs register lower case extensions
+    std::string ext = path.extension().string();
+    std::ranges::transform(ext, ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    program_registry::get_program_ext(ext, std::back_inserter(infos));
 
     return infos;
 }
@@ -20,7 +20,7 @@ module;
 
 #include <cassert>
 #include <filesystem>
-#include <future>
+#include <stop_token>
 #include <vector>
 
 extern "C" {
@@ -40,6 +40,7 @@ import spdlog;
 import vulkan_hpp;
 import vma;
 import i18n;
+import openxmb.jobs;
 import openxmb.utils;
 import :component;
 import :programs;
@@ -59,9 +60,18 @@ export class video_player : private base_viewer, public component, public action
         video_player(std::filesystem::path path, dreamrender::resource_loader& loader) :
             path(std::move(path)), device(loader.getDevice()), allocator(loader.getAllocator())
         {
-            load_future = std::async(std::launch::async, [this, &loader] -> std::unique_ptr<video_decoding_context> {
-                auto ctx = std::make_unique<video_decoding_context>();
+            loading.submit([this](std::stop_token stop) {
+                auto ctx = std::make_shared<video_decoding_context>();
                 try {
+                    // Lets closing the player abort opening a slow or stalled file
+                    ctx->format_ctx = avformat_alloc_context();
+                    if (!ctx->format_ctx) {
+                        throw std::runtime_error("Could not allocate format context");
+                    }
+                    ctx->format_ctx->interrupt_callback.callback = [](void* opaque) {
+                        return static_cast<std::stop_token*>(opaque)->stop_requested() ? 1 : 0;
+                    };
+                    ctx->format_ctx->interrupt_callback.opaque = &stop;
                     if (avformat_open_input(&ctx->format_ctx, this->path.c_str(), nullptr, nullptr) != 0) {
                         throw std::runtime_error("Could not open input file");
                     }
@@ -90,9 +100,13 @@ export class video_player : private base_viewer, public component, public action
                 } catch(const std::exception& e) {
                     spdlog::error("Failed to load video: {}", e.what());
                     ctx->error_message = e.what();
-                    return ctx;
                 }
-                return ctx;
+                if (ctx->format_ctx) {
+                    ctx->format_ctx->interrupt_callback = {}; // the token does not outlive this job
+                }
+                loading.post_main([this, ctx = std::move(ctx)]() mutable {
+                    opened = std::move(ctx);
+                }, stop);
             });
         }
         ~video_player() {
@@ -102,11 +116,11 @@ export class video_player : private base_viewer, public component, public action
         }
 
         result tick(shell* xmb) override {
-            if(!loaded && !utils::is_ready(load_future)) {
+            if(!loaded && !opened) {
                 return result::success;
             }
             if(!loaded) {
-                ctx = load_future.get();
+                ctx = std::move(opened);
                 if(!ctx->codec_ctx) {
                     spdlog::error("Failed to load video");
                     xmb->emplace_overlay<app::message_overlay>("Failed to open video"_(),
@@ -244,7 +258,7 @@ export class video_player : private base_viewer, public component, public action
                 if (sws_ctx) sws_freeContext(sws_ctx);
             }
         };
-        std::unique_ptr<video_decoding_context> ctx;
+        std::shared_ptr<video_decoding_context> ctx;
         vma::UniqueImage decoded_image;
         vma::UniqueAllocation decoded_allocation;
         vk::UniqueImageView decoded_view;
@@ -259,7 +273,7 @@ export class video_player : private base_viewer, public component, public action
         vk::DescriptorSet descriptorSet;
         vk::UniqueImageView unormView;
 
-        std::future<std::unique_ptr<video_decoding_context>> load_future;
+        std::shared_ptr<video_decoding_context> opened; // set on the main thread once the open job is done
 
         std::vector<vma::UniqueBuffer> staging_buffers;
         std::vector<vma::UniqueAllocation> staging_buffer_allocations;
@@ -272,6 +286,8 @@ export class video_player : private base_viewer, public component, public action
         };
         play_state state = play_state::loading;
         std::chrono::steady_clock::time_point start_time;
+
+        jobs::group loading{jobs::priority::high}; // last, so the open job stops before the rest goes
 };
 
 namespace {
@@ -0,0 +1,77 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+export module openxmb.render:device_features;
+
+import vulkan_hpp;
+
+namespace render {
+
+// Optional features the logical device was actually created with.
+//
+// A physical device reporting a feature does not make it usable: it also has
+// to be enabled in VkDeviceCreateInfo, and Vulkan offers no way to read that
+// back from a VkDevice. The engine keeps the feature chain it passed to
+// vkCreateDevice, and this walks it for the features our renderers depend on.
+export struct device_features {
+    bool textureCompressionBC = false;
+    bool textureCompressionETC2 = false;
+    bool shaderSampledImageArrayNonUniformIndexing = false;
+    bool descriptorBindingPartiallyBound = false;
+
+    // `chain` is the pNext chain (or a VkPhysicalDeviceFeatures2 head) given
+    // to vkCreateDevice; `core` is its pEnabledFeatures, if that was used.
+    static device_features from_chain(const void* chain, const vk::PhysicalDeviceFeatures* core = nullptr) {
+        device_features f;
+        if(core) {
+            f.add(*core);
+        }
+        for(auto* s = static_cast<const vk::BaseInStructure*>(chain); s; s = s->pNext) {
+            switch(s->sType) {
+                case vk::StructureType::ePhysicalDeviceFeatures2:
+                    f.add(reinterpret_cast<const vk::PhysicalDeviceFeatures2*>(s)->features);
+                    break;
+                case vk::StructureType::ePhysicalDeviceVulkan12Features: {
+                    auto* v12 = reinterpret_cast<const vk::PhysicalDeviceVulkan12Features*>(s);
+                    f.shaderSampledImageArrayNonUniformIndexing |= static_cast<bool>(v12->shaderSampledImageArrayNonUniformIndexing);
+                    f.descriptorBindingPartiallyBound |= static_cast<bool>(v12->descriptorBindingPartiallyBound);
+                    break;
+                }
+                case vk::StructureType::ePhysicalDeviceDescriptorIndexingFeatures: {
+                    auto* indexing = reinterpret_cast<const vk::PhysicalDeviceDescriptorIndexingFeatures*>(s);
+                    f.shaderSampledImageArrayNonUniformIndexing |= static_cast<bool>(indexing->shaderSampledImageArrayNonUniformIndexing);
+                    f.descriptorBindingPartiallyBound |= static_cast<bool>(indexing->descriptorBindingPartiallyBound);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        return f;
+    }
+
+  private:
+    void add(const vk::PhysicalDeviceFeatures& core) {
+        textureCompressionBC |= static_cast<bool>(core.textureCompressionBC);
+        textureCompressionETC2 |= static_cast<bool>(core.textureCompressionETC2);
+    }
+};
+
+}
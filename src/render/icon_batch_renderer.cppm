@@ -0,0 +1,279 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+export module openxmb.render:icon_batch_renderer;
+
+import dreamrender;
+import :device_features;
+import :shaders;
+import :texture_atlas;
+
+import glm;
+import spdlog;
+import vulkan_hpp;
+import vma;
+
+namespace render {
+
+// Draws many icons with a single instanced draw call.
+//
+// Icons are queued with add() and emitted by flush(): every texture used by
+// the batch goes into one descriptor array, and each icon becomes an instance
+// record (rect, uv, colour, texture index) that the shaders expand into a
+// quad. Requires non-uniform indexing of sampled image arrays, see
+// is_supported(); callers fall back to per-icon gui_renderer draws otherwise.
+export class icon_batch_renderer {
+  public:
+    struct instance {
+        glm::vec4 rect;  // x, y, width, height in screen fractions
+        glm::vec4 uv{0.0f, 0.0f, 1.0f, 1.0f};
+        glm::vec4 color{1.0f};
+        std::uint32_t texture = 0;
+    };
+
+    static constexpr std::uint32_t max_textures = 256; // keep in sync with icon_batch.frag
+    static constexpr std::uint32_t max_instances = 4096; // per frame
+    static constexpr std::uint32_t max_batches = 32; // per frame
+
+    icon_batch_renderer(vk::Device device, vma::Allocator allocator, vk::Extent2D frameSize)
+      : device(device), allocator(allocator), frameSize(frameSize) {}
+    ~icon_batch_renderer() = default;
+
+    // `enabled` must describe the logical device, not just what the GPU
+    // could do: using a feature that was not enabled at device creation is
+    // undefined behaviour even when the physical device reports it.
+    static bool is_supported(vk::PhysicalDevice physicalDevice, const device_features& enabled) {
+        const auto limits = physicalDevice.getProperties().limits;
+        return enabled.shaderSampledImageArrayNonUniformIndexing && enabled.descriptorBindingPartiallyBound &&
+            limits.maxPerStageDescriptorSampledImages >= max_textures && limits.maxPerStageDescriptorSamplers >= max_textures;
+    }
+
+    void preload(const std::vector<vk::RenderPass>& renderPasses, vk::SampleCountFlagBits sampleCount,
+                 vk::PipelineCache pipelineCache, unsigned int framesInFlight)
+    {
+        sampler = device.createSamplerUnique(vk::SamplerCreateInfo({}, vk::Filter::eLinear, vk::Filter::eLinear,
+            vk::SamplerMipmapMode::eLinear, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge,
+            vk::SamplerAddressMode::eClampToEdge));
+
+        vk::DescriptorSetLayoutBinding binding(0, vk::DescriptorType::eCombinedImageSampler, max_textures, vk::ShaderStageFlagBits::eFragment);
+        vk::DescriptorBindingFlags bindingFlags = vk::DescriptorBindingFlagBits::ePartiallyBound;
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo(bindingFlags);
+        vk::StructureChain layoutChain{vk::DescriptorSetLayoutCreateInfo({}, binding), flagsInfo};
+        descriptorSetLayout = device.createDescriptorSetLayoutUnique(layoutChain.get<vk::DescriptorSetLayoutCreateInfo>());
+
+        vk::PipelineLayoutCreateInfo layout_info({}, descriptorSetLayout.get());
+        pipelineLayout = device.createPipelineLayoutUnique(layout_info);
+
+        vk::UniqueShaderModule vertexShader = shaders::icon_batch::vert(device);
+        vk::UniqueShaderModule fragmentShader = shaders::icon_batch::frag(device);
+        std::array<vk::PipelineShaderStageCreateInfo, 2> stages = {
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, vertexShader.get(), "main"),
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, fragmentShader.get(), "main")
+        };
+
+        vk::VertexInputBindingDescription vertexBinding(0, sizeof(instance), vk::VertexInputRate::eInstance);
+        std::array<vk::VertexInputAttributeDescription, 4> attributes = {
+            vk::VertexInputAttributeDescription(0, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(instance, rect)),
+            vk::VertexInputAttributeDescription(1, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(instance, uv)),
+            vk::VertexInputAttributeDescription(2, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(instance, color)),
+            vk::VertexInputAttributeDescription(3, 0, vk::Format::eR32Uint, offsetof(instance, texture)),
+        };
+        vk::PipelineVertexInputStateCreateInfo vertex_input({}, vertexBinding, attributes);
+        vk::PipelineInputAssemblyStateCreateInfo input_assembly({}, vk::PrimitiveTopology::eTriangleList);
+        vk::Viewport v{}; vk::Rect2D s{};
+        vk::PipelineViewportStateCreateInfo viewport({}, v, s);
+        vk::PipelineRasterizationStateCreateInfo rasterization({}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f);
+        vk::PipelineMultisampleStateCreateInfo multisample({}, sampleCount);
+        vk::PipelineDepthStencilStateCreateInfo depthStencil({}, false, false);
+        vk::PipelineColorBlendAttachmentState attachment(true,
+            vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+            vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+            vk::ColorComponentFlagBits::eR|vk::ColorComponentFlagBits::eG|vk::ColorComponentFlagBits::eB|vk::ColorComponentFlagBits::eA);
+        vk::PipelineColorBlendStateCreateInfo colorBlend({}, false, vk::LogicOp::eClear, attachment);
+        std::array<vk::DynamicState, 2> dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+        vk::PipelineDynamicStateCreateInfo dynamic({}, dynamicStates);
+
+        vk::GraphicsPipelineCreateInfo pipeline_info({}, stages, &vertex_input, &input_assembly, {}, &viewport, &rasterization, &multisample, &depthStencil, &colorBlend, &dynamic, pipelineLayout.get(), {});
+        pipelines = dreamrender::createPipelines(device, pipelineCache, pipeline_info, renderPasses, "Icon Batch Pipeline");
+
+        frames.resize(framesInFlight);
+        for(auto& f : frames) {
+            vk::DescriptorPoolSize pool_size(vk::DescriptorType::eCombinedImageSampler, max_textures * max_batches);
+            f.descriptorPool = device.createDescriptorPoolUnique(vk::DescriptorPoolCreateInfo({}, max_batches, pool_size));
+
+            vk::BufferCreateInfo buffer_info({}, sizeof(instance) * max_instances, vk::BufferUsageFlagBits::eVertexBuffer, vk::SharingMode::eExclusive);
+            vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eCpuToGpu);
+            std::tie(f.instanceBuffer, f.instanceAllocation) = allocator.createBufferUnique(buffer_info, alloc_info);
+        }
+    }
+
+    // Starts a new frame; its previous submission must have completed.
+    void begin_frame(int frame, vk::RenderPass renderPass) {
+        current = &frames.at(frame);
+        device.resetDescriptorPool(current->descriptorPool.get());
+        current->usedInstances = 0;
+        current->usedBatches = 0;
+        this->renderPass = renderPass;
+        pending.clear();
+        views.clear();
+        colors.assign(1, glm::vec4(1.0f));
+        zooms.assign(1, 1.0f);
+    }
+
+    // Mirror the state pushed on the gui_renderer the icons are drawn with,
+    // so the batch can be used under fades and zooms as well. Zoom scales
+    // about the centre of the screen, as gui_renderer::push_zoom does.
+    void push_color(glm::vec4 color) {
+        colors.push_back(colors.back() * color);
+    }
+    void pop_color() {
+        if(colors.size() > 1) colors.pop_back();
+    }
+    void push_zoom(float scale) {
+        zooms.push_back(zooms.back() * scale);
+    }
+    void pop_zoom() {
+        if(zooms.size() > 1) zooms.pop_back();
+    }
+
+    // Queues an icon. Unloaded textures are skipped, like gui_renderer does.
+    void add(const dreamrender::texture& texture, glm::vec4 rect, glm::vec4 color, glm::vec4 uv = {0.0f, 0.0f, 1.0f, 1.0f}) {
+        if(!texture.loaded || !texture.imageView) {
+            return;
+        }
+        const float zoom = zooms.back();
+        rect = glm::vec4(0.5f + (rect.x - 0.5f) * zoom, 0.5f + (rect.y - 0.5f) * zoom, rect.z * zoom, rect.w * zoom);
+        color *= colors.back();
+        std::uint32_t index = 0;
+        vk::ImageView view = texture.imageView.get();
+        while(index < views.size() && views[index] != view) {
+            index++;
+        }
+        if(index == views.size()) {
+            views.push_back(view);
+        }
+        pending.push_back({rect, uv, color, index});
+    }
+
+    void add(const atlas_region& region, glm::vec4 rect, glm::vec4 color) {
+        if(const auto* page = region.texture()) {
+            add(*page, rect, color, region.uv);
+        }
+    }
+
+    [[nodiscard]] bool empty() const {
+        return pending.empty();
+    }
+
+    // Draws everything queued since the last flush. Splits into several
+    // draws only if a batch exceeds max_textures distinct textures.
+    void flush(vk::CommandBuffer cmd) {
+        if(pending.empty() || !current) {
+            return;
+        }
+        auto it = pipelines.find(renderPass);
+        if(it == pipelines.end()) {
+            pending.clear();
+            views.clear();
+            return;
+        }
+
+        std::size_t begin = 0;
+        while(begin < pending.size()) {
+            // Collect a run whose textures fit into one descriptor array.
+            std::vector<std::uint32_t> remap(views.size(), UINT32_MAX);
+            std::vector<vk::DescriptorImageInfo> images;
+            std::size_t end = begin;
+            for(; end < pending.size(); end++) {
+                auto& slot = remap[pending[end].texture];
+                if(slot == UINT32_MAX) {
+                    if(images.size() == max_textures) break;
+                    slot = images.size();
+                    images.emplace_back(sampler.get(), views[pending[end].texture], vk::ImageLayout::eShaderReadOnlyOptimal);
+                }
+            }
+            const std::uint32_t count = static_cast<std::uint32_t>(end - begin);
+            if(current->usedBatches == max_batches || current->usedInstances + count > max_instances) {
+                spdlog::warn("Icon batch capacity exhausted, dropping {} icons", pending.size() - begin);
+                break;
+            }
+
+            std::vector<instance> instances(pending.begin() + begin, pending.begin() + end);
+            for(auto& i : instances) {
+                i.texture = remap[i.texture];
+            }
+            const vk::DeviceSize offset = current->usedInstances * sizeof(instance);
+            allocator.copyMemoryToAllocation(instances.data(), current->instanceAllocation.get(), offset, instances.size() * sizeof(instance));
+
+            vk::DescriptorSet set = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(current->descriptorPool.get(), descriptorSetLayout.get())).front();
+            device.updateDescriptorSets(vk::WriteDescriptorSet(set, 0, 0, vk::DescriptorType::eCombinedImageSampler, images), {});
+
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, it->second.get());
+            vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(frameSize.width), static_cast<float>(frameSize.height), 0.0f, 1.0f);
+            vk::Rect2D scissor({0, 0}, frameSize);
+            cmd.setViewport(0, viewport);
+            cmd.setScissor(0, scissor);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, set, {});
+            cmd.bindVertexBuffers(0, current->instanceBuffer.get(), offset);
+            cmd.draw(6, count, 0, 0);
+
+            current->usedInstances += count;
+            current->usedBatches++;
+            begin = end;
+        }
+        pending.clear();
+        views.clear();
+    }
+
+  private:
+    struct frame_resources {
+        vk::UniqueDescriptorPool descriptorPool;
+        vma::UniqueBuffer instanceBuffer;
+        vma::UniqueAllocation instanceAllocation;
+        std::uint32_t usedInstances = 0;
+        std::uint32_t usedBatches = 0;
+    };
+
+    vk::Device device;
+    vma::Allocator allocator;
+    vk::Extent2D frameSize;
+
+    vk::UniqueSampler sampler;
+    vk::UniqueDescriptorSetLayout descriptorSetLayout;
+    vk::UniquePipelineLayout pipelineLayout;
+    dreamrender::UniquePipelineMap pipelines;
+
+    std::vector<frame_resources> frames;
+    frame_resources* current = nullptr;
+    vk::RenderPass renderPass;
+
+    std::vector<instance> pending;
+    std::vector<vk::ImageView> views;
+    std::vector<glm::vec4> colors{glm::vec4(1.0f)};
+    std::vector<float> zooms{1.0f};
+};
+
+}
@@ -24,3 +24,8 @@ export import :wave_renderer;
 export import :original_renderer;
 export import :particles_renderer;
 export import :shaders;
+export import :device_features;
+export import :texture_uploader;
+export import :texture_compression;
+export import :texture_atlas;
+export import :icon_batch_renderer;
@@ -55,4 +55,9 @@ namespace original_particles {
     vk::UniqueShaderModule frag(vk::Device device);
 }
 
+namespace icon_batch {
+    vk::UniqueShaderModule vert(vk::Device device);
+    vk::UniqueShaderModule frag(vk::Device device);
+}
+
 }
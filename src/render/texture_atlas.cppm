@@ -0,0 +1,236 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+export module openxmb.render:texture_atlas;
+
+import dreamrender;
+import glm;
+import :texture_uploader;
+
+namespace render {
+
+// Bottom-left skyline rectangle packer. The skyline is the upper outline of
+// everything placed so far; new rectangles go where they keep it lowest.
+export class skyline_packer {
+    public:
+        skyline_packer(unsigned int width, unsigned int height) : width(width), height(height) {
+            clear();
+        }
+
+        void clear() {
+            skyline.assign(1, {0, 0, width});
+        }
+
+        // Position of a free w*h area, or nothing if the page is full.
+        std::optional<glm::uvec2> insert(unsigned int w, unsigned int h) {
+            std::size_t best = skyline.size();
+            unsigned int best_y = std::numeric_limits<unsigned int>::max();
+            unsigned int best_width = std::numeric_limits<unsigned int>::max();
+            for(std::size_t i = 0; i < skyline.size(); i++) {
+                auto y = fit(i, w, h);
+                if(y && (*y < best_y || (*y == best_y && skyline[i].width < best_width))) {
+                    best = i;
+                    best_y = *y;
+                    best_width = skyline[i].width;
+                }
+            }
+            if(best == skyline.size()) {
+                return std::nullopt;
+            }
+
+            const unsigned int x = skyline[best].x;
+            skyline.insert(skyline.begin() + best, {x, best_y + h, w});
+            // Shrink or drop the segments now covered by the new one.
+            for(std::size_t i = best + 1; i < skyline.size();) {
+                auto& s = skyline[i];
+                if(s.x >= x + w) break;
+                const unsigned int shrink = x + w - s.x;
+                if(s.width <= shrink) {
+                    skyline.erase(skyline.begin() + i);
+                    continue;
+                }
+                s.x += shrink;
+                s.width -= shrink;
+                break;
+            }
+            // Merge neighbours of equal height.
+            for(std::size_t i = 0; i + 1 < skyline.size();) {
+                if(skyline[i].y == skyline[i+1].y) {
+                    skyline[i].width += skyline[i+1].width;
+                    skyline.erase(skyline.begin() + i + 1);
+                } else {
+                    i++;
+                }
+            }
+            return glm::uvec2(x, best_y);
+        }
+    private:
+        struct segment {
+            unsigned int x, y, width;
+        };
+
+        // Lowest y at which a w*h rectangle starting at segment i fits.
+        std::optional<unsigned int> fit(std::size_t i, unsigned int w, unsigned int h) const {
+            if(skyline[i].x + w > width) {
+                return std::nullopt;
+            }
+            unsigned int y = 0;
+            unsigned int remaining = w;
+            for(; remaining > 0; i++) {
+                if(i == skyline.size()) return std::nullopt;
+                y = std::max(y, skyline[i].y);
+                if(y + h > height) return std::nullopt;
+                remaining -= std::min(remaining, skyline[i].width);
+            }
+            return y;
+        }
+
+        unsigned int width, height;
+        std::vector<segment> skyline;
+};
+
+export class texture_atlas;
+
+// Sub-rectangle of an atlas page. Draw it with the page texture and uv,
+// e.g. through icon_batch_renderer::add(). Stays valid until the atlas is
+// cleared, even when the page is re-uploaded.
+export struct atlas_region {
+    const texture_atlas* atlas = nullptr;
+    unsigned int page = 0;
+    glm::vec4 uv{0.0f, 0.0f, 1.0f, 1.0f}; // u0, v0, u1, v1
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    // Current page texture; may be nullptr or not yet loaded.
+    const dreamrender::texture* texture() const;
+};
+
+// Packs small RGBA8 images into shared pages, so many icons need only a few
+// allocations and descriptor bindings.
+//
+// Every region is surrounded by a gutter replicating its edge pixels, which
+// keeps linear filtering from bleeding neighbours into each other. Pages are
+// kept on the CPU and re-uploaded as a whole through the texture_uploader
+// when commit() is called after adding regions.
+export class texture_atlas {
+    public:
+        explicit texture_atlas(texture_uploader& uploader, unsigned int page_size = 1024)
+            : uploader(uploader), page_size(page_size) {}
+        ~texture_atlas() {
+            clear();
+        }
+        texture_atlas(const texture_atlas&) = delete;
+        texture_atlas& operator=(const texture_atlas&) = delete;
+
+        // Images larger than this (on either side) are not worth packing.
+        static constexpr unsigned int max_region = 128;
+        static constexpr unsigned int gutter = 2;
+
+        // Copies width*height RGBA8 pixels into a page. Returns nothing for
+        // images above max_region, those should stay separate textures.
+        std::optional<atlas_region> add(const std::vector<std::uint8_t>& pixels, unsigned int width, unsigned int height) {
+            if(width == 0 || height == 0 || width > max_region || height > max_region ||
+                pixels.size() < std::size_t{width} * height * 4)
+            {
+                return std::nullopt;
+            }
+            const unsigned int w = width + 2*gutter, h = height + 2*gutter;
+            std::optional<glm::uvec2> pos;
+            unsigned int index = 0;
+            for(; index < pages.size(); index++) {
+                if((pos = pages[index].packer.insert(w, h))) break;
+            }
+            if(!pos) {
+                pages.push_back(page{skyline_packer(page_size, page_size),
+                    std::vector<std::uint8_t>(std::size_t{page_size} * page_size * 4), nullptr, false});
+                index = pages.size() - 1;
+                pos = pages.back().packer.insert(w, h);
+            }
+
+            auto& p = pages[index];
+            const glm::uvec2 origin = *pos + glm::uvec2(gutter);
+            for(unsigned int y = 0; y < h; y++) {
+                const unsigned int sy = std::clamp<int>(static_cast<int>(y) - static_cast<int>(gutter), 0, static_cast<int>(height) - 1);
+                std::uint8_t* row = p.pixels.data() + (std::size_t{pos->y + y} * page_size + pos->x) * 4;
+                const std::uint8_t* src = pixels.data() + std::size_t{sy} * width * 4;
+                for(unsigned int x = 0; x < gutter; x++) {
+                    std::memcpy(row + x*4, src, 4);
+                    std::memcpy(row + (gutter + width + x)*4, src + (width-1)*4, 4);
+                }
+                std::memcpy(row + gutter*4, src, std::size_t{width} * 4);
+            }
+            p.dirty = true;
+
+            const float scale = 1.0f / static_cast<float>(page_size);
+            return atlas_region{this, index,
+                glm::vec4(origin.x, origin.y, origin.x + width, origin.y + height) * scale, width, height};
+        }
+
+        // Uploads pages changed since the last commit. Their previous textures
+        // are retired, regions handed out earlier pick up the new ones.
+        void commit() {
+            for(auto& p : pages) {
+                if(!p.dirty) continue;
+                uploader.retire(std::move(p.texture));
+                p.texture = uploader.create(std::vector<std::uint8_t>(p.pixels), page_size, page_size);
+                p.dirty = false;
+            }
+        }
+
+        // Drops all pages; every region handed out so far becomes invalid.
+        void clear() {
+            for(auto& p : pages) {
+                uploader.retire(std::move(p.texture));
+            }
+            pages.clear();
+        }
+
+        const dreamrender::texture* page_texture(unsigned int index) const {
+            return index < pages.size() ? pages[index].texture.get() : nullptr;
+        }
+        [[nodiscard]] std::size_t page_count() const {
+            return pages.size();
+        }
+    private:
+        struct page {
+            skyline_packer packer;
+            std::vector<std::uint8_t> pixels;
+            std::unique_ptr<dreamrender::texture> texture;
+            bool dirty = false;
+        };
+
+        texture_uploader& uploader;
+        unsigned int page_size;
+        std::vector<page> pages;
+};
+
+const dreamrender::texture* atlas_region::texture() const {
+    return atlas ? atlas->page_texture(page) : nullptr;
+}
+
+}
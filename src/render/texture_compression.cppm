@@ -0,0 +1,389 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <vector>
+
+export module openxmb.render:texture_compression;
+
+import :device_features;
+import vulkan_hpp;
+
+namespace render {
+
+// Block-compressed formats we can encode on the CPU. BC is what desktop GPUs
+// sample natively, ETC2 is mandatory on OpenGL ES 3 class (SBC) GPUs.
+export enum class compressed_format : std::uint32_t {
+    bc1, // opaque RGB, 8 bytes per 4x4 block
+    bc3, // RGBA, 16 bytes per block
+    etc2_rgb, // opaque RGB, 8 bytes per block
+    etc2_rgba, // RGBA (EAC alpha), 16 bytes per block
+};
+
+export constexpr vk::Format vulkan_format(compressed_format format) {
+    switch(format) {
+        case compressed_format::bc1: return vk::Format::eBc1RgbSrgbBlock;
+        case compressed_format::bc3: return vk::Format::eBc3SrgbBlock;
+        case compressed_format::etc2_rgb: return vk::Format::eEtc2R8G8B8SrgbBlock;
+        case compressed_format::etc2_rgba: return vk::Format::eEtc2R8G8B8A8SrgbBlock;
+    }
+    return vk::Format::eUndefined;
+}
+
+export constexpr std::size_t block_bytes(compressed_format format) {
+    return (format == compressed_format::bc1 || format == compressed_format::etc2_rgb) ? 8 : 16;
+}
+
+export constexpr std::size_t compressed_size(compressed_format format, unsigned int width, unsigned int height) {
+    return std::size_t{(width + 3) / 4} * ((height + 3) / 4) * block_bytes(format);
+}
+
+// Best format the device can sample for an image with or without alpha, or
+// nothing if neither BC nor ETC2 was enabled when the logical device was
+// created; the physical device supporting them is not enough.
+export std::optional<compressed_format> choose_compressed_format(vk::PhysicalDevice physicalDevice,
+    const device_features& features, bool alpha)
+{
+    auto usable = [&](compressed_format f) {
+        auto props = physicalDevice.getFormatProperties(vulkan_format(f));
+        return static_cast<bool>(props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+    };
+    if(features.textureCompressionBC) {
+        auto f = alpha ? compressed_format::bc3 : compressed_format::bc1;
+        if(usable(f)) return f;
+    }
+    if(features.textureCompressionETC2) {
+        auto f = alpha ? compressed_format::etc2_rgba : compressed_format::etc2_rgb;
+        if(usable(f)) return f;
+    }
+    return std::nullopt;
+}
+
+namespace detail {
+    using block = std::array<std::array<std::uint8_t, 4>, 16>; // row-major RGBA
+
+    // Fetches a 4x4 block, replicating edge pixels past the image border.
+    inline block fetch(const std::uint8_t* rgba, unsigned int width, unsigned int height, unsigned int bx, unsigned int by) {
+        block b;
+        for(unsigned int y = 0; y < 4; y++) {
+            for(unsigned int x = 0; x < 4; x++) {
+                const unsigned int sx = std::min(bx*4 + x, width - 1);
+                const unsigned int sy = std::min(by*4 + y, height - 1);
+                const std::uint8_t* p = rgba + (std::size_t{sy} * width + sx) * 4;
+                b[y*4 + x] = {p[0], p[1], p[2], p[3]};
+            }
+        }
+        return b;
+    }
+
+    inline int color_distance(const std::array<int, 3>& a, const std::uint8_t* b) {
+        const int dr = a[0] - b[0], dg = a[1] - b[1], db = a[2] - b[2];
+        return dr*dr + dg*dg + db*db;
+    }
+
+    inline void put_le16(std::uint8_t* out, std::uint16_t v) {
+        out[0] = v & 0xff;
+        out[1] = v >> 8;
+    }
+    inline void put_be64(std::uint8_t* out, std::uint64_t v) {
+        for(int i = 0; i < 8; i++) {
+            out[i] = static_cast<std::uint8_t>(v >> (56 - 8*i));
+        }
+    }
+
+    inline std::uint16_t to_565(int r, int g, int b) {
+        return static_cast<std::uint16_t>(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+    }
+    inline std::array<int, 3> from_565(std::uint16_t c) {
+        const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+    }
+
+    // BC1 colour block in four-colour mode, endpoints from the inset bounding box.
+    inline void encode_bc1_color(const block& b, std::uint8_t* out) {
+        std::array<int, 3> lo{255, 255, 255}, hi{0, 0, 0};
+        for(const auto& p : b) {
+            for(int c = 0; c < 3; c++) {
+                lo[c] = std::min<int>(lo[c], p[c]);
+                hi[c] = std::max<int>(hi[c], p[c]);
+            }
+        }
+        for(int c = 0; c < 3; c++) {
+            const int inset = (hi[c] - lo[c]) / 16;
+            lo[c] += inset;
+            hi[c] -= inset;
+        }
+        std::uint16_t c0 = to_565(hi[0], hi[1], hi[2]);
+        std::uint16_t c1 = to_565(lo[0], lo[1], lo[2]);
+        if(c0 < c1) std::swap(c0, c1);
+        put_le16(out, c0);
+        put_le16(out + 2, c1);
+
+        std::uint32_t indices = 0;
+        if(c0 != c1) {
+            const auto e0 = from_565(c0), e1 = from_565(c1);
+            std::array<std::array<int, 3>, 4> palette{e0, e1, {}, {}};
+            for(int c = 0; c < 3; c++) {
+                palette[2][c] = (2*e0[c] + e1[c]) / 3;
+                palette[3][c] = (e0[c] + 2*e1[c]) / 3;
+            }
+            for(unsigned int i = 0; i < 16; i++) {
+                unsigned int best = 0;
+                int best_error = std::numeric_limits<int>::max();
+                for(unsigned int j = 0; j < 4; j++) {
+                    const int e = color_distance(palette[j], b[i].data());
+                    if(e < best_error) {
+                        best_error = e;
+                        best = j;
+                    }
+                }
+                indices |= best << (2*i);
+            }
+        }
+        for(int i = 0; i < 4; i++) {
+            out[4 + i] = static_cast<std::uint8_t>(indices >> (8*i));
+        }
+    }
+
+    // BC3 alpha block in eight-value interpolation mode.
+    inline void encode_bc3_alpha(const block& b, std::uint8_t* out) {
+        int lo = 255, hi = 0;
+        for(const auto& p : b) {
+            lo = std::min<int>(lo, p[3]);
+            hi = std::max<int>(hi, p[3]);
+        }
+        out[0] = static_cast<std::uint8_t>(hi);
+        out[1] = static_cast<std::uint8_t>(lo);
+        std::uint64_t indices = 0;
+        if(hi != lo) {
+            std::array<int, 8> palette{hi, lo};
+            for(int i = 1; i < 7; i++) {
+                palette[i + 1] = ((7 - i) * hi + i * lo) / 7;
+            }
+            for(unsigned int i = 0; i < 16; i++) {
+                unsigned int best = 0;
+                int best_error = std::numeric_limits<int>::max();
+                for(unsigned int j = 0; j < 8; j++) {
+                    const int e = std::abs(palette[j] - b[i][3]);
+                    if(e < best_error) {
+                        best_error = e;
+                        best = j;
+                    }
+                }
+                indices |= std::uint64_t{best} << (3*i);
+            }
+        }
+        for(int i = 0; i < 6; i++) {
+            out[2 + i] = static_cast<std::uint8_t>(indices >> (8*i));
+        }
+    }
+
+    constexpr int etc_modifiers[8][2] = {
+        {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+    };
+
+    // ETC1-compatible "individual" mode block, which ETC2 decoders accept
+    // unchanged. Tries both sub-block orientations and all modifier tables.
+    inline void encode_etc_color(const block& b, std::uint8_t* out) {
+        struct sub_block {
+            std::array<int, 3> base4;
+            unsigned int table;
+            std::array<unsigned int, 8> pixels; // indices into b
+            std::array<unsigned int, 8> selectors;
+            long error;
+        };
+        auto solve = [&](const std::array<unsigned int, 8>& pixels) {
+            sub_block s{{}, 0, pixels, {}, std::numeric_limits<long>::max()};
+            std::array<int, 3> sum{};
+            for(auto p : pixels) {
+                for(int c = 0; c < 3; c++) sum[c] += b[p][c];
+            }
+            std::array<int, 3> base{};
+            for(int c = 0; c < 3; c++) {
+                s.base4[c] = std::clamp((sum[c] / 8 * 15 + 127) / 255, 0, 15);
+                base[c] = s.base4[c] * 17;
+            }
+            for(unsigned int t = 0; t < 8; t++) {
+                const int mods[4] = {etc_modifiers[t][0], etc_modifiers[t][1], -etc_modifiers[t][0], -etc_modifiers[t][1]};
+                long error = 0;
+                std::array<unsigned int, 8> selectors{};
+                for(unsigned int i = 0; i < 8; i++) {
+                    int best_error = std::numeric_limits<int>::max();
+                    for(unsigned int m = 0; m < 4; m++) {
+                        std::array<int, 3> c{};
+                        for(int k = 0; k < 3; k++) c[k] = std::clamp(base[k] + mods[m], 0, 255);
+                        const int e = color_distance(c, b[pixels[i]].data());
+                        if(e < best_error) {
+                            best_error = e;
+                            selectors[i] = m;
+                        }
+                    }
+                    error += best_error;
+                }
+                if(error < s.error) {
+                    s.error = error;
+                    s.table = t;
+                    s.selectors = selectors;
+                }
+            }
+            return s;
+        };
+
+        // flip = 0: left/right 2x4 halves, flip = 1: top/bottom 4x2 halves
+        std::array<sub_block, 2> best{};
+        bool best_flip = false;
+        long best_error = std::numeric_limits<long>::max();
+        for(bool flip : {false, true}) {
+            std::array<std::array<unsigned int, 8>, 2> halves{};
+            std::array<unsigned int, 2> n{};
+            for(unsigned int y = 0; y < 4; y++) {
+                for(unsigned int x = 0; x < 4; x++) {
+                    const unsigned int h = flip ? (y >= 2) : (x >= 2);
+                    halves[h][n[h]++] = y*4 + x;
+                }
+            }
+            std::array<sub_block, 2> s{solve(halves[0]), solve(halves[1])};
+            if(s[0].error + s[1].error < best_error) {
+                best_error = s[0].error + s[1].error;
+                best = s;
+                best_flip = flip;
+            }
+        }
+
+        std::uint64_t bits = 0;
+        bits |= std::uint64_t(best[0].base4[0]) << 60 | std::uint64_t(best[1].base4[0]) << 56;
+        bits |= std::uint64_t(best[0].base4[1]) << 52 | std::uint64_t(best[1].base4[1]) << 48;
+        bits |= std::uint64_t(best[0].base4[2]) << 44 | std::uint64_t(best[1].base4[2]) << 40;
+        bits |= std::uint64_t(best[0].table) << 37 | std::uint64_t(best[1].table) << 34;
+        bits |= std::uint64_t(best_flip) << 32; // diff bit (33) stays 0
+        for(const auto& s : best) {
+            for(unsigned int i = 0; i < 8; i++) {
+                // Selectors are stored column-major; value 0..3 means +a, +b, -a, -b
+                // which is encoded as (msb, lsb) = 00, 01, 10, 11.
+                const unsigned int p = s.pixels[i];
+                const unsigned int index = (p % 4) * 4 + p / 4;
+                const unsigned int sel = s.selectors[i];
+                bits |= std::uint64_t(sel >> 1) << (16 + index);
+                bits |= std::uint64_t(sel & 1) << index;
+            }
+        }
+        put_be64(out, bits);
+    }
+
+    constexpr int eac_modifiers[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11}, {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9}, {-2, -5, -8, -10, 1, 4, 7, 9},
+        {-2, -4, -8, -10, 1, 3, 7, 9}, {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9}, {-1, -2, -3, -10, 0, 1, 2, 9},
+        {-4, -6, -8, -9, 3, 5, 7, 8}, {-3, -5, -7, -9, 2, 4, 6, 8},
+    };
+
+    // EAC alpha block: base + table[index] * multiplier per pixel.
+    inline void encode_eac_alpha(const block& b, std::uint8_t* out) {
+        int lo = 255, hi = 0;
+        for(const auto& p : b) {
+            lo = std::min<int>(lo, p[3]);
+            hi = std::max<int>(hi, p[3]);
+        }
+        const int base = (lo + hi + 1) / 2;
+        std::uint64_t best_bits = 0;
+        long best_error = std::numeric_limits<long>::max();
+        for(unsigned int t = 0; t < 16 && best_error > 0; t++) {
+            const int span = eac_modifiers[t][7] - eac_modifiers[t][3];
+            const int guess = std::clamp((hi - lo + span/2) / span, 1, 15);
+            for(int mult = std::max(1, guess - 1); mult <= std::min(15, guess + 1); mult++) {
+                long error = 0;
+                std::uint64_t indices = 0;
+                for(unsigned int i = 0; i < 16; i++) {
+                    const unsigned int p = (i % 4) * 4 + i / 4; // column-major order
+                    int best_e = std::numeric_limits<int>::max();
+                    unsigned int best_m = 0;
+                    for(unsigned int m = 0; m < 8; m++) {
+                        const int v = std::clamp(base + eac_modifiers[t][m] * mult, 0, 255);
+                        const int e = std::abs(v - b[p][3]);
+                        if(e < best_e) {
+                            best_e = e;
+                            best_m = m;
+                        }
+                    }
+                    error += best_e * best_e;
+                    indices |= std::uint64_t{best_m} << (45 - 3*i);
+                }
+                if(error < best_error) {
+                    best_error = error;
+                    best_bits = std::uint64_t(base) << 56 | std::uint64_t(mult) << 52 | std::uint64_t(t) << 48 | indices;
+                }
+            }
+        }
+        put_be64(out, best_bits);
+    }
+}
+
+// Whether any pixel of the RGBA8 image is not fully opaque.
+export bool has_alpha(const std::uint8_t* rgba, std::size_t pixels) {
+    for(std::size_t i = 0; i < pixels; i++) {
+        if(rgba[i*4 + 3] != 255) return true;
+    }
+    return false;
+}
+
+// Encodes width*height RGBA8 pixels into blocks of the given format, in the
+// row-major block order Vulkan expects for buffer-to-image copies.
+export std::vector<std::uint8_t> compress(const std::uint8_t* rgba, unsigned int width, unsigned int height, compressed_format format) {
+    std::vector<std::uint8_t> out(compressed_size(format, width, height));
+    if(width == 0 || height == 0) {
+        return out;
+    }
+    std::uint8_t* dst = out.data();
+    for(unsigned int by = 0; by < (height + 3) / 4; by++) {
+        for(unsigned int bx = 0; bx < (width + 3) / 4; bx++) {
+            const auto b = detail::fetch(rgba, width, height, bx, by);
+            switch(format) {
+                case compressed_format::bc1:
+                    detail::encode_bc1_color(b, dst);
+                    break;
+                case compressed_format::bc3:
+                    detail::encode_bc3_alpha(b, dst);
+                    detail::encode_bc1_color(b, dst + 8);
+                    break;
+                case compressed_format::etc2_rgb:
+                    detail::encode_etc_color(b, dst);
+                    break;
+                case compressed_format::etc2_rgba:
+                    detail::encode_eac_alpha(b, dst);
+                    detail::encode_etc_color(b, dst + 8);
+                    break;
+            }
+            dst += block_bytes(format);
+        }
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,152 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <vector>
+
+export module openxmb.render:texture_uploader;
+
+import dreamrender;
+import spdlog;
+import vulkan_hpp;
+import vma;
+
+namespace render {
+
+// Uploads small CPU-side RGBA images into sampled textures as part of the
+// frame's command buffer instead of going through a blocking transfer.
+//
+// Textures handed out by create() are usable once ready() reports true (they
+// are recorded before the render passes of that frame). Textures that may
+// still be referenced by frames in flight are given back via retire() and
+// destroyed only after every frame slot has been recorded again.
+export class texture_uploader {
+    public:
+        texture_uploader(vk::Device device, vma::Allocator allocator, unsigned int frames_in_flight)
+            : device(device), allocator(allocator), frames_in_flight(frames_in_flight) {}
+        ~texture_uploader() = default;
+
+        // Creates an empty texture of the given size and queues an upload of
+        // width*height RGBA8 pixels into it. Other formats (e.g. compressed
+        // blocks) are copied as they are and must be tightly packed.
+        std::unique_ptr<dreamrender::texture> create(std::vector<std::uint8_t>&& pixels, unsigned int width, unsigned int height,
+            vk::Format format = vk::Format::eR8G8B8A8Srgb)
+        {
+            auto tex = std::make_unique<dreamrender::texture>(device, allocator, width, height,
+                vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, format);
+            pending.push_back({tex.get(), std::move(pixels), width, height});
+            return tex;
+        }
+
+        // Whether the texture's upload has been recorded.
+        [[nodiscard]] bool ready(const dreamrender::texture* tex) const {
+            for(const auto& p : pending) {
+                if(p.target == tex) return false;
+            }
+            return true;
+        }
+
+        void retire(std::unique_ptr<dreamrender::texture>&& tex) {
+            if(!tex) return;
+            for(auto it = pending.begin(); it != pending.end(); ++it) {
+                if(it->target == tex.get()) {
+                    pending.erase(it);
+                    return; // never recorded, nothing in flight can use it
+                }
+            }
+            retired.push_back({recorded + frames_in_flight + 1, std::move(tex), {}, {}});
+        }
+
+        // Records queued uploads into cmd. Must be called outside of a render
+        // pass, once per frame, after the frame's fence has been waited on.
+        void record(vk::CommandBuffer cmd) {
+            ++recorded;
+            while(!retired.empty() && retired.front().release_at <= recorded) {
+                retired.pop_front();
+            }
+
+            vk::DeviceSize budget = max_bytes_per_frame;
+            while(!pending.empty()) {
+                auto& p = pending.front();
+                vk::DeviceSize size = p.pixels.size();
+                if(size > budget && budget != max_bytes_per_frame) {
+                    break; // spread large batches over several frames
+                }
+                budget -= std::min(budget, size);
+
+                try {
+                    vk::BufferCreateInfo buffer_info({}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive);
+                    vma::AllocationCreateInfo alloc_info({}, vma::MemoryUsage::eCpuToGpu);
+                    auto [buffer, allocation] = allocator.createBufferUnique(buffer_info, alloc_info);
+                    allocator.copyMemoryToAllocation(p.pixels.data(), allocation.get(), 0, size);
+
+                    vk::ImageSubresourceRange range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+                    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+                        {}, {}, {}, vk::ImageMemoryBarrier({}, vk::AccessFlagBits::eTransferWrite,
+                            vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+                            vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, p.target->image, range));
+                    cmd.copyBufferToImage(buffer.get(), p.target->image, vk::ImageLayout::eTransferDstOptimal,
+                        vk::BufferImageCopy(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+                            vk::Offset3D(0, 0, 0), vk::Extent3D(p.width, p.height, 1)));
+                    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                        {}, {}, {}, vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead,
+                            vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal,
+                            vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, p.target->image, range));
+                    p.target->loaded = true;
+
+                    retired.push_back({recorded + frames_in_flight + 1, {}, std::move(buffer), std::move(allocation)});
+                } catch(const std::exception& e) {
+                    spdlog::warn("Failed to upload {}x{} texture: {}", p.width, p.height, e.what());
+                }
+                pending.pop_front();
+            }
+        }
+
+        // Bytes of pixel data recorded per frame at most (a single larger
+        // image is still recorded on its own).
+        static constexpr vk::DeviceSize max_bytes_per_frame = 8 * 1024 * 1024;
+    private:
+        struct upload {
+            dreamrender::texture* target;
+            std::vector<std::uint8_t> pixels;
+            unsigned int width;
+            unsigned int height;
+        };
+        struct retired_resource {
+            std::uint64_t release_at;
+            std::unique_ptr<dreamrender::texture> texture;
+            vma::UniqueBuffer buffer;
+            vma::UniqueAllocation allocation;
+        };
+
+        vk::Device device;
+        vma::Allocator allocator;
+        unsigned int frames_in_flight;
+
+        std::deque<upload> pending;
+        std::deque<retired_resource> retired;
+        std::uint64_t recorded = 0;
+};
+
+}
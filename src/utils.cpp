@@ -18,13 +18,21 @@
 
 module;
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <cstring>
 #include <filesystem>
 #include <iomanip>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <numeric>
 #include <optional>
+#include <span>
 #include <sstream>
+#include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include <fstream>
@@ -33,6 +41,9 @@ module;
 #ifdef __GNUG__
 #include <cxxabi.h>
 #endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 module openxmb.utils;
 
@@ -225,6 +236,135 @@ namespace utils {
     }
 }
 
+namespace utils
+{
+    namespace {
+        constexpr char fold(char c) {
+            return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+        }
+
+        std::string folded(std::string_view s) {
+            std::string out(s.size(), '\0');
+            std::ranges::transform(s, out.begin(), fold);
+            return out;
+        }
+
+        // First occurrence of the (folded, non-empty) needle in [begin, end),
+        // or end. Compares the first and the last byte of the needle at 16
+        // positions at once and only checks the rest where both match.
+        const char* find_folded(const char* begin, const char* end, std::string_view needle) {
+            const std::size_t m = needle.size();
+            if(static_cast<std::size_t>(end - begin) < m) {
+                return end;
+            }
+            const char* const last = end - m; // last possible start
+            const char* p = begin;
+#ifdef __SSE2__
+            const __m128i first = _mm_set1_epi8(needle.front());
+            const __m128i final = _mm_set1_epi8(needle.back());
+            for(; p + 16 <= last + 1; p += 16) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + m - 1));
+                auto mask = static_cast<unsigned int>(_mm_movemask_epi8(
+                    _mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, final))));
+                while(mask) {
+                    const char* candidate = p + std::countr_zero(mask);
+                    if(m <= 2 || std::memcmp(candidate + 1, needle.data() + 1, m - 2) == 0) {
+                        return candidate;
+                    }
+                    mask &= mask - 1;
+                }
+            }
+#endif
+            for(; p <= last; p++) {
+                if(*p == needle.front() && std::memcmp(p, needle.data(), m) == 0) {
+                    return p;
+                }
+            }
+            return end;
+        }
+    }
+
+    std::string natural_sort_key(std::string_view name) {
+        std::string key;
+        key.reserve(name.size() + 4);
+        for(std::size_t i = 0; i < name.size();) {
+            if(name[i] < '0' || name[i] > '9') {
+                key.push_back(fold(name[i++]));
+                continue;
+            }
+            // A number sorts by its length without leading zeros, then by its digits
+            while(i + 1 < name.size() && name[i] == '0' && name[i + 1] >= '0' && name[i + 1] <= '9') {
+                i++;
+            }
+            std::size_t end = i;
+            while(end < name.size() && name[end] >= '0' && name[end] <= '9') {
+                end++;
+            }
+            key.push_back('0'); // sorts with the digits, before letters
+            key.push_back(static_cast<char>('0' + std::min<std::size_t>(end - i, 200)));
+            key.append(name.substr(i, end - i));
+            i = end;
+        }
+        return key;
+    }
+
+    void folded_names::reserve(std::size_t names, std::size_t bytes) {
+        offsets.reserve(names + 1);
+        text.reserve(bytes + names);
+    }
+
+    void folded_names::add(std::string_view name) {
+        std::ranges::transform(name, std::back_inserter(text), fold);
+        text.push_back('\0');
+        offsets.push_back(static_cast<std::uint32_t>(text.size()));
+    }
+
+    std::vector<std::uint32_t> folded_names::find(std::string_view needle) const {
+        std::vector<std::uint32_t> found;
+        const auto n = folded(needle);
+        if(n.empty()) {
+            found.resize(size());
+            std::iota(found.begin(), found.end(), 0u);
+            return found;
+        }
+        // One pass over all names; '\0' never matches, so a hit lies within one name
+        const char* const base = text.data();
+        const char* const end = base + text.size();
+        std::uint32_t index = 0;
+        for(const char* p = base; (p = find_folded(p, end, n)) != end;) {
+            // Hits come in order, so the name is found walking forward from the last one
+            const auto offset = static_cast<std::uint32_t>(p - base);
+            while(offsets[index + 1] <= offset) {
+                index++;
+            }
+            found.push_back(index);
+            p = base + offsets[++index]; // one hit per name is enough
+        }
+        return found;
+    }
+
+    std::vector<std::uint32_t> folded_names::find(std::string_view needle, std::span<const std::uint32_t> candidates) const {
+        if(candidates.size() > size() / 4) {
+            // Scanning everything is faster than many short searches
+            auto all = find(needle);
+            std::vector<std::uint32_t> found;
+            std::ranges::set_intersection(all, candidates, std::back_inserter(found));
+            return found;
+        }
+        std::vector<std::uint32_t> found;
+        const auto n = folded(needle);
+        for(auto index : candidates) {
+            const char* begin = text.data() + offsets[index];
+            const char* end = text.data() + offsets[index + 1] - 1;
+            if(n.empty() || find_folded(begin, end, n) != end) {
+                found.push_back(index);
+            }
+        }
+        return found;
+    }
+}
+
 #ifdef __GNUG__
 namespace utils
 {
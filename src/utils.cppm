@@ -23,17 +23,22 @@ module;
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <future>
 #include <optional>
 #include <source_location>
+#include <span>
 #include <string>
 #include <string_view>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include <unistd.h>
+
 export module openxmb.utils;
 
 export enum class result {
@@ -78,6 +83,22 @@ export class action_receiver {
             return result::unsupported;
         }
 };
+export class text_receiver {
+    public:
+        virtual ~text_receiver() = default;
+        // Text typed on a keyboard or the on-screen keyboard, in UTF-8.
+        virtual result on_text(std::string_view text) {
+            return result::unsupported;
+        }
+        // Removes the last character typed.
+        virtual result on_text_erase() {
+            return result::unsupported;
+        }
+        // The text typed so far, for display.
+        virtual std::string_view get_text() const {
+            return {};
+        }
+};
 export class joystick_receiver {
     public:
         virtual ~joystick_receiver() = default;
@@ -162,6 +183,88 @@ export namespace utils
             std::size_t alignment;
     };
 
+    // Owns a POSIX file descriptor and closes it on destruction.
+    class unique_fd {
+        public:
+            unique_fd() = default;
+            explicit unique_fd(int fd) : fd(fd) {}
+            ~unique_fd() {
+                reset();
+            }
+            unique_fd(unique_fd&& other) noexcept : fd(std::exchange(other.fd, -1)) {}
+            unique_fd& operator=(unique_fd&& other) noexcept {
+                if(this != &other) {
+                    reset(std::exchange(other.fd, -1));
+                }
+                return *this;
+            }
+            unique_fd(const unique_fd&) = delete;
+            unique_fd& operator=(const unique_fd&) = delete;
+
+            [[nodiscard]] int get() const {
+                return fd;
+            }
+            explicit operator bool() const {
+                return fd >= 0;
+            }
+            void reset(int new_fd = -1) {
+                if(fd >= 0) {
+                    ::close(fd);
+                }
+                fd = new_fd;
+            }
+        private:
+            int fd = -1;
+    };
+
+    // Names folded to ASCII lower case and stored back to back, so a
+    // case-insensitive substring search covers all of them in one
+    // vectorized pass instead of one search per name. Bytes outside ASCII
+    // are compared as they are.
+    class folded_names {
+        public:
+            void reserve(std::size_t names, std::size_t bytes);
+            void add(std::string_view name);
+            [[nodiscard]] std::size_t size() const {
+                return offsets.size() - 1;
+            }
+            // The folded name at index.
+            [[nodiscard]] std::string_view operator[](std::size_t index) const {
+                return std::string_view(text).substr(offsets[index], offsets[index + 1] - offsets[index] - 1);
+            }
+
+            // Indices of the names that contain needle, in ascending order.
+            std::vector<std::uint32_t> find(std::string_view needle) const;
+            // Same, but only among candidates (ascending), e.g. the names that
+            // matched a shorter prefix of needle.
+            std::vector<std::uint32_t> find(std::string_view needle, std::span<const std::uint32_t> candidates) const;
+        private:
+            std::string text; // every name followed by a '\0'
+            std::vector<std::uint32_t> offsets{0}; // start of every name, then the end
+    };
+
+    // Key whose plain byte order is the order users expect for file names:
+    // ASCII case is folded and runs of digits compare by their numeric
+    // value, so "img_2" < "IMG_10". Compute it once per name and compare
+    // keys, see menu::files_menu::sort_by_name.
+    std::string natural_sort_key(std::string_view name);
+
+    enum class scale_filter {
+        area,      // averages the covered pixels; cheap, and sharp enough from 2:1 on
+        lanczos,   // Lanczos-3; sharper, but its cost grows with the ratio
+        automatic, // area down to twice the size, Lanczos for the rest
+    };
+
+    // Shrinks an RGBA8 image (rows of width * 4 bytes, no padding) to
+    // dst_width x dst_height, which must be no larger than the source.
+    //
+    // Both filters run as two separable passes with 14-bit fixed point
+    // weights. The inner loops are vectorized with SSE2 or NEON, and AVX2
+    // where the CPU has it; vectorized = false forces the scalar loops, which
+    // give identical results, for comparison.
+    std::vector<std::uint8_t> downscale_rgba(std::span<const std::uint8_t> pixels, unsigned int width, unsigned int height,
+        unsigned int dst_width, unsigned int dst_height, scale_filter filter = scale_filter::automatic, bool vectorized = true);
+
     std::string demangle(const char* name);
 
     template <class T>
@@ -0,0 +1,79 @@
+/* This file is a part of the OpenXMB desktop experience project.
+ * Copyright (C) 2025 Syndromatic Ltd. All rights reserved
+ * Designed by Kavish Krishnakumar in Manchester.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// Times utils::downscale_rgba() with and without its vector loops on a few
+// typical jobs: thumbnails, fitting a photo to the screen, small icon ratios.
+// Built with -DOPENXMB_BUILD_BENCHMARKS=ON, run as openxmb_bench_downscale.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <vector>
+
+import openxmb.utils;
+
+namespace {
+    struct job {
+        const char* name;
+        unsigned int width, height, dst_width, dst_height;
+        utils::scale_filter filter;
+    };
+
+    // Best of a few runs, in milliseconds
+    double time_ms(const std::vector<std::uint8_t>& pixels, const job& j, bool vectorized, std::vector<std::uint8_t>& out) {
+        double best = 1e30;
+        for(int run = 0; run < 5; run++) {
+            const auto start = std::chrono::steady_clock::now();
+            out = utils::downscale_rgba(pixels, j.width, j.height, j.dst_width, j.dst_height, j.filter, vectorized);
+            const std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            best = std::min(best, took.count());
+        }
+        return best;
+    }
+}
+
+int main() {
+    constexpr std::array jobs{
+        job{"thumbnail, automatic", 6000, 4000, 320, 213, utils::scale_filter::automatic},
+        job{"thumbnail, area", 6000, 4000, 320, 213, utils::scale_filter::area},
+        job{"screen fit, lanczos", 3840, 2560, 1920, 1280, utils::scale_filter::lanczos},
+        job{"screen fit, area", 3840, 2560, 1920, 1280, utils::scale_filter::area},
+        job{"icon, lanczos", 512, 512, 384, 384, utils::scale_filter::lanczos},
+    };
+
+    std::mt19937 random(42);
+    int failed = 0;
+    std::printf("%-24s %12s %12s %8s\n", "job", "scalar ms", "vector ms", "speedup");
+    for(const auto& j : jobs) {
+        // Gradients with noise, so neither path gets to skip anything
+        std::vector<std::uint8_t> pixels(std::size_t{j.width} * j.height * 4);
+        for(std::size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<std::uint8_t>((i / 4 % j.width) * 255 / j.width + (random() & 31));
+        }
+        std::vector<std::uint8_t> scalar, vector;
+        const double s = time_ms(pixels, j, false, scalar);
+        const double v = time_ms(pixels, j, true, vector);
+        std::printf("%-24s %12.2f %12.2f %7.1fx%s\n", j.name, s, v, s / v, scalar == vector ? "" : "  MISMATCH");
+        failed += scalar != vector;
+    }
+    return failed == 0 ? 0 : 1;
+}